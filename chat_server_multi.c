@@ -1,174 +1,2553 @@
-/* chat_server_multi.c (요구사항 2: 보낸 사람 제외) */
+/* chat_server_multi.c (요구사항 2: 보낸 사람 제외)
+ *
+ * epoll 이벤트 루프(reactor)로 모든 클라이언트를 처리한다. (예전: 클라이언트마다 pthread + 블로킹 read)
+ *  - 스레드 수가 고정이다: reactor --threads 개 + fastlog flusher 1개. 유휴 클라이언트는 struct client 하나만 차지한다
+ *  - --threads N: reactor 마다 SO_REUSEPORT 리슨 소켓을 따로 두어 커널이 연결을 나눠 준다. 클라이언트는 받은 reactor 에만 속한다.
+ *    한 reactor 가 받은 메시지는 자기 클라이언트에게 직접 보내고, 같은 방 사람이 있는 다른 reactor 에는
+ *    reactor 쌍마다 하나인 lock-free SPSC 링(spsc_ring.h)으로 넘긴 뒤 바퀴가 끝날 때 eventfd 로 한 번 깨운다.
+ *    받은 reactor 는 자기 클라이언트에게만 fanout 한다. 브로드캐스트가 전역 락 없이 코어 수만큼 나뉜다
+ *  - 메시지 경계가 있다. 줄 모드: '\n' 로 끝나는 한 줄이 메시지 하나 (예전 클라이언트 그대로).
+ *    프레임 모드: 4바이트 big-endian 길이 + 본문. 연결의 첫 바이트가 0 이면 프레임 모드로 본다 (--proto 로 고정 가능)
+ *  - 메시지는 수신자 형식별로 한 번만 만들어 참조 카운트 버퍼(struct msg)에 담고, 수신자 큐에는 그 포인터만 넣는다
+ *  - 보내기는 루프 한 바퀴가 끝날 때 몰아서 한다: 이번 바퀴에 큐가 생긴 클라이언트마다 writev 한 번
+ *  - 소켓은 논블로킹. 상대가 안 읽어서 못 보낸 데이터는 출력 큐에 남겨 두고 EPOLLOUT 때 보낸다
+ *  - 큐가 --hwm 바이트나 --max-queue 개를 넘은 느린 클라이언트는 끊거나(--slow=kick) 새 메시지를 버린다(--slow=drop)
+ *  - 방(room): 클라이언트는 한 번에 방 하나에 있고 (처음엔 "lobby"), 메시지와 입장/퇴장 알림은 같은 방에만 간다.
+ *    명령: /join <방>, /leave (lobby 로), /list (방 목록). 방 이름 → 방 색인은 샤드별 해시 테이블이고,
+ *    방마다 멤버 배열을 두고 클라이언트가 자기 위치를 기억하므로 입장/퇴장은 O(1) 이다.
+ *    멤버 배열은 reactor 마다 따로(struct room), 기록과 전체 인원은 방마다 하나(struct chan)다
+ *  - 방마다 최근 메시지 --history 개를 링에 들고 있다가 새로 들어온 사람에게 한 번에(메시지 하나로) 보내 준다.
+ *    --history-dir 을 주면 링을 방별 mmap 세그먼트 로그(seglog.h)에도 붙여 써서, 재시작한 뒤 방이 다시 열릴 때
+ *    파일을 읽어 들이지 않고 매핑한 로그의 끝에서 필요한 만큼만 걸어 링을 복구한다
+ *  - 입장/퇴장 알림, 보낸 사람을 제외한 브로드캐스트는 예전과 같다 (범위가 방으로 좁아졌을 뿐).
+ *    다만 알림은 방마다 모아 두었다가 --presence-ms 간격으로 한 번에 보낸다 (재접속이 몰려도 방마다 알림 하나, 0 이면 바로)
+ *  - 재접속 폭주 대비: 새 연결은 입장 대기열에 들어갔다가 --admit-rate 속도로 lobby 에 입장한다.
+ *    그 전에 온 메시지는 읽기를 멈추고 들고 있다가 입장한 뒤에 순서대로 처리한다.
+ *    /session 을 보낸 클라이언트는 방을 옮길 때마다 세션 토큰(이름, 방, 발급 시각 + SipHash MAC)을 받고,
+ *    다시 접속해서 /resume <토큰> 을 보내면 대기열을 건너뛰고 알림 없이 예전 이름과 방으로 돌아간다.
+ *    토큰은 서버에 상태를 남기지 않으므로 --session-key 파일만 같으면 서버를 재시작해도 이어받는다
+ *  - --node/--bus/--peer: 여러 서버 프로세스(노드)가 방을 나눠 쓴다. 노드마다 bus 스레드 하나가 다른 노드와
+ *    Unix 도메인 소켓이나 TCP 링크를 맺고, 방 관심(SUB/UNSUB)을 주고받아 그 방 멤버가 있는 노드에만
+ *    메시지를 한 번씩 보낸다 (클라이언트마다가 아니라 노드마다). 메시지에는 (노드, 번호) ID 가 붙어서
+ *    다시 접속할 때 못 받은 것을 다시 보내 주고, 받은 쪽은 노드마다 최근 번호 창으로 중복을 버린다
+ */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
-#include <pthread.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/random.h>
+#include "fastlog.h"   // 비동기 로거: 이벤트 루프가 콘솔 출력에 막히지 않도록
+#include "seglog.h"    // 방 기록을 재시작 뒤에도 남기는 mmap 세그먼트 로그
+#include "spsc_ring.h" // reactor 사이에 메시지를 넘기는 링
 
 #define BUF_SIZE 1024
-#define MAX_CLIENTS 100 
+#define MAX_MSG 1024               // 메시지 본문 최대 길이. 더 긴 줄은 잘라서 보내고, 더 긴 프레임은 끊는다
+#define FRAME_HDR 4                // 프레임 길이 머리 (big-endian)
+#define IN_MAX (FRAME_HDR + MAX_MSG) // 다 못 받은 메시지를 들고 있을 입력 버퍼 크기
+#define MAX_EVENTS 256
+#define MAX_IOV 64                 // writev 한 번에 넘길 최대 버퍼 수
+#define ACCEPT_BUDGET 64           // 루프 한 바퀴에 accept 할 최대 연결 수
+#define DEFAULT_HWM (256 * 1024)   // 클라이언트별 출력 큐 상한 (바이트)
+#define DEFAULT_MAX_QUEUE 1024     // 클라이언트별 출력 큐 상한 (메시지 개수)
+#define QENT_BATCH 256             // 큐 원소 풀이 비었을 때 한 번에 할당할 개수
+#define ROOM_NAME_MAX 32
+#define ROOM_SHARD_BITS 6          // 방 색인 샤드 64 개. 해시 상위 비트로 고른다
+#define ROOM_SHARDS (1u << ROOM_SHARD_BITS)
+#define LIST_MAX 50                // /list 가 보여 주는 최대 방 수
+#define LOBBY "lobby"
+#define DEFAULT_HISTORY 50         // 방마다 들고 있을 최근 메시지 수
+#define HIST_SEG_SIZE (256 * 1024) // 방 기록 세그먼트 크기 (방마다 두 개)
+#define MAX_THREADS 64             // reactor 수 상한 (방마다 reactor 비트마스크 하나)
+#define FWD_RING 4096              // reactor 쌍마다 링 칸 수. 받는 쪽이 이만큼 밀리면 새 메시지는 버린다
+#define DEFAULT_PRESENCE_MS 1000   // 입장/퇴장 알림을 모아 보내는 간격 (0 이면 바로)
+#define PRESENCE_NAMES 5           // 모은 알림에 이름을 적는 최대 인원 (나머지는 수만)
+#define DEFAULT_ADMIT_RATE 1000    // 초당 새 세션 입장 수 (0 이면 제한 없음)
+#define ADMIT_GRACE_MS 200         // 접속하고 이만큼은 /resume 을 기다린 뒤에 새 세션으로 입장시킨다
+#define DEFAULT_SESSION_TTL 3600   // 세션 토큰 유효 시간 (초)
+#define SESSION_KEY_LEN 16
+#define MAX_NODES 64               // 클러스터 노드 수 상한 (방마다 관심 노드 비트마스크 하나)
+#define BUS_RING 16384             // reactor → bus, bus → reactor 링 칸 수
+#define BUS_REPLAY 8192            // 다시 접속한 노드에 다시 보내 줄 수 있는 최근 메시지 수
+#define BUS_HWM (16 * 1024 * 1024) // 노드 링크 출력 버퍼 상한. 넘치면 끊고, 다시 접속할 때 replay 로 메운다
+#define BUS_FRAME_MAX (64 * 1024)  // 노드 링크 프레임 최대 크기
+#define BUS_RETRY_MS 500           // --peer 로 다시 접속을 시도하는 간격
+#define DEDUP_WINDOW 1024          // 노드마다 기억하는 최근 메시지 번호 수 (2의 거듭제곱)
+
+enum { PROTO_AUTO, PROTO_LINE, PROTO_FRAME };
+
+enum { EV_CONN, EV_CLOSE, EV_MSG, EV_SLOW }; // FASTLOG_SAMPLE=msg=100 처럼 종류별 샘플링
+static const char *const log_events[] = { "conn", "close", "msg", "slow" };
+
+// 브로드캐스트 메시지 하나. 한 번 만들면 바뀌지 않고, 이 메시지를 큐에 든 수신자 수만큼 참조된다.
+// 만든 reactor 안에서만 쓰이므로 참조 카운트는 원자적이지 않다
+struct msg {
+    uint32_t refs;
+    uint32_t len;
+    char data[];
+};
+
+// 출력 큐의 원소: 공유 메시지를 가리키고, 이 수신자에게 어디까지 보냈는지만 따로 든다
+struct qent {
+    struct qent *next;
+    struct msg *m;
+    uint32_t off;                  // 여기까지는 이미 보냄
+};
+
+struct room;
+
+struct client {
+    int fd;
+    int ridx;                      // room->members[] 안의 위치 (swap 으로 빼낼 때 갱신)
+    struct room *room;             // 지금 있는 방 (없으면 NULL)
+    uint32_t events;               // 지금 epoll 에 등록된 이벤트
+    uint8_t dead;                  // 끊기로 함: 이번 배치가 끝나면 정리 (그 전까지 이벤트는 무시)
+    uint8_t dirty;                 // 이번 바퀴에 큐에 새 메시지가 들어옴 (dirty 목록에 있음)
+    uint8_t proto;                 // PROTO_*. AUTO 면 첫 바이트를 보고 정한다
+    uint8_t admitted;              // 입장함 (새 세션이나 /resume). 그 전에는 입장 대기열에 있다
+    uint8_t held;                  // 입장 전에 온 메시지를 in 에 들고 읽기를 멈춤 (입장하면 이어서 처리)
+    uint8_t session;               // /session 이나 /resume 을 보냄: 방을 옮길 때마다 세션 토큰을 보낸다
+    uint16_t inlen;                // in 에 든 바이트 수
+    char *in;                      // 다 못 받은 메시지 (있을 때만 할당)
+    size_t pending;                // 출력 큐에 남은 바이트
+    uint32_t queued;               // 출력 큐에 든 메시지 수
+    uint32_t dropped;              // --slow=drop 으로 버린 메시지 수 (큐가 비면 한 번 알리고 0 으로)
+    struct qent *head, *tail;      // 출력 큐 (유휴 클라이언트는 비어 있다)
+    struct client *next_dead;      // graveyard 목록 링크
+    struct client *next_dirty;     // dirty 목록 링크
+    struct client *admit_prev, *admit_next; // 입장 대기열 링크
+    uint64_t admit_at;             // 이 시각(ms) 이후에 새 세션으로 입장시킨다
+    char name[INET_ADDRSTRLEN + 8]; // "ip:port" (메시지 머리에 붙임)
+};
+
+// 방 색인 항목의 머리. struct room 과 struct chan 모두 맨 앞에 둔다
+struct hnode {
+    struct hnode *next;            // 같은 버킷의 다음 항목
+    uint32_t hash;
+};
+
+// 방 하나의 reactor 공용 부분: 기록과 전체 인원. 방이 있는 reactor 가 하나라도 있으면 살아 있다
+struct chan {
+    struct hnode node;
+    uint32_t refs;                 // 이 방의 struct room 을 가진 reactor 수 (chan 샤드 락)
+    uint32_t members;              // 모든 reactor 의 멤버 수 합 (원자적)
+    uint64_t where;                // 멤버가 있는 reactor 비트마스크 (원자적). 메시지를 넘길 곳
+    pthread_mutex_t lock;          // 아래 기록을 지킨다
+    struct hent **hist;            // 최근 메시지 링 (history 칸, 처음 기록할 때 할당)
+    uint32_t hist_head, hist_count; // 가장 오래된 칸, 든 개수
+    struct seglog *log;            // --history-dir 이 있을 때 링을 붙여 쓰는 로그
+    char name[ROOM_NAME_MAX + 1];
+};
+
+// 방 하나의 reactor 몫: 이 reactor 의 멤버 배열. 필요할 때 두 배로 늘린다. 마지막 멤버가 나가면 해제한다
+struct room {
+    struct hnode node;
+    int count, cap;
+    struct client **members;
+    struct chan *ch;
+    struct presence *pres;         // 아직 안 보낸 입장/퇴장 (--presence-ms). 있으면 멤버가 없어도 보낼 때까지 남는다
+    struct room *next_pres;        // 알림 목록 링크
+};
+
+// 방 하나에 모인 입장/퇴장. 이름은 PRESENCE_NAMES 명까지만 적고 나머지는 센다
+struct presence {
+    uint32_t in, out;
+    struct client *joiner;         // 처음 들어온 사람 (방을 나가면 NULL). 혼자면 알림에서 뺀다
+    char in_names[PRESENCE_NAMES][INET_ADDRSTRLEN + 8];
+    char out_names[PRESENCE_NAMES][INET_ADDRSTRLEN + 8];
+};
+
+// 방 기록 한 칸: 브로드캐스트한 본문 ("[ip:port]: 메시지")
+struct hent {
+    uint32_t len;
+    char text[];
+};
+
+// 방 색인 샤드. 샤드마다 따로 늘어나므로 rehash 한 번은 방 전체의 1/64 만 옮긴다
+struct room_shard {
+    struct hnode **buckets;
+    uint32_t mask;                 // 버킷 수 - 1 (0 이면 아직 할당 안 함)
+    uint32_t count;
+};
+
+// reactor 끼리 넘기는 메시지. 한 번 만들어 받을 reactor 모두의 링에 같은 포인터를 넣고, 마지막으로 읽은 쪽이 해제한다
+struct fwd {
+    uint32_t refs;                 // 아직 안 읽은 reactor 수 (원자적). bus 도 하나로 센다
+    uint32_t hash;                 // 방 이름 해시 (받는 쪽에서 다시 계산하지 않게)
+    uint32_t len;
+    uint8_t hist;                  // 클라이언트 메시지: 다른 노드도 방 기록에 남긴다 (알림은 0)
+    uint8_t name_len;
+    char name[ROOM_NAME_MAX];
+    char text[];
+};
+
+// reactor 하나 = 스레드 하나 = epoll 인스턴스 하나. 클라이언트와 방 멤버 배열은 자기 reactor 만 건드린다
+struct reactor {
+    int id;
+    int epfd, serv_sock;
+    int efd;                       // 다른 reactor 가 링에 넣고 깨우는 eventfd (epoll data.ptr == reactor)
+    int reserve_fd;                // fd 가 바닥났을 때 연결을 받아서 끊어 주기 위한 예비 fd
+    int client_count;              // 이 reactor 에 접속 중인 클라이언트 수
+    struct room_shard rooms[ROOM_SHARDS]; // 방 이름 → 이 reactor 의 방
+    struct qent *qent_pool;        // 다 쓴 큐 원소 (free list)
+    struct client *graveyard;      // 배치가 끝나면 정리할 클라이언트
+    struct client *dirty_list;     // 바퀴가 끝나면 보낼 클라이언트
+    uint64_t notify;               // 이번 바퀴에 링에 넣은 reactor 비트마스크 (바퀴 끝에 한 번씩 깨운다)
+    uint64_t fwd_dropped;          // 링이 가득 차서 버린 메시지 수 (바퀴 끝에 한 번 알린다)
+    uint8_t notify_bus;            // 이번 바퀴에 bus 링에 넣음
+    struct client *admit_head, *admit_tail; // 입장 대기열 (접속 순)
+    double admit_tokens;           // 새 세션 토큰 버킷 (초당 admit_rate / nthreads 개씩 찬다)
+    uint64_t admit_last;           // 버킷을 마지막으로 채운 시각 (ms)
+    struct room *pres_list;        // 보낼 알림이 있는 방
+    uint64_t pres_due;             // 알림을 보낼 시각 (ms)
+    pthread_t tid;
+} __attribute__((aligned(64)));
 
-void * handle_client(void * arg); 
-void broadcast_msg(char * msg, int sender_sock); 
+// 다른 노드와의 링크 하나 (우리가 걸었거나 받은 연결). 프레임: 4바이트 big-endian 길이 + 종류 1바이트 + 본문
+struct link {
+    int fd;
+    int slot;                      // nodes[] 자리 (HELLO 를 받기 전에는 -1)
+    uint8_t connecting;            // 논블로킹 connect 진행 중
+    uint8_t ready;                 // 상대의 관심 목록을 다 받음 (READY). 이때부터 메시지를 보낸다
+    uint8_t dead;                  // 끊기로 함: 바퀴 끝에 정리
+    uint32_t events;
+    uint64_t replay_from;          // 상대가 ACK 로 알려 준, 아직 못 받은 첫 번호
+    struct target *target;         // 우리가 건 연결이면 --peer 항목
+    char *in;                      // 다 못 받은 프레임 (BUS_FRAME_MAX)
+    uint32_t inlen;
+    char *out;                     // 못 보낸 바이트
+    size_t outlen, outcap;
+    struct link *next;
+};
+
+// --peer 로 준 주소. 링크가 없으면 BUS_RETRY_MS 마다 다시 건다
+struct target {
+    const char *addr;
+    struct link *link;
+    int slot;                      // 한 번이라도 HELLO 를 받았으면 그 노드 자리
+    uint64_t retry_at;
+};
+
+// 아는 노드 하나: 지금 링크와 중복 제거 창. 노드가 재시작하면 (boot 가 바뀌면) 창을 비운다
+struct node {
+    uint16_t id;
+    uint32_t boot;
+    struct link *link;
+    uint64_t top;                  // 받은 가장 큰 번호
+    uint64_t win[DEDUP_WINDOW / 64]; // top 아래 DEDUP_WINDOW 개 중 받은 번호 비트
+};
+
+// bus 가 아는 방: 이 노드에 멤버가 있는지, 멤버가 있는 다른 노드들 (nodes[] 자리 비트마스크)
+struct iroom {
+    struct hnode node;
+    uint8_t local;
+    uint8_t name_len;
+    uint64_t remote;
+    char name[ROOM_NAME_MAX];
+};
+
+// 방이 생기거나 없어졌다는 알림 (chan_get/chan_put 이 샤드 락을 쥔 채 넣으므로 방 하나의 순서가 지켜진다)
+struct busctl {
+    struct busctl *next;
+    uint8_t sub;
+    uint8_t name_len;
+    uint32_t hash;
+    char name[ROOM_NAME_MAX];
+};
+
+// 노드 사이 중계. 스레드 하나, epoll 하나. reactor 와는 링 (메시지) 과 eventfd 로만 주고받는다
+struct bus {
+    int epfd, efd, lsock;
+    struct spsc_ring in[MAX_THREADS]; // reactor → bus
+    struct spsc_ring out[MAX_THREADS]; // bus → reactor
+    uint64_t notify;               // 이번 바퀴에 out 링에 넣은 reactor 비트마스크
+    pthread_mutex_t ctl_lock;      // 아래 ctl 목록
+    struct busctl *ctl_head, **ctl_tail;
+    struct link *links;
+    struct target targets[MAX_NODES];
+    int ntargets;
+    struct node nodes[MAX_NODES];
+    int nnodes;
+    struct room_shard rooms[ROOM_SHARDS]; // 방 이름 → iroom
+    struct { uint64_t seq; struct fwd *f; } replay[BUS_REPLAY]; // 최근에 보낸 메시지 (seq % BUS_REPLAY)
+    uint64_t seq;                  // 마지막으로 붙인 메시지 번호 (1 부터)
+    uint32_t boot;                 // 이번 실행의 번호 (재시작을 알아보게)
+    uint64_t dropped, dups;        // 링이 차서 버린 수, 중복이라 버린 수 (링크가 끊길 때 알린다)
+    pthread_t tid;
+};
+
+void accept_clients(void);
+void handle_read(struct client *c);
+void handle_write(struct client *c);
+void deliver(struct client *c, const char *text, size_t len);
+void broadcast_msg(struct room *r, const char *msg, size_t len, struct client *sender);
+void room_send(struct room *r, const char *text, size_t len, struct client *sender);
+static void forward(struct chan *ch, const char *text, size_t len, int hist);
+void command(struct client *c, const char *text, size_t len);
+static void reply(struct client *c, const char *fmt, ...);
+static void consume_input(struct client *c, char *buf, size_t have);
+void record_history(struct chan *ch, const char *text, size_t len);
+void replay_history(struct client *c);
+int join_room(struct client *c, const char *name, size_t len, int quiet);
+void kill_client(struct client *c, const char *why);
+void flush_dirty(void);
+void reap_clients(void);
+void drain_rings(void);
+void wake_peers(void);
+void admit_clients(void);
+void flush_presence(void);
+static void bus_ctl(int sub, const char *name, size_t len, uint32_t h);
+static void bus_init(const char **peers, int npeers);
+static void *bus_main(void *arg);
 void error_handling(char * message);
 
-int client_socks[MAX_CLIENTS]; 
-int client_count = 0; 
-pthread_mutex_t clients_mutex; 
+static __thread struct reactor *me; // 이 스레드의 reactor
+struct reactor *reactors;
+int nthreads = 1;                  // --threads
+int pin = 0;                       // --pin
+struct spsc_ring *rings;           // rings[받는 쪽 * nthreads + 보내는 쪽]
+struct room_shard chans[ROOM_SHARDS]; // 방 이름 → chan (샤드마다 chan_locks 로 지킨다)
+pthread_mutex_t chan_locks[ROOM_SHARDS];
+uint32_t chan_count = 0;           // 방 수 (원자적)
+int max_clients = 0;               // --max-clients (0 이면 fd 한도까지). reactor 마다 나눠 갖는다
+size_t hwm = DEFAULT_HWM;          // --hwm
+uint32_t max_queue = DEFAULT_MAX_QUEUE; // --max-queue
+int slow_drop = 0;                 // --slow=drop 이면 1 (기본 kick: 끊는다)
+int proto_mode = PROTO_AUTO;       // --proto
+uint32_t history = DEFAULT_HISTORY; // --history (0 이면 기록 안 함)
+const char *history_dir;           // --history-dir (없으면 메모리에만)
+uint32_t presence_ms = DEFAULT_PRESENCE_MS; // --presence-ms
+uint32_t admit_rate = DEFAULT_ADMIT_RATE;   // --admit-rate
+uint32_t session_ttl = DEFAULT_SESSION_TTL; // --session-ttl
+uint8_t session_key[SESSION_KEY_LEN];       // 세션 토큰 MAC 키 (--session-key 파일, 없으면 실행마다 새로)
+struct bus *bus;                   // 클러스터 중계 (--bus 나 --peer 가 없으면 NULL)
+int node_id;                       // --node
+const char *bus_listen;            // --bus
 
-int main(int argc, char *argv[])
+static void usage(const char *prog)
 {
-    int serv_sock, clnt_sock;
-    struct sockaddr_in serv_addr, clnt_addr;
-    socklen_t clnt_addr_size;
-    pthread_t thread_id; 
-
-    if (argc != 2) {
-        printf("Usage : %s <port>\n", argv[0]);
-        exit(1);
-    }
-    // 뮤텍스 초기화, pthread_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr)
-    if (pthread_mutex_init(&clients_mutex, NULL) != 0) {
-        perror("pthread_mutex_init() error");
-        exit(1);
-    }
+    printf("Usage : %s [--threads N] [--pin] [--max-clients N] [--hwm BYTES] [--max-queue N] [--slow=kick|drop]\n"
+           "               [--proto=auto|line|frame] [--history N] [--history-dir DIR] [--presence-ms MS]\n"
+           "               [--admit-rate N] [--session-key FILE] [--session-ttl SEC]\n"
+           "               [--node ID --bus unix:PATH|[HOST:]PORT [--peer ADDR]...] <port>\n", prog);
+}
 
-    serv_sock = socket(PF_INET, SOCK_STREAM, 0);
+// reactor 마다 하나씩 만드는 리슨 소켓. 여러 개면 SO_REUSEPORT 로 같은 포트에 bind 해서
+// 커널이 4-tuple 해시로 새 연결을 나눠 준다 (accept 경쟁도 없다)
+static int create_listen_socket(int port)
+{
+    struct sockaddr_in serv_addr;
+    int sock = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (sock == -1)
+        return -1;
     int opt = 1;
     // 소켓 계층 옵션 설정
-    setsockopt(serv_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (nthreads > 1 && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1)
+        goto fail;
 
     memset(&serv_addr, 0, sizeof(serv_addr));
     serv_addr.sin_family = AF_INET;
     serv_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    serv_addr.sin_port = htons(atoi(argv[1]));
+    serv_addr.sin_port = htons(port);
+
+    if (bind(sock, (struct sockaddr*) &serv_addr, sizeof(serv_addr)) == -1)
+        goto fail;
+    if (listen(sock, SOMAXCONN) == -1) // 접속이 몰려도 커널 backlog 에서 기다리게
+        goto fail;
+    return sock;
+fail:
+    close(sock);
+    return -1;
+}
 
-    if (bind(serv_sock, (struct sockaddr*) &serv_addr, sizeof(serv_addr)) == -1)
+// 지금 스레드를 허용된 CPU 목록 중 (id % 개수) 번째 CPU 에 고정
+static void pin_to_cpu(int id)
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+        perror("sched_getaffinity");
+        return;
+    }
+    int ncpu = CPU_COUNT(&allowed);
+    if (ncpu <= 0)
+        return;
+    int target = id % ncpu;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed) || target-- > 0)
+            continue;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            FLOG(FLOG_WARN, "reactor %d: pthread_setaffinity_np failed", id);
+        return;
+    }
+}
+
+static void reactor_init(struct reactor *rt, int id, int port)
+{
+    rt->id = id;
+    rt->serv_sock = create_listen_socket(port);
+    if (rt->serv_sock == -1)
         error_handling("bind() error");
-    if (listen(serv_sock, 5) == -1)
-        error_handling("listen() error");
+    rt->epfd = epoll_create1(0);
+    if (rt->epfd == -1)
+        error_handling("epoll_create1() error");
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL }; // 리슨 소켓은 data.ptr == NULL
+    if (epoll_ctl(rt->epfd, EPOLL_CTL_ADD, rt->serv_sock, &ev) == -1)
+        error_handling("epoll_ctl() error");
+    rt->efd = -1;
+    if (nthreads > 1 || bus) {
+        rt->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (rt->efd == -1)
+            error_handling("eventfd() error");
+        ev.data.ptr = rt;          // eventfd 는 data.ptr == reactor 자신
+        if (epoll_ctl(rt->epfd, EPOLL_CTL_ADD, rt->efd, &ev) == -1)
+            error_handling("epoll_ctl() error");
+    }
+    rt->reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// 다음 할 일(입장 대기열, 알림)까지 남은 ms. 없으면 -1 (이벤트가 올 때까지 잔다)
+static int next_timeout(void)
+{
+    uint64_t due = UINT64_MAX, now = now_ms();
+    if (me->pres_list)
+        due = me->pres_due;
+    if (me->admit_head) {
+        uint64_t t = me->admit_head->admit_at;
+        if (admit_rate && me->admit_tokens < 1) { // 토큰 하나가 찰 때까지
+            uint64_t refill = me->admit_last + (uint64_t)((1 - me->admit_tokens) * 1000 * nthreads / admit_rate) + 1;
+            if (refill > t)
+                t = refill;
+        }
+        if (t < due)
+            due = t;
+    }
+    if (due == UINT64_MAX)
+        return -1;
+    return due > now ? (int)(due - now) : 0;
+}
+
+// 세션 토큰 키: 파일이 있으면 읽고, 없으면 새로 만들어 저장한다 (재시작한 서버도 같은 키로 토큰을 확인하도록)
+static void load_session_key(const char *path)
+{
+    if (path) {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd != -1) {
+            ssize_t r = read(fd, session_key, sizeof(session_key));
+            close(fd);
+            if (r != sizeof(session_key)) {
+                fprintf(stderr, "%s: session key must be %d bytes\n", path, SESSION_KEY_LEN);
+                exit(1);
+            }
+            return;
+        }
+    }
+    if (getrandom(session_key, sizeof(session_key), 0) != sizeof(session_key))
+        error_handling("getrandom() error");
+    if (path) {
+        int fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (fd == -1 || write(fd, session_key, sizeof(session_key)) != sizeof(session_key))
+            error_handling("session key write error");
+        close(fd);
+    }
+}
 
-    printf("Multi-Thread Chat Server started on port %s...\n", argv[1]);
+static void *reactor_main(void *arg)
+{
+    me = arg;
+    if (pin)
+        pin_to_cpu(me->id);
+    me->admit_last = now_ms();
+    me->admit_tokens = admit_rate ? (double)admit_rate / nthreads : 0; // 1 초 분량까지 한 번에
 
-    while (1) 
+    struct epoll_event events[MAX_EVENTS];
+    while (1)
     {
-        clnt_addr_size = sizeof(clnt_addr);
-        clnt_sock = accept(serv_sock, (struct sockaddr*) &clnt_addr, &clnt_addr_size);
+        int n = epoll_wait(me->epfd, events, MAX_EVENTS, next_timeout());
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait() error");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            void *p = events[i].data.ptr;
+            if (!p) {
+                accept_clients();
+                continue;
+            }
+            if (p == me) {         // 다른 reactor 가 넘긴 메시지
+                drain_rings();
+                continue;
+            }
+            struct client *c = p;
+            if (c->dead) // 이번 배치에서 이미 끊기로 한 클라이언트
+                continue;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                kill_client(c, NULL);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT)
+                handle_write(c);
+            if ((events[i].events & EPOLLIN) && !c->dead)
+                handle_read(c);
+        }
+        admit_clients();           // 대기열에서 시간이 된 연결을 새 세션으로 입장시킨다
+        if (me->pres_list && now_ms() >= me->pres_due)
+            flush_presence();      // 모아 둔 입장/퇴장 알림을 방마다 하나씩
+        // 이번 바퀴에 쌓인 메시지를 클라이언트마다 writev 한 번으로 보낸다.
+        // 끊은 클라이언트는 배치가 끝난 뒤에 정리한다.
+        // 브로드캐스트 중에 느린 수신자를 끊어도, 같은 배치의 뒤쪽 이벤트가 해제된 구조체를 가리키지 않는다.
+        // 퇴장 알림이 또 메시지를 쌓고, 보내다가 또 끊을 수 있으므로 둘 다 빌 때까지 돈다
+        while (me->dirty_list || me->graveyard) {
+            flush_dirty();
+            reap_clients();
+        }
+        wake_peers();              // 이번 바퀴에 링에 넣은 reactor 마다 eventfd write 한 번
+    }
+
+    close(me->epfd);
+    close(me->serv_sock);
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_opts[] = {
+        {"threads", required_argument, NULL, 't'},
+        {"pin", no_argument, NULL, 'P'},
+        {"max-clients", required_argument, NULL, 'm'},
+        {"hwm", required_argument, NULL, 'w'},
+        {"max-queue", required_argument, NULL, 'q'},
+        {"slow", required_argument, NULL, 's'},
+        {"proto", required_argument, NULL, 'p'},
+        {"history", required_argument, NULL, 'H'},
+        {"history-dir", required_argument, NULL, 'D'},
+        {"presence-ms", required_argument, NULL, 'r'},
+        {"admit-rate", required_argument, NULL, 'a'},
+        {"session-key", required_argument, NULL, 'k'},
+        {"session-ttl", required_argument, NULL, 'T'},
+        {"node", required_argument, NULL, 'n'},
+        {"bus", required_argument, NULL, 'b'},
+        {"peer", required_argument, NULL, 'e'},
+        {NULL, 0, NULL, 0}
+    };
+    const char *session_key_path = NULL;
+    const char *peers[MAX_NODES];
+    int npeers = 0;
+    int ch;
+    while ((ch = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+        switch (ch) {
+        case 't': nthreads = atoi(optarg); break;
+        case 'r': presence_ms = strtoul(optarg, NULL, 10); break;
+        case 'a': admit_rate = strtoul(optarg, NULL, 10); break;
+        case 'k': session_key_path = optarg; break;
+        case 'T': session_ttl = strtoul(optarg, NULL, 10); break;
+        case 'n': node_id = atoi(optarg); break;
+        case 'b': bus_listen = optarg; break;
+        case 'e':
+            if (npeers == MAX_NODES) { usage(argv[0]); exit(1); }
+            peers[npeers++] = optarg;
+            break;
+        case 'P': pin = 1; break;
+        case 'm': max_clients = atoi(optarg); break;
+        case 'w': hwm = strtoull(optarg, NULL, 10); break;
+        case 'q': max_queue = strtoul(optarg, NULL, 10); break;
+        case 's':
+            if (strcmp(optarg, "kick") == 0) slow_drop = 0;
+            else if (strcmp(optarg, "drop") == 0) slow_drop = 1;
+            else { usage(argv[0]); exit(1); }
+            break;
+        case 'H': history = strtoul(optarg, NULL, 10); break;
+        case 'D': history_dir = optarg; break;
+        case 'p':
+            if (strcmp(optarg, "auto") == 0) proto_mode = PROTO_AUTO;
+            else if (strcmp(optarg, "line") == 0) proto_mode = PROTO_LINE;
+            else if (strcmp(optarg, "frame") == 0) proto_mode = PROTO_FRAME;
+            else { usage(argv[0]); exit(1); }
+            break;
+        default: usage(argv[0]); exit(1);
+        }
+    }
+    if (optind != argc - 1 || nthreads < 1 || nthreads > MAX_THREADS || max_clients < 0 ||
+        hwm < BUF_SIZE || max_queue == 0 || ((bus_listen || npeers) && (node_id < 1 || node_id > 65535))) {
+        usage(argv[0]);
+        exit(1);
+    }
+    if ((size_t)history * (BUF_SIZE + 50 + FRAME_HDR) > hwm) { // 기록 전체를 한 번에 보낼 수 있어야 한다
+        fprintf(stderr, "--history %u does not fit in --hwm %zu\n", history, hwm);
+        exit(1);
+    }
+    if (history_dir && mkdir(history_dir, 0755) == -1 && errno != EEXIST)
+        error_handling("mkdir() error");
+    max_clients = (max_clients + nthreads - 1) / nthreads;
+    load_session_key(session_key_path);
+
+    // 클라이언트 수만큼 fd 가 필요하다. soft 한도를 hard 한도까지 올려 둔다 (보통 1024 → 수십만)
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    signal(SIGPIPE, SIG_IGN); // 끊긴 클라이언트에 write 하면 프로세스가 죽지 않고 EPIPE 로 받는다
+
+    for (unsigned s = 0; s < ROOM_SHARDS; s++)
+        pthread_mutex_init(&chan_locks[s], NULL);
+    if (bus_listen || npeers)
+        bus_init(peers, npeers);   // reactor 보다 먼저 (reactor 가 bus 가 있으면 eventfd 를 만든다)
+    // reactor 와 링은 스레드를 띄우기 전에 모두 만든다 (서로의 eventfd 와 링을 바로 쓸 수 있게)
+    reactors = aligned_alloc(64, nthreads * sizeof(*reactors));
+    if (!reactors)
+        error_handling("malloc() error");
+    memset(reactors, 0, nthreads * sizeof(*reactors));
+    for (int i = 0; i < nthreads; i++)
+        reactor_init(&reactors[i], i, atoi(argv[optind]));
+    if (nthreads > 1) {
+        rings = aligned_alloc(64, (size_t)nthreads * nthreads * sizeof(*rings));
+        if (!rings)
+            error_handling("malloc() error");
+        for (int d = 0; d < nthreads; d++)
+            for (int s = 0; s < nthreads; s++)
+                if (d != s && spsc_init(&rings[d * nthreads + s], FWD_RING) == -1)
+                    error_handling("malloc() error");
+    }
+
+    fastlog_init(log_events, sizeof(log_events) / sizeof(log_events[0]));
+    FLOG(FLOG_INFO, "Event-loop Chat Server started on port %s... (%d reactor%s)",
+         argv[optind], nthreads, nthreads > 1 ? "s" : "");
+    if (bus) {
+        FLOG(FLOG_INFO, "node %d: bus %s, %d peer%s", node_id, bus_listen ? bus_listen : "-",
+             bus->ntargets, bus->ntargets == 1 ? "" : "s");
+        if (pthread_create(&bus->tid, NULL, bus_main, bus) != 0)
+            error_handling("pthread_create() error");
+    }
+
+    // 스레드 1개면 예전처럼 main 스레드에서 바로 루프를 돈다. 여러 개면 0 번은 main 스레드가 맡는다
+    for (int i = 1; i < nthreads; i++)
+        if (pthread_create(&reactors[i].tid, NULL, reactor_main, &reactors[i]) != 0)
+            error_handling("pthread_create() error");
+    reactor_main(&reactors[0]);
+    for (int i = 1; i < nthreads; i++)
+        pthread_join(reactors[i].tid, NULL);
+    return 0;
+}
+
+// 출력 큐 상태에 맞게 EPOLLOUT 을 켜고 끈다 (바뀔 때만 epoll_ctl)
+static void update_events(struct client *c)
+{
+    uint32_t want = (c->held ? 0 : EPOLLIN) | (c->head ? EPOLLOUT : 0);
+    if (want == c->events)
+        return;
+    struct epoll_event ev = { .events = want, .data.ptr = c };
+    if (epoll_ctl(me->epfd, EPOLL_CTL_MOD, c->fd, &ev) == -1) {
+        kill_client(c, "epoll_ctl");
+        return;
+    }
+    c->events = want;
+}
+
+// 입장 대기열 끝에 넣는다
+static void admit_enqueue(struct client *c)
+{
+    c->admit_at = now_ms() + ADMIT_GRACE_MS;
+    c->admit_next = NULL;
+    c->admit_prev = me->admit_tail;
+    if (me->admit_tail) me->admit_tail->admit_next = c;
+    else me->admit_head = c;
+    me->admit_tail = c;
+}
+
+static void admit_unlink(struct client *c)
+{
+    if (c->admit_prev) c->admit_prev->admit_next = c->admit_next;
+    else me->admit_head = c->admit_next;
+    if (c->admit_next) c->admit_next->admit_prev = c->admit_prev;
+    else me->admit_tail = c->admit_prev;
+    c->admit_prev = c->admit_next = NULL;
+}
+
+// 대기열 앞에서부터 시간이 된 연결을 새 세션으로 lobby 에 입장시킨다.
+// --admit-rate 가 있으면 토큰 버킷이 허락하는 만큼만. 나머지는 다음 바퀴에 (next_timeout 이 깨운다)
+void admit_clients(void)
+{
+    if (!me->admit_head)
+        return;
+    uint64_t now = now_ms();
+    if (admit_rate) {
+        double per_ms = (double)admit_rate / nthreads / 1000, burst = (double)admit_rate / nthreads;
+        me->admit_tokens += (now - me->admit_last) * per_ms;
+        if (me->admit_tokens > burst)
+            me->admit_tokens = burst;
+    }
+    me->admit_last = now;
+    struct client *next;
+    for (struct client *c = me->admit_head; c && c->admit_at <= now; c = next) {
+        next = c->admit_next;
+        if (c->dead)               // 대기 중에 끊김: reap_clients 가 대기열에서 뺀다
+            continue;
+        if (admit_rate) {
+            if (me->admit_tokens < 1)
+                break;
+            me->admit_tokens -= 1;
+        }
+        admit_unlink(c);
+        c->admitted = 1;
+        if (join_room(c, LOBBY, strlen(LOBBY), 0) == -1) {
+            kill_client(c, "malloc");
+            continue;
+        }
+        if (c->held) {             // 기다리는 동안 온 메시지를 이제 처리하고 다시 읽는다
+            char buf[IN_MAX + BUF_SIZE];
+            size_t have = c->inlen;
+            memcpy(buf, c->in, have);
+            c->held = 0;
+            update_events(c);
+            consume_input(c, buf, have);
+        }
+    }
+}
+
+// 리슨 소켓이 읽기 가능: 대기 중인 연결을 ACCEPT_BUDGET 개까지 받는다
+void accept_clients(void)
+{
+    for (int budget = ACCEPT_BUDGET; budget > 0; budget--) {
+        struct sockaddr_in clnt_addr;
+        socklen_t clnt_addr_size = sizeof(clnt_addr);
+        int clnt_sock = accept4(me->serv_sock, (struct sockaddr*) &clnt_addr, &clnt_addr_size,
+                                SOCK_NONBLOCK | SOCK_CLOEXEC);
         if (clnt_sock == -1) {
-            perror("accept() error"); 
-            continue; 
-        }
-       
-        // 뮤텍스 잠금, pthread_mutex_lock(pthread_mutex_t *mutex)
-        // 잠궜으면 다른 스레드는 대기
-        pthread_mutex_lock(&clients_mutex); 
-        if (client_count < MAX_CLIENTS) {
-            client_socks[client_count++] = clnt_sock;
-        } else {
-            printf("Max clients reached. Connection rejected.\n");
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return;
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if ((errno == EMFILE || errno == ENFILE) && me->reserve_fd != -1) {
+                // fd 고갈: 예비 fd 를 잠깐 놓고 대기 중인 연결 하나를 받아 바로 닫는다
+                // (안 받으면 level-triggered 리슨 소켓이 계속 깨운다)
+                close(me->reserve_fd);
+                int shed = accept(me->serv_sock, NULL, NULL);
+                if (shed != -1)
+                    close(shed);
+                me->reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                FLOG(FLOG_WARN, "Out of fds. Connection rejected.");
+                return;
+            }
+            perror("accept() error");
+            return;
+        }
+
+        if (max_clients && me->client_count >= max_clients) {
+            FLOG(FLOG_WARN, "Max clients reached. Connection rejected.");
+            close(clnt_sock);
+            continue;
+        }
+        struct client *c = calloc(1, sizeof(*c));
+        if (!c) {
             close(clnt_sock);
-            // 뮤텍스 잠금 해제
-            pthread_mutex_unlock(&clients_mutex); 
             continue;
         }
-        pthread_mutex_unlock(&clients_mutex); 
+        c->fd = clnt_sock;
+        c->events = EPOLLIN;
+        c->proto = proto_mode;
+        // 입장/퇴장 알림과 메시지 머리에 쓸 "ip:port" 를 한 번만 만들어 둔다
+        char clnt_ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &clnt_addr.sin_addr, clnt_ip, sizeof(clnt_ip));
+        snprintf(c->name, sizeof(c->name), "%s:%d", clnt_ip, ntohs(clnt_addr.sin_port));
 
-        if (pthread_create(&thread_id, NULL, handle_client, (void *)(intptr_t)clnt_sock) != 0) {
-            // intptr_t: 정수 값(소켓 번호) 자체를 보내기 위해 사용
-            perror("pthread_create() error");
-            pthread_mutex_lock(&clients_mutex);
-            client_count--;
-            pthread_mutex_unlock(&clients_mutex);
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        if (epoll_ctl(me->epfd, EPOLL_CTL_ADD, clnt_sock, &ev) == -1) {
+            perror("epoll_ctl() error");
             close(clnt_sock);
+            free(c);
+            continue;
+        }
+        me->client_count++;
+        FLOG_EV(EV_CONN, FLOG_INFO, "New client connected. (" FLOG_ADDR_FMT ", Socket: %d)",
+                FLOG_ADDR_ARGS(&clnt_addr), clnt_sock);
+
+        // 바로 입장시키지 않고 대기열에 넣는다. ADMIT_GRACE_MS 안에 /resume 이 오면 예전 세션으로,
+        // 아니면 --admit-rate 속도에 맞춰 새 세션으로 lobby 에 입장한다 (admit_clients)
+        admit_enqueue(c);
+    }
+}
+
+// 입장 전에는 /resume 과 /session 만 처리한다. 다른 메시지가 오면 그 메시지부터 in 에 들고 읽기를 멈춘다.
+// 커널 수신 버퍼가 대신 쌓아 두고, 입장하면 (admit_clients) 받은 순서대로 이어서 처리한다
+static int hold_input(struct client *c, const char *text, size_t len)
+{
+    if (c->admitted)
+        return 0;
+    if ((len >= 7 && memcmp(text, "/resume", 7) == 0 && (len == 7 || text[7] == ' ')) ||
+        (len >= 8 && memcmp(text, "/session", 8) == 0 && (len == 8 || text[8] == ' ' || text[8] == '\r')))
+        return 0;
+    c->held = 1;
+    update_events(c);
+    return 1;
+}
+
+// buf 의 다 받은 메시지마다 전달하고, 남은 조각은 in 에 보관한다. buf 는 IN_MAX + BUF_SIZE 바이트
+static void consume_input(struct client *c, char *buf, size_t have)
+{
+    if (c->proto == PROTO_AUTO)    // 글자는 0 으로 시작하지 않고, MAX_MSG 이하 길이의 첫 바이트는 0 이다
+        c->proto = buf[0] == 0 ? PROTO_FRAME : PROTO_LINE;
+
+    size_t pos = 0;
+    if (c->proto == PROTO_FRAME) {
+        while (have - pos >= FRAME_HDR && !c->dead && !c->held) {
+            const unsigned char *h = (const unsigned char *)buf + pos;
+            uint32_t len = (uint32_t)h[0] << 24 | (uint32_t)h[1] << 16 | (uint32_t)h[2] << 8 | h[3];
+            if (len > MAX_MSG) {
+                FLOG(FLOG_WARN, "(%s) frame too large (%u bytes), disconnecting", c->name, len);
+                kill_client(c, NULL);
+                return;
+            }
+            if (have - pos < FRAME_HDR + len)
+                break;
+            if (len && hold_input(c, buf + pos + FRAME_HDR, len))
+                break;
+            if (len)               // 길이 0 프레임은 모드를 알리는 용도라 전달하지 않는다
+                deliver(c, buf + pos + FRAME_HDR, len);
+            pos += FRAME_HDR + len;
+        }
+    } else {
+        while (pos < have && !c->dead && !c->held) {
+            char *nl = memchr(buf + pos, '\n', have - pos);
+            if (!nl) {
+                if (have - pos < MAX_MSG)
+                    break;
+                if (hold_input(c, buf + pos, MAX_MSG))
+                    break;
+                deliver(c, buf + pos, MAX_MSG); // 너무 긴 줄은 MAX_MSG 씩 잘라서 보낸다
+                pos += MAX_MSG;
+                continue;
+            }
+            if (hold_input(c, buf + pos, nl - (buf + pos)))
+                break;
+            deliver(c, buf + pos, nl - (buf + pos));
+            pos = nl - buf + 1;
+        }
+    }
+
+    // 남은 조각만 보관한다. 메시지를 다 받은 클라이언트는 입력 버퍼를 들고 있지 않는다.
+    // 멈춘 동안에는 한 번 읽은 양까지 들고 있어야 하므로 버퍼를 키운다
+    c->inlen = have - pos;
+    if (c->inlen) {
+        if (c->held) {
+            char *in = realloc(c->in, IN_MAX + BUF_SIZE);
+            if (!in) {
+                kill_client(c, "malloc");
+                return;
+            }
+            c->in = in;
+        } else if (!c->in && !(c->in = malloc(IN_MAX))) {
+            kill_client(c, "malloc");
+            return;
+        }
+        memmove(c->in, buf + pos, c->inlen);
+    } else if (c->in) {
+        free(c->in);
+        c->in = NULL;
+    }
+}
+
+// 읽기 가능: 한 번 읽어서 다 받은 메시지마다 다른 클라이언트들에게 전달한다. 나머지는 다음 read 까지 들고 있는다.
+// 한 이벤트에 read 한 번이라 쉬지 않고 보내는 클라이언트가 있어도 다른 클라이언트 차례가 온다
+void handle_read(struct client *c)
+{
+    char buf[IN_MAX + BUF_SIZE];
+    size_t have = c->inlen;
+
+    if (have)
+        memcpy(buf, c->in, have);
+    ssize_t str_len = read(c->fd, buf + have, BUF_SIZE);
+    if (str_len == 0) {            // 클라이언트가 나감
+        kill_client(c, NULL);
+        return;
+    }
+    if (str_len == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return;
+        kill_client(c, "read");
+        return;
+    }
+    consume_input(c, buf, have + str_len);
+}
+
+// 메시지 하나를 받음: '/' 로 시작하면 명령, 아니면 보낸 사람 이름을 붙여 같은 방에 브로드캐스트한다
+void deliver(struct client *c, const char *text, size_t len)
+{
+    char broadcast_buffer[BUF_SIZE + 50];
+
+    if (len && text[0] == '/') {
+        command(c, text, len);
+        return;
+    }
+
+    FLOG_EV(EV_MSG, FLOG_INFO, "[%s]: %.*s", c->name, (int)len, text); // 서버 콘솔 출력
+
+    // 브로드캐스트 메시지 (프롬프트 미포함)
+    int n = snprintf(broadcast_buffer, sizeof(broadcast_buffer), "[%s]: %.*s", c->name, (int)len, text);
+    if (!c->room)
+        return;
+    broadcast_msg(c->room, broadcast_buffer, n, c); // sender를 제외하고 전송
+    forward(c->room->ch, broadcast_buffer, n, 1);
+    record_history(c->room->ch, broadcast_buffer, n); // 기록은 받은 reactor 만 남긴다 (다른 노드는 그 노드의 bus 가)
+}
+
+// 본문 하나를 수신자 형식으로 쓴 크기. 줄 모드: "\r" + 본문 + "\n", 프레임 모드: 길이 머리 + 본문
+static size_t wire_len(int proto, size_t len)
+{
+    return proto == PROTO_FRAME ? FRAME_HDR + len : len + 2;
+}
+
+// 본문 하나를 수신자 형식으로 dst 에 쓰고 쓴 크기를 돌려준다
+static size_t wire_put(char *dst, int proto, const char *text, size_t len)
+{
+    if (proto == PROTO_FRAME) {
+        unsigned char *h = (unsigned char *)dst;
+        h[0] = len >> 24; h[1] = len >> 16; h[2] = len >> 8; h[3] = len;
+        memcpy(dst + FRAME_HDR, text, len);
+    } else {
+        dst[0] = '\r';
+        memcpy(dst + 1, text, len);
+        dst[len + 1] = '\n';
+    }
+    return wire_len(proto, len);
+}
+
+static struct msg *msg_alloc(size_t total)
+{
+    struct msg *m = malloc(sizeof(*m) + total);
+    if (!m)
+        return NULL;
+    m->refs = 1;                   // 만든 쪽(broadcast_msg)의 참조. 큐에 다 넣은 뒤 놓는다
+    m->len = total;
+    return m;
+}
+
+// 수신자 형식에 맞춘 메시지를 만든다
+static struct msg *msg_new(int proto, const char *text, size_t len)
+{
+    struct msg *m = msg_alloc(wire_len(proto, len));
+    if (m)
+        wire_put(m->data, proto, text, len);
+    return m;
+}
+
+static void msg_put(struct msg *m)
+{
+    if (--m->refs == 0)
+        free(m);
+}
+
+// 큐 원소는 풀에서 꺼낸다. 풀이 비었을 때만 QENT_BATCH 개를 한 번에 할당한다
+static struct qent *qent_get(void)
+{
+    if (!me->qent_pool) {
+        struct qent *blk = malloc(QENT_BATCH * sizeof(*blk));
+        if (!blk)
+            return NULL;
+        for (int i = 0; i < QENT_BATCH; i++) {
+            blk[i].next = me->qent_pool;
+            me->qent_pool = &blk[i];
         }
+    }
+    struct qent *e = me->qent_pool;
+    me->qent_pool = e->next;
+    return e;
+}
 
-        pthread_detach(thread_id); 
-        printf("New client connected. (IP: %s, Socket: %d)\n", inet_ntoa(clnt_addr.sin_addr), clnt_sock);
+// 큐 원소를 풀에 돌려주고 메시지 참조를 놓는다
+static void qent_release(struct qent *e)
+{
+    msg_put(e->m);
+    e->next = me->qent_pool;
+    me->qent_pool = e;
+}
+
+// 출력 큐를 writev 로 보낼 수 있는 만큼 보낸다
+static int flush_queue(struct client *c)
+{
+    while (c->head) {
+        struct iovec iov[MAX_IOV];
+        int cnt = 0;
+        for (struct qent *e = c->head; e && cnt < MAX_IOV; e = e->next, cnt++) {
+            iov[cnt].iov_base = e->m->data + e->off;
+            iov[cnt].iov_len = e->m->len - e->off;
+        }
+        ssize_t w = writev(c->fd, iov, cnt);
+        if (w == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        c->pending -= w;
+        while (w > 0) {
+            struct qent *e = c->head;
+            size_t left = e->m->len - e->off;
+            if ((size_t)w < left) {
+                e->off += w;
+                break;
+            }
+            w -= left;
+            c->head = e->next;
+            c->queued--;
+            qent_release(e);
+        }
+        if (!c->head) c->tail = NULL;
+    }
+    if (c->dropped) { // 밀렸던 클라이언트가 따라잡음: 버린 개수를 한 번만 알린다
+        FLOG_EV(EV_SLOW, FLOG_WARN, "(%s) slow client: %u messages dropped", c->name, c->dropped);
+        c->dropped = 0;
     }
-    
-    close(serv_sock);
-    // 뮤텍스 해제(메모리 반환): 스레드 종료 시 호출
-    // pthread_mutex_destroy(pthread_mutex_t *mutex)
-    pthread_mutex_destroy(&clients_mutex); 
     return 0;
 }
 
-void * handle_client(void * arg)
+// 송신 버퍼에 자리가 생김: 밀린 메시지를 보낸다
+void handle_write(struct client *c)
 {
-    int clnt_sock = (intptr_t)arg;
-    int str_len = 0;
-    char msg[BUF_SIZE];
-    char broadcast_buffer[BUF_SIZE + 50]; 
+    if (flush_queue(c) == -1) {
+        kill_client(c, "writev");
+        return;
+    }
+    update_events(c);
+}
 
-    struct sockaddr_in clnt_addr;
-    socklen_t clnt_addr_size = sizeof(clnt_addr);
-    // 소켓이 연결된 피어의 주소 검색. sockaddr 구조체에 주소 저장
-    getpeername(clnt_sock, (struct sockaddr*)&clnt_addr, &clnt_addr_size);
-    char * clnt_ip = inet_ntoa(clnt_addr.sin_addr);
-    int clnt_port = ntohs(clnt_addr.sin_port);
+// 큐를 보낸다. EPOLLOUT 을 기다리는 클라이언트는 송신 버퍼가 차 있으므로 건너뛴다 (EPOLLOUT 때 보낸다)
+static void flush_client(struct client *c)
+{
+    if (c->events & EPOLLOUT)
+        return;
+    if (flush_queue(c) == -1) {
+        kill_client(c, "writev");
+        return;
+    }
+    update_events(c);
+}
 
-    // 입장 메시지 (프롬프트 미포함)
-    // sprintf(char str, const char format, ...)
-    // : 서식을 지정하여 데이터를 문자열로 만들고, 그 결과를 특정 문자열 버퍼에 저장
-    sprintf(broadcast_buffer, "\r[알림] (%s:%d) 님이 입장하셨습니다.\n", clnt_ip, clnt_port);
-    broadcast_msg(broadcast_buffer, clnt_sock); // sender_sock을 제외하고 전송
+// 한 클라이언트의 큐에 메시지 포인터를 넣는다. 실제 전송은 바퀴가 끝날 때 flush_dirty 에서 몰아서 한다
+static void send_to(struct client *c, struct msg *m)
+{
+    // 안 읽는 클라이언트: 메시지를 무한정 쌓지 않는다
+    if (c->queued >= max_queue || c->pending + m->len > hwm) {
+        if (slow_drop) {
+            if (c->dropped++ == 0)
+                FLOG_EV(EV_SLOW, FLOG_WARN, "(%s) slow client: %u messages, %zu bytes queued, dropping",
+                        c->name, c->queued, c->pending);
+            return;
+        }
+        FLOG_EV(EV_SLOW, FLOG_WARN, "(%s) slow client: %u messages, %zu bytes queued, disconnecting",
+                c->name, c->queued, c->pending);
+        kill_client(c, NULL);
+        return;
+    }
+    struct qent *e = qent_get();
+    if (!e) {
+        kill_client(c, "malloc");
+        return;
+    }
+    e->next = NULL;
+    e->m = m;
+    e->off = 0;
+    m->refs++;
+    if (c->tail) c->tail->next = e;
+    else c->head = e;
+    c->tail = e;
+    c->queued++;
+    c->pending += m->len;
+    if (!c->dirty) {
+        c->dirty = 1;
+        c->next_dirty = me->dirty_list;
+        me->dirty_list = c;
+    }
+    if (c->queued >= MAX_IOV)      // writev 한 번에 다 못 넘길 만큼 쌓였으면 미루지 않고 보낸다
+        flush_client(c);
+}
 
-    while ((str_len = read(clnt_sock, msg, BUF_SIZE - 1)) > 0)
+// [핵심] 방 r 에 있는 사람들에게 보낸 사람(sender)을 "제외"하고 전송
+// 메시지는 수신자 형식별로 많아야 한 번 만들어지고, 수신자마다는 큐에 포인터 하나를 넣는 것뿐이다. 막히는 곳이 없다
+void broadcast_msg(struct room *r, const char *msg, size_t len, struct client *sender)
+{
+    struct msg *m[3] = { NULL, NULL, NULL }; // PROTO_* 별 (아직 아무것도 안 보낸 AUTO 클라이언트는 줄 모드로 받는다)
+    if (!r)
+        return;
+    for (int i = 0; i < r->count; i++)
     {
-        msg[str_len] = 0; 
-        printf("[%s:%d]: %s", clnt_ip, clnt_port, msg); // 서버 콘솔 출력
-        
-        // 브로드캐스트 메시지 (프롬프트 미포함)
-        sprintf(broadcast_buffer, "\r[%s:%d]: %s", clnt_ip, clnt_port, msg); 
-        
-        broadcast_msg(broadcast_buffer, clnt_sock); // sender_sock을 제외하고 전송
-    }
-
-    // --- 종료 처리 ---
-    pthread_mutex_lock(&clients_mutex);
-    for (int i = 0; i < client_count; i++) {
-        if (client_socks[i] == clnt_sock) {
-            client_socks[i] = client_socks[client_count - 1];
-            client_count--;
-            break;
+        struct client *c = r->members[i];
+        // 보낸 사람을 "제외"하는 if문 (끊기로 한 클라이언트도 제외)
+        if (c == sender || c->dead)
+            continue;
+        int proto = c->proto == PROTO_FRAME ? PROTO_FRAME : PROTO_LINE;
+        if (!m[proto] && !(m[proto] = msg_new(proto, msg, len))) {
+            kill_client(c, "malloc");
+            continue;
         }
+        send_to(c, m[proto]);
     }
-    pthread_mutex_unlock(&clients_mutex);
+    for (int p = 0; p < 3; p++)
+        if (m[p])
+            msg_put(m[p]);
+}
 
-    printf("[알림] (%s:%d) 님이 퇴장하셨습니다.\n", clnt_ip, clnt_port);
-    
-    // 퇴장 메시지
-    sprintf(broadcast_buffer, "\r[알림] (%s:%d) 님이 퇴장하셨습니다.\n", clnt_ip, clnt_port);
-    broadcast_msg(broadcast_buffer, clnt_sock); // sender_sock을 제외하고 전송
+// 이번 바퀴에 메시지가 쌓인 클라이언트마다 writev 한 번으로 보낸다
+void flush_dirty(void)
+{
+    while (me->dirty_list) {
+        struct client *c = me->dirty_list;
+        me->dirty_list = c->next_dirty;
+        c->dirty = 0;
+        if (!c->dead)
+            flush_client(c);
+    }
+}
 
-    close(clnt_sock); 
-    return NULL;
+// 한 클라이언트에게만 보내는 안내 (명령 응답)
+static void reply(struct client *c, const char *fmt, ...)
+{
+    char buf[BUF_SIZE + 50];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return;
+    if ((size_t)n >= sizeof(buf))
+        n = sizeof(buf) - 1;
+    int proto = c->proto == PROTO_FRAME ? PROTO_FRAME : PROTO_LINE;
+    struct msg *m = msg_new(proto, buf, n);
+    if (!m) {
+        kill_client(c, "malloc");
+        return;
+    }
+    send_to(c, m);
+    msg_put(m);
 }
 
-// [핵심] 보낸 사람(sender)을 "제외"하고 전송
-void broadcast_msg(char * msg, int sender_sock)
+// 링에 한 칸 추가. 가득 찼으면 가장 오래된 칸을 밀어낸다 (ch->lock 을 잡고, 또는 공개 전에 부름)
+static void hist_push(struct chan *ch, const char *text, size_t len)
 {
-    pthread_mutex_lock(&clients_mutex);
-    
-    for (int i = 0; i < client_count; i++)
-    {
-        // 보낸 사람을 "제외"하는 if문
-        if (client_socks[i] != sender_sock)
-        {
-            if(write(client_socks[i], msg, strlen(msg)) <= 0)
-            {
-                 // 전송 실패
-            }
+    if (!ch->hist && !(ch->hist = calloc(history, sizeof(*ch->hist))))
+        return;
+    struct hent *e = malloc(sizeof(*e) + len);
+    if (!e)
+        return;
+    e->len = len;
+    memcpy(e->text, text, len);
+    if (ch->hist_count == history) {
+        free(ch->hist[ch->hist_head]);
+        ch->hist[ch->hist_head] = e;
+        ch->hist_head = (ch->hist_head + 1) % history;
+    } else {
+        ch->hist[(ch->hist_head + ch->hist_count++) % history] = e;
+    }
+}
+
+static void hist_load_one(void *arg, const char *data, uint32_t len)
+{
+    hist_push(arg, data, len);
+}
+
+// 방 기록 로그를 열고 마지막 history 개로 링을 채운다. 파일 이름은 방 이름의 hex (어떤 이름이든 경로로 안전)
+static void open_history(struct chan *ch)
+{
+    char base[4096];
+    int n = snprintf(base, sizeof(base), "%s/", history_dir);
+    for (const char *p = ch->name; *p && n < (int)sizeof(base) - 3; p++)
+        n += sprintf(base + n, "%02x", (unsigned char)*p);
+    struct seglog *l = malloc(sizeof(*l));
+    if (!l || seglog_open(l, base, HIST_SEG_SIZE) == -1) {
+        FLOG(FLOG_WARN, "(%s) history log open error: %s", ch->name, strerror(errno));
+        free(l);
+        return;
+    }
+    ch->log = l;
+    seglog_tail(l, history, hist_load_one, ch);
+}
+
+// 브로드캐스트한 메시지를 방 기록에 남긴다
+void record_history(struct chan *ch, const char *text, size_t len)
+{
+    if (!history)
+        return;
+    pthread_mutex_lock(&ch->lock);
+    hist_push(ch, text, len);
+    if (ch->log)
+        seglog_append(ch->log, text, len);
+    pthread_mutex_unlock(&ch->lock);
+}
+
+// 새로 들어온 사람에게 방 기록을 메시지 하나로 묶어 보낸다 (writev 한 번)
+void replay_history(struct client *c)
+{
+    if (!c->room || !history)
+        return;
+    struct chan *ch = c->room->ch;
+    int proto = c->proto == PROTO_FRAME ? PROTO_FRAME : PROTO_LINE;
+    pthread_mutex_lock(&ch->lock);
+    if (!ch->hist_count) {
+        pthread_mutex_unlock(&ch->lock);
+        return;
+    }
+    size_t total = 0;
+    for (uint32_t i = 0; i < ch->hist_count; i++)
+        total += wire_len(proto, ch->hist[(ch->hist_head + i) % history]->len);
+    struct msg *m = msg_alloc(total);
+    if (m) {
+        size_t off = 0;
+        for (uint32_t i = 0; i < ch->hist_count; i++) {
+            struct hent *e = ch->hist[(ch->hist_head + i) % history];
+            off += wire_put(m->data + off, proto, e->text, e->len);
         }
     }
-    
-    pthread_mutex_unlock(&clients_mutex); 
+    pthread_mutex_unlock(&ch->lock);
+    if (!m) {
+        kill_client(c, "malloc");
+        return;
+    }
+    send_to(c, m);
+    msg_put(m);
 }
 
-void error_handling(char *message)
+static uint32_t room_hash(const char *name, size_t len)
 {
-    perror(message);
-    exit(1);
-}
\ No newline at end of file
+    uint32_t h = 2166136261u;      // FNV-1a
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    return h;
+}
+
+static unsigned room_shard_idx(uint32_t hash)
+{
+    return hash >> (32 - ROOM_SHARD_BITS);
+}
+
+// 버킷 수를 두 배로 (항목 수가 버킷 수를 넘을 때). 이 샤드의 항목만 옮긴다
+static int room_shard_grow(struct room_shard *sh)
+{
+    uint32_t nb = sh->mask ? (sh->mask + 1) * 2 : 16;
+    struct hnode **b = calloc(nb, sizeof(*b));
+    if (!b)
+        return -1;
+    for (uint32_t i = 0; sh->mask && i <= sh->mask; i++) {
+        while (sh->buckets[i]) {
+            struct hnode *n = sh->buckets[i];
+            sh->buckets[i] = n->next;
+            n->next = b[n->hash & (nb - 1)];
+            b[n->hash & (nb - 1)] = n;
+        }
+    }
+    free(sh->buckets);
+    sh->buckets = b;
+    sh->mask = nb - 1;
+    return 0;
+}
+
+static void room_shard_add(struct room_shard *sh, struct hnode *n)
+{
+    n->next = sh->buckets[n->hash & sh->mask];
+    sh->buckets[n->hash & sh->mask] = n;
+    sh->count++;
+}
+
+static void room_shard_del(struct room_shard *sh, struct hnode *n)
+{
+    struct hnode **pp = &sh->buckets[n->hash & sh->mask];
+    while (*pp != n)
+        pp = &(*pp)->next;
+    *pp = n->next;
+    sh->count--;
+}
+
+static int name_eq(const char *a, const char *name, size_t len)
+{
+    return strlen(a) == len && memcmp(a, name, len) == 0;
+}
+
+// 이름으로 방의 chan 을 찾는다. 없으면 만든다. 찾은 쪽이 참조 하나를 갖는다 (메모리가 없으면 NULL)
+static struct chan *chan_get(const char *name, size_t len, uint32_t h)
+{
+    unsigned s = room_shard_idx(h);
+    struct room_shard *sh = &chans[s];
+    struct chan *ch = NULL;
+    pthread_mutex_lock(&chan_locks[s]);
+    for (struct hnode *n = sh->mask ? sh->buckets[h & sh->mask] : NULL; n; n = n->next) {
+        struct chan *x = (struct chan *)n;
+        if (n->hash == h && name_eq(x->name, name, len)) {
+            ch = x;
+            break;
+        }
+    }
+    if (!ch) {
+        if (sh->count >= sh->mask && room_shard_grow(sh) == -1) // 버킷 수 0 이거나 꽉 참
+            goto out;
+        if (!(ch = calloc(1, sizeof(*ch))))
+            goto out;
+        ch->node.hash = h;
+        memcpy(ch->name, name, len);
+        pthread_mutex_init(&ch->lock, NULL);
+        if (history && history_dir)
+            open_history(ch);
+        room_shard_add(sh, &ch->node);
+        __atomic_add_fetch(&chan_count, 1, __ATOMIC_RELAXED);
+        if (bus)
+            bus_ctl(1, name, len, h); // 다른 노드들에 이 방 메시지를 보내 달라고 알린다
+    }
+    ch->refs++;
+out:
+    pthread_mutex_unlock(&chan_locks[s]);
+    return ch;
+}
+
+// 참조를 놓는다. 방을 가진 reactor 가 하나도 없으면 기록과 함께 해제한다
+static void chan_put(struct chan *ch)
+{
+    unsigned s = room_shard_idx(ch->node.hash);
+    pthread_mutex_lock(&chan_locks[s]);
+    if (--ch->refs == 0) {
+        room_shard_del(&chans[s], &ch->node);
+        __atomic_sub_fetch(&chan_count, 1, __ATOMIC_RELAXED);
+        if (bus)
+            bus_ctl(0, ch->name, strlen(ch->name), ch->node.hash);
+    } else {
+        ch = NULL;
+    }
+    pthread_mutex_unlock(&chan_locks[s]);
+    if (!ch)
+        return;
+    for (uint32_t i = 0; i < ch->hist_count; i++)
+        free(ch->hist[(ch->hist_head + i) % history]);
+    free(ch->hist);
+    if (ch->log) {
+        seglog_close(ch->log);
+        free(ch->log);
+    }
+    pthread_mutex_destroy(&ch->lock);
+    free(ch);
+}
+
+// 이 reactor 의 방을 이름으로 찾는다 (없으면 NULL)
+static struct room *room_find(const char *name, size_t len, uint32_t h)
+{
+    struct room_shard *sh = &me->rooms[room_shard_idx(h)];
+    for (struct hnode *n = sh->mask ? sh->buckets[h & sh->mask] : NULL; n; n = n->next) {
+        struct room *r = (struct room *)n;
+        if (n->hash == h && name_eq(r->ch->name, name, len))
+            return r;
+    }
+    return NULL;
+}
+
+// 이름으로 이 reactor 의 방을 찾는다. 없으면 만든다 (메모리가 없으면 NULL)
+static struct room *room_get(const char *name, size_t len)
+{
+    uint32_t h = room_hash(name, len);
+    struct room *r = room_find(name, len, h);
+    if (r)
+        return r;
+    struct room_shard *sh = &me->rooms[room_shard_idx(h)];
+    if (sh->count >= sh->mask && room_shard_grow(sh) == -1)
+        return NULL;
+    if (!(r = calloc(1, sizeof(*r))))
+        return NULL;
+    if (!(r->ch = chan_get(name, len, h))) {
+        free(r);
+        return NULL;
+    }
+    r->node.hash = h;
+    room_shard_add(sh, &r->node);
+    __atomic_fetch_or(&r->ch->where, 1ull << me->id, __ATOMIC_RELEASE); // 이제 이 reactor 로도 넘겨 달라
+    return r;
+}
+
+static void room_free(struct room *r)
+{
+    room_shard_del(&me->rooms[room_shard_idx(r->node.hash)], &r->node);
+    __atomic_fetch_and(&r->ch->where, ~(1ull << me->id), __ATOMIC_RELEASE);
+    chan_put(r->ch);
+    free(r->members);
+    free(r);
+}
+
+static void fwd_put(struct fwd *f)
+{
+    if (__atomic_sub_fetch(&f->refs, 1, __ATOMIC_ACQ_REL) == 0)
+        free(f);
+}
+
+static struct fwd *fwd_new(uint32_t refs, uint32_t hash, const char *name, size_t name_len,
+                           const char *text, size_t len, int hist)
+{
+    struct fwd *f = malloc(sizeof(*f) + len);
+    if (!f)
+        return NULL;
+    f->refs = refs;
+    f->hash = hash;
+    f->len = len;
+    f->hist = hist;
+    f->name_len = name_len;
+    memcpy(f->name, name, name_len);
+    memcpy(f->text, text, len);
+    return f;
+}
+
+// 같은 방 멤버가 있는 다른 reactor 들의 링에 넣는다. 깨우기는 바퀴가 끝날 때 wake_peers 가 몰아서 한다.
+// 받는 쪽 링이 가득 찼으면 (그 reactor 가 FWD_RING 개 넘게 밀림) 기다리지 않고 그 reactor 몫은 버린다.
+// 클러스터면 bus 에도 넣는다 (다른 노드에 보낼지는 bus 가 방 관심을 보고 정한다). hist 면 받은 노드도 기록한다
+static void forward(struct chan *ch, const char *text, size_t len, int hist)
+{
+    uint64_t to = 0;
+    if (nthreads > 1)
+        to = __atomic_load_n(&ch->where, __ATOMIC_ACQUIRE) & ~(1ull << me->id);
+    if (!to && !bus)
+        return;
+    struct fwd *f = fwd_new(__builtin_popcountll(to) + (bus != NULL), ch->node.hash, ch->name, strlen(ch->name),
+                            text, len, hist);
+    if (!f) {
+        me->fwd_dropped++;
+        return;
+    }
+    if (bus) {
+        if (spsc_push(&bus->in[me->id], f) == -1) {
+            me->fwd_dropped++;
+            fwd_put(f);
+        } else {
+            me->notify_bus = 1;
+        }
+    }
+    while (to) {
+        int d = __builtin_ctzll(to);
+        to &= to - 1;
+        if (spsc_push(&rings[d * nthreads + me->id], f) == -1) {
+            me->fwd_dropped++;
+            fwd_put(f);
+            continue;
+        }
+        me->notify |= 1ull << d;
+    }
+}
+
+// 방에 보낸다: 이 reactor 의 멤버에게는 바로 큐에, 다른 reactor 의 멤버에게는 링으로
+void room_send(struct room *r, const char *text, size_t len, struct client *sender)
+{
+    if (!r)
+        return;
+    broadcast_msg(r, text, len, sender);
+    forward(r->ch, text, len, 0);
+}
+
+// eventfd 가 울림: 다른 reactor 들이 넘긴 메시지를 이 reactor 의 같은 방 멤버에게 fanout 한다
+void drain_rings(void)
+{
+    uint64_t v;
+    // 링보다 먼저 비운다. 비운 뒤에 들어온 메시지는 보낸 쪽이 다시 깨운다
+    if (read(me->efd, &v, sizeof(v)) == -1 && errno != EAGAIN)
+        perror("read(eventfd) error");
+    for (int s = 0; s < nthreads; s++) {
+        if (s == me->id)
+            continue;
+        struct spsc_ring *q = &rings[me->id * nthreads + s];
+        struct fwd *f;
+        while ((f = spsc_pop(q)) != NULL) {
+            // 넘어오는 사이에 이 reactor 의 마지막 멤버가 나갔으면 room_find 가 NULL 이고 아무 일도 없다
+            broadcast_msg(room_find(f->name, f->name_len, f->hash), f->text, f->len, NULL);
+            fwd_put(f);
+        }
+    }
+    if (bus) {                     // 다른 노드에서 온 메시지
+        struct fwd *f;
+        while ((f = spsc_pop(&bus->out[me->id])) != NULL) {
+            broadcast_msg(room_find(f->name, f->name_len, f->hash), f->text, f->len, NULL);
+            fwd_put(f);
+        }
+    }
+}
+
+// 이번 바퀴에 링에 넣은 reactor 마다 eventfd 를 한 번씩 울린다
+void wake_peers(void)
+{
+    static const uint64_t one = 1;
+    while (me->notify) {
+        int d = __builtin_ctzll(me->notify);
+        me->notify &= me->notify - 1;
+        if (write(reactors[d].efd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+            perror("write(eventfd) error");
+    }
+    if (me->notify_bus) {
+        me->notify_bus = 0;
+        if (write(bus->efd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+            perror("write(eventfd) error");
+    }
+    if (me->fwd_dropped) {
+        FLOG_EV(EV_SLOW, FLOG_WARN, "reactor %d: %llu forwarded messages dropped (ring full)",
+                me->id, (unsigned long long)me->fwd_dropped);
+        me->fwd_dropped = 0;
+    }
+}
+
+// 입장/퇴장 알림. --presence-ms 가 0 이면 바로 보내고, 아니면 방에 모아 두었다가 flush_presence 가 한 번에 보낸다
+static void presence(struct room *r, struct client *c, int join)
+{
+    if (!presence_ms) {
+        char broadcast_buffer[BUF_SIZE + 50];
+        int n = sprintf(broadcast_buffer, join ? "[알림] (%s) 님이 입장하셨습니다." : "[알림] (%s) 님이 퇴장하셨습니다.",
+                        c->name);
+        room_send(r, broadcast_buffer, n, join ? c : NULL); // 입장: 들어온 사람 제외, 퇴장: 이미 목록에서 빠짐
+        return;
+    }
+    if (!r->pres) {
+        if (!(r->pres = calloc(1, sizeof(*r->pres))))
+            return;                // 알림 하나를 빠뜨릴 뿐
+        if (!me->pres_list)
+            me->pres_due = now_ms() + presence_ms;
+        r->next_pres = me->pres_list;
+        me->pres_list = r;
+    }
+    struct presence *p = r->pres;
+    uint32_t *cnt = join ? &p->in : &p->out;
+    if (*cnt < PRESENCE_NAMES)
+        strcpy(join ? p->in_names[*cnt] : p->out_names[*cnt], c->name);
+    if (join && p->in + p->out == 0)
+        p->joiner = c;
+    (*cnt)++;
+}
+
+// " 입장 3 명: a, b, c" 또는 " 입장 12 명: a, b, c, d, e 외 7 명"
+static int presence_part(char *buf, size_t size, const char *what, uint32_t cnt, char names[][INET_ADDRSTRLEN + 8])
+{
+    int n = snprintf(buf, size, " %s %u 명:", what, cnt);
+    for (uint32_t i = 0; i < cnt && i < PRESENCE_NAMES; i++)
+        n += snprintf(buf + n, size - n, "%s %s", i ? "," : "", names[i]);
+    if (cnt > PRESENCE_NAMES)
+        n += snprintf(buf + n, size - n, " 외 %u 명", cnt - PRESENCE_NAMES);
+    return n;
+}
+
+// 방마다 모아 둔 입장/퇴장을 알림 하나로 보낸다. 재접속이 몰려도 방마다 --presence-ms 에 한 번이다
+void flush_presence(void)
+{
+    struct room *list = me->pres_list;
+    me->pres_list = NULL;
+    while (list) {
+        struct room *r = list;
+        list = r->next_pres;
+        struct presence *p = r->pres;
+        r->pres = NULL;
+        char buf[BUF_SIZE + 50];
+        int n;
+        if (p->in + p->out == 1) { // 한 명이면 예전 알림 그대로
+            n = p->in ? sprintf(buf, "[알림] (%s) 님이 입장하셨습니다.", p->in_names[0])
+                      : sprintf(buf, "[알림] (%s) 님이 퇴장하셨습니다.", p->out_names[0]);
+        } else {
+            n = sprintf(buf, "[알림]");
+            if (p->in)
+                n += presence_part(buf + n, sizeof(buf) - n, "입장", p->in, p->in_names);
+            if (p->in && p->out)
+                n += sprintf(buf + n, " /");
+            if (p->out)
+                n += presence_part(buf + n, sizeof(buf) - n, "퇴장", p->out, p->out_names);
+        }
+        room_send(r, buf, n, p->in + p->out == 1 ? p->joiner : NULL); // 혼자 들어왔으면 본인 제외
+        free(p);
+        if (r->count == 0)         // 알림 때문에 남겨 둔 빈 방
+            room_free(r);
+    }
+}
+
+// 지금 방에서 빼고 (O(1): 마지막 멤버를 빈 자리로 옮긴다) 남은 사람들에게 퇴장 알림을 보낸다 (quiet 면 알림 없이)
+static void leave_room(struct client *c, int quiet)
+{
+    struct room *r = c->room;
+    if (!r)
+        return;
+    struct client *last = r->members[--r->count];
+    r->members[c->ridx] = last;
+    last->ridx = c->ridx;
+    c->room = NULL;
+    if (r->pres && r->pres->joiner == c)
+        r->pres->joiner = NULL;    // 알림이 나가기 전에 떠남
+    __atomic_sub_fetch(&r->ch->members, 1, __ATOMIC_RELAXED);
+    // 퇴장 알림 (이 reactor 에 남은 사람이 없어도 다른 reactor 의 멤버에게는 간다)
+    if (!quiet)
+        presence(r, c, 0);
+    if (r->count == 0 && !r->pres)
+        room_free(r);
+}
+
+// 세션 토큰 MAC: SipHash-2-4 (키 128비트, 출력 64비트)
+#define SIP_ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+#define SIP_ROUND(v0, v1, v2, v3) do { \
+        v0 += v1; v1 = SIP_ROTL(v1, 13); v1 ^= v0; v0 = SIP_ROTL(v0, 32); \
+        v2 += v3; v3 = SIP_ROTL(v3, 16); v3 ^= v2; \
+        v0 += v3; v3 = SIP_ROTL(v3, 21); v3 ^= v0; \
+        v2 += v1; v1 = SIP_ROTL(v1, 17); v1 ^= v2; v2 = SIP_ROTL(v2, 32); \
+    } while (0)
+
+static uint64_t siphash24(const uint8_t *k, const uint8_t *in, size_t len)
+{
+    uint64_t k0, k1;
+    memcpy(&k0, k, 8);             // 리틀 엔디언 가정 (x86/arm)
+    memcpy(&k1, k + 8, 8);
+    uint64_t v0 = 0x736f6d6570736575ull ^ k0, v1 = 0x646f72616e646f6dull ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ull ^ k0, v3 = 0x7465646279746573ull ^ k1;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t m;
+        memcpy(&m, in + i, 8);
+        v3 ^= m;
+        SIP_ROUND(v0, v1, v2, v3);
+        SIP_ROUND(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+    uint64_t b = (uint64_t)len << 56;
+    for (size_t j = 0; i + j < len; j++)
+        b |= (uint64_t)in[i + j] << (8 * j);
+    v3 ^= b;
+    SIP_ROUND(v0, v1, v2, v3);
+    SIP_ROUND(v0, v1, v2, v3);
+    v0 ^= b;
+    v2 ^= 0xff;
+    for (int r = 0; r < 4; r++)
+        SIP_ROUND(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+// MAC 을 계산할 바이트열: 발급 시각(4바이트) + 이름 + '\0' + 방 이름
+static size_t session_body(uint8_t *buf, uint32_t ts, const char *name, const char *room, size_t room_len)
+{
+    size_t name_len = strlen(name);
+    memcpy(buf, &ts, 4);
+    memcpy(buf + 4, name, name_len + 1);
+    memcpy(buf + 5 + name_len, room, room_len);
+    return 5 + name_len + room_len;
+}
+
+// 세션 토큰: MAC(16 hex) + 발급 시각(8 hex) + hex(이름 '\0' 방 이름). 서버는 아무것도 기억하지 않는다
+static void send_session(struct client *c)
+{
+    if (!c->session || !c->room)
+        return;
+    uint8_t body[4 + sizeof(c->name) + ROOM_NAME_MAX];
+    uint32_t ts = (uint32_t)time(NULL);
+    size_t len = session_body(body, ts, c->name, c->room->ch->name, strlen(c->room->ch->name));
+    char tok[16 + 8 + 2 * sizeof(body) + 1];
+    int n = sprintf(tok, "%016llx%08x", (unsigned long long)siphash24(session_key, body, len), ts);
+    for (size_t i = 4; i < len; i++)
+        n += sprintf(tok + n, "%02x", body[i]);
+    reply(c, "[세션] %s", tok);
+}
+
+// 토큰을 확인하고 이름과 방 이름을 꺼낸다. 틀렸거나 --session-ttl 이 지났으면 -1
+static int session_parse(const char *tok, size_t len, char *name, size_t name_size, char *room, size_t *room_len)
+{
+    uint8_t body[4 + INET_ADDRSTRLEN + 8 + ROOM_NAME_MAX];
+    char hex[17];
+    if (len < 24 + 4 || len % 2 || (len - 24) / 2 > sizeof(body) - 4)
+        return -1;
+    memcpy(hex, tok, 16);
+    hex[16] = 0;
+    uint64_t mac = strtoull(hex, NULL, 16);
+    memcpy(hex, tok + 16, 8);
+    hex[8] = 0;
+    uint32_t ts = strtoul(hex, NULL, 16);
+    memcpy(body, &ts, 4);
+    size_t blen = 4;
+    for (size_t i = 24; i < len; i += 2) {
+        unsigned v;
+        if (sscanf(tok + i, "%2x", &v) != 1)
+            return -1;
+        body[blen++] = v;
+    }
+    if (siphash24(session_key, body, blen) != mac || (uint32_t)time(NULL) - ts > session_ttl)
+        return -1;
+    const uint8_t *nul = memchr(body + 4, 0, blen - 4);
+    if (!nul || (size_t)(nul - (body + 4)) >= name_size)
+        return -1;
+    *room_len = blen - (nul + 1 - body);
+    if (*room_len == 0 || *room_len > ROOM_NAME_MAX)
+        return -1;
+    memcpy(name, body + 4, nul - (body + 4) + 1);
+    memcpy(room, nul + 1, *room_len);
+    return 0;
+}
+
+// 방을 옮긴다: 예전 방에 퇴장, 새 방에 입장 알림 (quiet 면 둘 다 없이). 실패하면 (메모리 부족) -1, 방은 그대로
+int join_room(struct client *c, const char *name, size_t len, int quiet)
+{
+    struct room *r = room_get(name, len);
+    if (!r)
+        return -1;
+    if (r == c->room)
+        return 0;
+    if (r->count == r->cap) {
+        int cap = r->cap ? r->cap * 2 : 4;
+        struct client **p = realloc(r->members, cap * sizeof(*p));
+        if (!p) {
+            if (r->count == 0 && !r->pres)
+                room_free(r);
+            return -1;
+        }
+        r->members = p;
+        r->cap = cap;
+    }
+    leave_room(c, quiet);
+    c->ridx = r->count;
+    r->members[r->count++] = c;
+    c->room = r;
+    __atomic_add_fetch(&r->ch->members, 1, __ATOMIC_RELAXED);
+
+    if (!quiet)
+        presence(r, c, 1);
+    replay_history(c);             // 들어온 사람에게는 지난 대화
+    send_session(c);               // 방이 바뀌었으므로 새 토큰
+    return 0;
+}
+
+// /join <방>, /leave, /list
+void command(struct client *c, const char *text, size_t len)
+{
+    const char *arg = memchr(text, ' ', len);
+    size_t cmd_len = arg ? (size_t)(arg - text) : len;
+    size_t arg_len = 0;
+    if (arg) {
+        while (arg < text + len && *arg == ' ')
+            arg++;
+        arg_len = text + len - arg;
+        while (arg_len && (arg[arg_len - 1] == ' ' || arg[arg_len - 1] == '\r'))
+            arg_len--;
+    }
+    while (cmd_len && text[cmd_len - 1] == '\r')
+        cmd_len--;
+
+    if (cmd_len == 8 && memcmp(text, "/session", 8) == 0) {
+        // 이제부터 방이 바뀔 때마다 "[세션] <토큰>" 을 받는다
+        c->session = 1;
+        send_session(c);
+    } else if (cmd_len == 7 && memcmp(text, "/resume", 7) == 0) {
+        // /resume <토큰>: 끊기기 전 이름과 방으로 조용히 돌아간다 (입장/퇴장 알림 없음, 대기열도 건너뜀)
+        char name[sizeof(c->name)], room[ROOM_NAME_MAX];
+        size_t room_len;
+        if (session_parse(arg, arg_len, name, sizeof(name), room, &room_len) == -1) {
+            reply(c, "[알림] 세션을 이어받지 못했습니다. 새로 입장합니다.");
+            return;                // 대기 중이면 평소대로 입장한다
+        }
+        int was_pending = !c->admitted;
+        if (was_pending) {
+            admit_unlink(c);
+            c->admitted = 1;
+        }
+        c->session = 1;
+        strcpy(c->name, name);     // 새 토큰에 들어가도록 방에 들어가기 전에
+        if (join_room(c, room, room_len, 1) == -1 &&
+            (!was_pending || join_room(c, LOBBY, strlen(LOBBY), 1) == -1)) {
+            reply(c, "[알림] 방에 들어가지 못했습니다.");
+            if (was_pending)
+                kill_client(c, NULL); // 갈 곳이 없다 (메모리 부족)
+            return;
+        }
+        reply(c, "[알림] 세션을 이어받았습니다. (%s, %s 방, %u 명)", c->name, c->room->ch->name,
+              __atomic_load_n(&c->room->ch->members, __ATOMIC_RELAXED));
+    } else if (cmd_len == 5 && memcmp(text, "/join", 5) == 0) {
+        if (arg_len == 0 || arg_len > ROOM_NAME_MAX || memchr(arg, ' ', arg_len)) {
+            reply(c, "[알림] 방 이름은 공백 없이 1~%d 바이트입니다.", ROOM_NAME_MAX);
+            return;
+        }
+        if (join_room(c, arg, arg_len, 0) == -1) {
+            reply(c, "[알림] 방에 들어가지 못했습니다.");
+            return;
+        }
+        reply(c, "[알림] %s 방에 들어왔습니다. (%u 명)", c->room->ch->name,
+              __atomic_load_n(&c->room->ch->members, __ATOMIC_RELAXED));
+    } else if (cmd_len == 6 && memcmp(text, "/leave", 6) == 0) {
+        if (join_room(c, LOBBY, strlen(LOBBY), 0) == -1) {
+            reply(c, "[알림] 방에서 나가지 못했습니다.");
+            return;
+        }
+        reply(c, "[알림] %s 방으로 돌아왔습니다. (%u 명)", c->room->ch->name,
+              __atomic_load_n(&c->room->ch->members, __ATOMIC_RELAXED));
+    } else if (cmd_len == 5 && memcmp(text, "/list", 5) == 0) {
+        // 방 목록. 방이 아주 많을 수 있으므로 LIST_MAX 개까지만 보여 준다. 인원은 모든 reactor 의 합
+        char buf[BUF_SIZE];
+        uint32_t total = __atomic_load_n(&chan_count, __ATOMIC_RELAXED);
+        int n = snprintf(buf, sizeof(buf), "[알림] 방 %u 개:", total);
+        int shown = 0, full = 0;
+        for (unsigned s = 0; s < ROOM_SHARDS && shown < LIST_MAX && !full; s++) {
+            struct room_shard *sh = &chans[s];
+            pthread_mutex_lock(&chan_locks[s]);
+            for (uint32_t b = 0; sh->mask && b <= sh->mask && shown < LIST_MAX && !full; b++) {
+                for (struct hnode *h = sh->buckets[b]; h && shown < LIST_MAX; h = h->next, shown++) {
+                    struct chan *ch = (struct chan *)h;
+                    int w = snprintf(buf + n, sizeof(buf) - n, " %s(%u)", ch->name,
+                                     __atomic_load_n(&ch->members, __ATOMIC_RELAXED));
+                    if (w < 0 || (size_t)w >= sizeof(buf) - n) {
+                        full = 1;
+                        break;
+                    }
+                    n += w;
+                }
+            }
+            pthread_mutex_unlock(&chan_locks[s]);
+        }
+        if ((uint32_t)shown < total)
+            reply(c, "%s ...", buf);
+        else
+            reply(c, "%s", buf);
+    } else {
+        reply(c, "[알림] 명령: /join <방>, /leave, /list, /session, /resume <토큰>");
+    }
+}
+
+// 클라이언트를 끊기로 표시만 한다. 실제 정리는 reap_clients 에서 (배치가 끝난 뒤)
+void kill_client(struct client *c, const char *why)
+{
+    if (c->dead)
+        return;
+    if (why)
+        FLOG(FLOG_WARN, "(%s) %s error: %s", c->name, why, strerror(errno));
+    c->dead = 1;
+    c->next_dead = me->graveyard;
+    me->graveyard = c;
+}
+
+// 끊기로 한 클라이언트를 정리하고 퇴장 알림을 보낸다.
+// 알림을 보내다 끊긴 클라이언트는 아직 dirty 목록에 있을 수 있으므로 여기서 해제하지 않는다.
+// 다음 바퀴 안 반복(flush_dirty 가 목록에서 뺀 뒤)에 정리한다
+void reap_clients(void)
+{
+    struct client *list = me->graveyard;
+    me->graveyard = NULL;
+    while (list) {
+        struct client *c = list;
+        list = c->next_dead;
+
+        // --- 종료 처리 ---
+        me->client_count--;
+        epoll_ctl(me->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+        close(c->fd);
+        while (c->head) {
+            struct qent *e = c->head;
+            c->head = e->next;
+            qent_release(e);
+        }
+        free(c->in);
+        FLOG_EV(EV_CLOSE, FLOG_INFO, "[알림] (%s) 님이 퇴장하셨습니다.", c->name);
+
+        if (!c->admitted)
+            admit_unlink(c);       // 입장 전에 끊김
+        leave_room(c, 0); // 같은 방 사람들에게 퇴장 메시지
+        free(c);
+    }
+}
+
+// ---- 노드 사이 중계 (bus) ----
+// 프레임 종류. 링크가 열리면 양쪽이 HELLO 를 보내고, 상대 HELLO 를 받으면 ACK, 자기 방 목록(SUB...), READY 를 보낸다.
+// READY 를 받으면 ACK 뒤로 못 받은 메시지를 replay 에서 다시 보내고, 그 뒤로는 MSG 와 SUB/UNSUB 만 오간다
+enum { BUS_HELLO = 1, BUS_ACK, BUS_SUB, BUS_UNSUB, BUS_READY, BUS_MSG };
+
+static void put_be(uint8_t *p, uint64_t v, int n)
+{
+    for (int i = n - 1; i >= 0; i--, v >>= 8)
+        p[i] = (uint8_t)v;
+}
+
+static uint64_t get_be(const uint8_t *p, int n)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < n; i++)
+        v = v << 8 | p[i];
+    return v;
+}
+
+// "unix:PATH" 나 "[HOST:]PORT". HOST 가 없으면 받을 때는 모든 주소, 걸 때는 127.0.0.1
+static int bus_sockaddr(const char *s, int listening, struct sockaddr_storage *ss, socklen_t *len)
+{
+    memset(ss, 0, sizeof(*ss));
+    if (strncmp(s, "unix:", 5) == 0) {
+        struct sockaddr_un *un = (struct sockaddr_un *)ss;
+        if (!s[5] || strlen(s + 5) >= sizeof(un->sun_path))
+            return -1;
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, s + 5);
+        *len = sizeof(*un);
+        return 0;
+    }
+    struct sockaddr_in *in = (struct sockaddr_in *)ss;
+    char host[INET_ADDRSTRLEN] = "";
+    const char *colon = strrchr(s, ':'), *port = colon ? colon + 1 : s;
+    if (colon && (size_t)(colon - s) < sizeof(host))
+        memcpy(host, s, colon - s);
+    in->sin_family = AF_INET;
+    in->sin_port = htons(atoi(port));
+    if (!in->sin_port)
+        return -1;
+    if (!host[0])
+        in->sin_addr.s_addr = htonl(listening ? INADDR_ANY : INADDR_LOOPBACK);
+    else if (inet_pton(AF_INET, host, &in->sin_addr) != 1)
+        return -1;
+    *len = sizeof(*in);
+    return 0;
+}
+
+// reactor 가 방을 만들거나 없앴다 (chan 샤드 락을 쥔 채 불린다)
+static void bus_ctl(int sub, const char *name, size_t len, uint32_t h)
+{
+    static const uint64_t one = 1;
+    struct busctl *c = malloc(sizeof(*c));
+    if (!c) {
+        FLOG(FLOG_WARN, "bus: room event lost (%.*s)", (int)len, name);
+        return;
+    }
+    c->next = NULL;
+    c->sub = sub;
+    c->name_len = len;
+    c->hash = h;
+    memcpy(c->name, name, len);
+    pthread_mutex_lock(&bus->ctl_lock);
+    *bus->ctl_tail = c;
+    bus->ctl_tail = &c->next;
+    pthread_mutex_unlock(&bus->ctl_lock);
+    if (write(bus->efd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+        perror("write(eventfd) error");
+}
+
+static struct iroom *iroom_find(const char *name, size_t len, uint32_t h)
+{
+    struct room_shard *sh = &bus->rooms[room_shard_idx(h)];
+    for (struct hnode *n = sh->mask ? sh->buckets[h & sh->mask] : NULL; n; n = n->next) {
+        struct iroom *ir = (struct iroom *)n;
+        if (n->hash == h && ir->name_len == len && memcmp(ir->name, name, len) == 0)
+            return ir;
+    }
+    return NULL;
+}
+
+static struct iroom *iroom_get(const char *name, size_t len, uint32_t h)
+{
+    struct iroom *ir = iroom_find(name, len, h);
+    if (ir)
+        return ir;
+    struct room_shard *sh = &bus->rooms[room_shard_idx(h)];
+    if (sh->count >= sh->mask && room_shard_grow(sh) == -1)
+        return NULL;
+    if (!(ir = calloc(1, sizeof(*ir))))
+        return NULL;
+    ir->node.hash = h;
+    ir->name_len = len;
+    memcpy(ir->name, name, len);
+    room_shard_add(sh, &ir->node);
+    return ir;
+}
+
+// 이 노드에도 다른 노드에도 멤버가 없으면 잊는다
+static void iroom_gc(struct iroom *ir)
+{
+    if (ir->local || ir->remote)
+        return;
+    room_shard_del(&bus->rooms[room_shard_idx(ir->node.hash)], &ir->node);
+    free(ir);
+}
+
+// 출력 버퍼에 프레임 하나를 붙인다. 보내기는 바퀴 끝에 링크마다 write 한 번 (link_flush)
+static void link_kill(struct link *l, const char *why);
+static void link_frame(struct link *l, int type, const void *a, size_t alen, const void *b, size_t blen)
+{
+    if (l->dead)
+        return;
+    size_t need = l->outlen + FRAME_HDR + 1 + alen + blen;
+    if (need > BUS_HWM) {          // 상대 노드가 못 따라온다. 다시 접속하면 replay 가 메운다
+        link_kill(l, "output buffer full");
+        return;
+    }
+    if (need > l->outcap) {
+        size_t cap = l->outcap ? l->outcap : 64 * 1024;
+        while (cap < need)
+            cap *= 2;
+        char *p = realloc(l->out, cap);
+        if (!p) {
+            link_kill(l, "malloc");
+            return;
+        }
+        l->out = p;
+        l->outcap = cap;
+    }
+    uint8_t *h = (uint8_t *)l->out + l->outlen;
+    put_be(h, 1 + alen + blen, FRAME_HDR);
+    h[FRAME_HDR] = type;
+    if (alen)
+        memcpy(h + FRAME_HDR + 1, a, alen);
+    if (blen)
+        memcpy(h + FRAME_HDR + 1 + alen, b, blen);
+    l->outlen = need;
+}
+
+static void link_msg(struct link *l, uint64_t seq, const struct fwd *f)
+{
+    uint8_t h[8 + 2 + ROOM_NAME_MAX];
+    put_be(h, seq, 8);
+    h[8] = f->hist;
+    h[9] = f->name_len;
+    memcpy(h + 10, f->name, f->name_len);
+    link_frame(l, BUS_MSG, h, 10 + f->name_len, f->text, f->len);
+}
+
+static void link_events(struct link *l)
+{
+    uint32_t want = l->connecting ? EPOLLOUT : EPOLLIN | (l->outlen ? EPOLLOUT : 0);
+    if (want == l->events)
+        return;
+    struct epoll_event ev = { .events = want, .data.ptr = l };
+    if (epoll_ctl(bus->epfd, EPOLL_CTL_MOD, l->fd, &ev) == -1) {
+        link_kill(l, "epoll_ctl");
+        return;
+    }
+    l->events = want;
+}
+
+// 링크를 끊기로 한다 (해제는 바퀴 끝에). 그 노드의 방 관심은 지운다. 다시 붙으면 SUB 를 새로 받는다
+static void link_kill(struct link *l, const char *why)
+{
+    if (l->dead)
+        return;
+    l->dead = 1;
+    epoll_ctl(bus->epfd, EPOLL_CTL_DEL, l->fd, NULL);
+    if (l->target) {
+        l->target->link = NULL;
+        l->target->retry_at = now_ms() + BUS_RETRY_MS;
+    }
+    if (l->slot < 0)               // HELLO 전 (connect 실패 등): 조용히
+        return;
+    struct node *n = &bus->nodes[l->slot];
+    FLOG(FLOG_WARN, "bus: node %u link down (%s), %llu duplicates, %llu dropped so far", n->id, why,
+         (unsigned long long)bus->dups, (unsigned long long)bus->dropped);
+    if (n->link != l)
+        return;
+    n->link = NULL;
+    uint64_t bit = 1ull << l->slot;
+    for (unsigned s = 0; s < ROOM_SHARDS; s++) {
+        struct room_shard *sh = &bus->rooms[s];
+        for (uint32_t b = 0; sh->mask && b <= sh->mask; b++) {
+            struct hnode *next;
+            for (struct hnode *h = sh->buckets[b]; h; h = next) {
+                next = h->next;
+                struct iroom *ir = (struct iroom *)h;
+                ir->remote &= ~bit;
+                iroom_gc(ir);
+            }
+        }
+    }
+}
+
+static void link_hello(struct link *l)
+{
+    uint8_t h[6];
+    put_be(h, node_id, 2);
+    put_be(h + 2, bus->boot, 4);
+    link_frame(l, BUS_HELLO, h, sizeof(h), NULL, 0);
+}
+
+static struct link *link_new(int fd, struct target *t, int connecting)
+{
+    struct link *l = calloc(1, sizeof(*l));
+    if (!l || !(l->in = malloc(BUS_FRAME_MAX))) {
+        free(l);
+        close(fd);
+        return NULL;
+    }
+    l->fd = fd;
+    l->slot = -1;
+    l->target = t;
+    l->connecting = connecting;
+    l->events = connecting ? EPOLLOUT : EPOLLIN;
+    struct epoll_event ev = { .events = l->events, .data.ptr = l };
+    if (epoll_ctl(bus->epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        free(l->in);
+        free(l);
+        close(fd);
+        return NULL;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // Unix 소켓이면 실패해도 그만
+    l->next = bus->links;
+    bus->links = l;
+    if (!connecting)
+        link_hello(l);
+    return l;
+}
+
+// --peer 주소로 건다. 바로 실패하면 BUS_RETRY_MS 뒤에 다시
+static void bus_dial(struct target *t)
+{
+    struct sockaddr_storage ss;
+    socklen_t len;
+    bus_sockaddr(t->addr, 0, &ss, &len); // bus_init 에서 확인했다
+    t->retry_at = now_ms() + BUS_RETRY_MS;
+    int fd = socket(ss.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return;
+    if (connect(fd, (struct sockaddr *)&ss, len) == 0)
+        t->link = link_new(fd, t, 0);
+    else if (errno == EINPROGRESS)
+        t->link = link_new(fd, t, 1);
+    else
+        close(fd);
+}
+
+static void link_connected(struct link *l)
+{
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(l->fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1 || err) {
+        link_kill(l, "connect");
+        return;
+    }
+    l->connecting = 0;
+    link_hello(l);
+    link_events(l);
+}
+
+static void bus_accept(void)
+{
+    for (int i = 0; i < ACCEPT_BUDGET; i++) {
+        int fd = accept4(bus->lsock, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                perror("accept() error");
+            return;
+        }
+        link_new(fd, NULL, 0);
+    }
+}
+
+// 노드 id 의 자리. 처음 보는 노드면 새 자리 (MAX_NODES 개까지)
+static int node_slot(uint16_t id)
+{
+    for (int i = 0; i < bus->nnodes; i++)
+        if (bus->nodes[i].id == id)
+            return i;
+    if (bus->nnodes == MAX_NODES)
+        return -1;
+    bus->nodes[bus->nnodes].id = id;
+    return bus->nnodes++;
+}
+
+// 받은 번호를 기억한다. 이미 받았거나 창보다 오래된 번호면 1 (중복)
+static int dedup_seen(struct node *n, uint64_t seq)
+{
+    if (seq > n->top) {
+        if (seq - n->top >= DEDUP_WINDOW)
+            memset(n->win, 0, sizeof(n->win));
+        else
+            for (uint64_t s = n->top + 1; s < seq; s++) // 건너뛴 번호는 아직 안 받음
+                n->win[s / 64 % (DEDUP_WINDOW / 64)] &= ~(1ull << (s % 64));
+        n->top = seq;
+    } else if (n->top - seq >= DEDUP_WINDOW || (n->win[seq / 64 % (DEDUP_WINDOW / 64)] >> (seq % 64) & 1)) {
+        return 1;
+    }
+    n->win[seq / 64 % (DEDUP_WINDOW / 64)] |= 1ull << (seq % 64);
+    return 0;
+}
+
+// 다른 노드에서 온 메시지: 이 노드에서 그 방 멤버가 있는 reactor 들의 링에 넣는다. 클라이언트 메시지면 기록도 남긴다
+static void bus_deliver(const char *name, size_t name_len, const char *text, size_t len, int hist)
+{
+    uint32_t h = room_hash(name, name_len);
+    unsigned s = room_shard_idx(h);
+    struct room_shard *sh = &chans[s];
+    uint64_t where = 0;
+    pthread_mutex_lock(&chan_locks[s]);
+    for (struct hnode *n = sh->mask ? sh->buckets[h & sh->mask] : NULL; n; n = n->next) {
+        struct chan *ch = (struct chan *)n;
+        if (n->hash == h && name_eq(ch->name, name, name_len)) {
+            where = __atomic_load_n(&ch->where, __ATOMIC_ACQUIRE);
+            if (hist)
+                record_history(ch, text, len);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&chan_locks[s]);
+    if (!where)                    // 그새 이 노드의 마지막 멤버가 나갔다
+        return;
+    struct fwd *f = fwd_new(__builtin_popcountll(where), h, name, name_len, text, len, hist);
+    if (!f) {
+        bus->dropped++;
+        return;
+    }
+    while (where) {
+        int d = __builtin_ctzll(where);
+        where &= where - 1;
+        if (spsc_push(&bus->out[d], f) == -1) {
+            bus->dropped++;
+            fwd_put(f);
+            continue;
+        }
+        bus->notify |= 1ull << d;
+    }
+}
+
+// 두 링크가 같은 노드로 이어졌다 (서로 동시에 걸었거나, 예전 링크가 아직 안 끊겼다). 양쪽이 같은 것을 남기도록:
+// 한쪽은 내가, 한쪽은 상대가 건 것이면 id 가 작은 노드가 건 것을, 같은 쪽이 건 것이면 새것을 남긴다
+static struct link *link_loser(struct link *old, struct link *l, uint16_t peer)
+{
+    int old_mine = old->target != NULL, new_mine = l->target != NULL;
+    if (old_mine == new_mine)
+        return old;
+    return new_mine == (node_id < peer) ? old : l;
+}
+
+// READY: 상대의 방 관심을 다 받았다. ACK 뒤로 보낸 메시지 중 상대가 관심 있는 것을 다시 보낸다
+static void link_replay(struct link *l)
+{
+    uint64_t from = l->replay_from, oldest = bus->seq >= BUS_REPLAY ? bus->seq - BUS_REPLAY + 1 : 1, sent = 0;
+    if (from < oldest) {
+        FLOG(FLOG_WARN, "bus: node %u missed %llu messages (older than replay buffer)", bus->nodes[l->slot].id,
+             (unsigned long long)(oldest - from));
+        from = oldest;
+    }
+    uint64_t bit = 1ull << l->slot;
+    for (uint64_t seq = from; seq <= bus->seq && !l->dead; seq++) {
+        struct fwd *f = bus->replay[seq % BUS_REPLAY].f;
+        if (bus->replay[seq % BUS_REPLAY].seq != seq)
+            continue;
+        struct iroom *ir = iroom_find(f->name, f->name_len, f->hash);
+        if (ir && (ir->remote & bit)) {
+            link_msg(l, seq, f);
+            sent++;
+        }
+    }
+    if (sent)
+        FLOG(FLOG_INFO, "bus: node %u replayed %llu messages", bus->nodes[l->slot].id, (unsigned long long)sent);
+    l->ready = 1;
+}
+
+// 프레임 하나. 형식이 틀리면 링크를 끊는다
+static void bus_frame(struct link *l, int type, const uint8_t *p, size_t len)
+{
+    if (type != BUS_HELLO && l->slot < 0) {
+        link_kill(l, "frame before hello");
+        return;
+    }
+    switch (type) {
+    case BUS_HELLO: {
+        if (len != 6 || l->slot >= 0)
+            break;
+        uint16_t id = get_be(p, 2);
+        uint32_t boot = get_be(p + 2, 4);
+        int slot = id == node_id ? -1 : node_slot(id);
+        if (slot == -1) {
+            link_kill(l, id == node_id ? "connected to self" : "too many nodes");
+            return;
+        }
+        struct node *n = &bus->nodes[slot];
+        if (n->link) {
+            struct link *loser = link_loser(n->link, l, id);
+            link_kill(loser, "duplicate link");
+            if (loser == l)
+                return;
+        }
+        int known = n->boot == boot; // 이 실행의 상대에게서 받은 적이 있다
+        if (!known) {
+            n->boot = boot;
+            n->top = 0;
+            memset(n->win, 0, sizeof(n->win));
+        }
+        n->link = l;
+        l->slot = slot;
+        if (l->target)
+            l->target->slot = slot;
+        uint8_t ack[9];
+        ack[0] = known;
+        put_be(ack + 1, n->top, 8);
+        link_frame(l, BUS_ACK, ack, sizeof(ack), NULL, 0);
+        for (unsigned s = 0; s < ROOM_SHARDS; s++) { // 이 노드에 멤버가 있는 방
+            struct room_shard *sh = &bus->rooms[s];
+            for (uint32_t b = 0; sh->mask && b <= sh->mask; b++)
+                for (struct hnode *h = sh->buckets[b]; h; h = h->next)
+                    if (((struct iroom *)h)->local)
+                        link_frame(l, BUS_SUB, ((struct iroom *)h)->name, ((struct iroom *)h)->name_len, NULL, 0);
+        }
+        link_frame(l, BUS_READY, NULL, 0, NULL, 0);
+        FLOG(FLOG_INFO, "bus: node %u link up", id);
+        return;
+    }
+    case BUS_ACK:
+        if (len != 9)
+            break;
+        // 상대가 이 실행의 메시지를 받은 적이 없으면 (새로 뜬 노드) 예전 메시지는 다시 보내지 않는다
+        l->replay_from = p[0] ? get_be(p + 1, 8) + 1 : bus->seq + 1;
+        return;
+    case BUS_SUB:
+    case BUS_UNSUB: {
+        if (len == 0 || len > ROOM_NAME_MAX)
+            break;
+        uint32_t h = room_hash((const char *)p, len);
+        struct iroom *ir = type == BUS_SUB ? iroom_get((const char *)p, len, h) : iroom_find((const char *)p, len, h);
+        if (!ir)
+            return;
+        if (type == BUS_SUB)
+            ir->remote |= 1ull << l->slot;
+        else
+            ir->remote &= ~(1ull << l->slot);
+        iroom_gc(ir);
+        return;
+    }
+    case BUS_READY:
+        if (len != 0 || l->ready)
+            break;
+        link_replay(l);
+        return;
+    case BUS_MSG: {
+        if (len < 10 || p[9] == 0 || p[9] > ROOM_NAME_MAX || len - 10 - p[9] > BUF_SIZE + 50 || len < 10u + p[9])
+            break;
+        if (dedup_seen(&bus->nodes[l->slot], get_be(p, 8))) {
+            bus->dups++;
+            return;
+        }
+        bus_deliver((const char *)p + 10, p[9], (const char *)p + 10 + p[9], len - 10 - p[9], p[8]);
+        return;
+    }
+    }
+    link_kill(l, "bad frame");
+}
+
+static void link_read(struct link *l)
+{
+    ssize_t r = read(l->fd, l->in + l->inlen, BUS_FRAME_MAX - l->inlen);
+    if (r == 0 || (r == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        link_kill(l, r == 0 ? "closed" : "read");
+        return;
+    }
+    if (r <= 0)
+        return;
+    l->inlen += r;
+    size_t pos = 0;
+    while (l->inlen - pos >= FRAME_HDR + 1 && !l->dead) {
+        const uint8_t *h = (const uint8_t *)l->in + pos;
+        uint32_t len = get_be(h, FRAME_HDR);
+        if (len == 0 || FRAME_HDR + len > BUS_FRAME_MAX) {
+            link_kill(l, "bad frame");
+            return;
+        }
+        if (l->inlen - pos < FRAME_HDR + len)
+            break;
+        bus_frame(l, h[FRAME_HDR], h + FRAME_HDR + 1, len - 1);
+        pos += FRAME_HDR + len;
+    }
+    memmove(l->in, l->in + pos, l->inlen - pos);
+    l->inlen -= pos;
+}
+
+static void link_flush(struct link *l)
+{
+    if (l->dead || l->connecting || !l->outlen)
+        return;
+    ssize_t w = write(l->fd, l->out, l->outlen);
+    if (w == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            link_kill(l, "write");
+            return;
+        }
+        w = 0;
+    }
+    memmove(l->out, l->out + w, l->outlen - w);
+    l->outlen -= w;
+    link_events(l);
+}
+
+// 이 노드의 reactor 가 보낸 메시지: 번호를 붙이고, 그 방 멤버가 있는 노드마다 한 번씩 보내고, replay 에 남긴다
+static void bus_publish(struct fwd *f)
+{
+    uint64_t seq = ++bus->seq;
+    struct iroom *ir = iroom_find(f->name, f->name_len, f->hash);
+    for (uint64_t to = ir ? ir->remote : 0; to; to &= to - 1) {
+        struct link *l = bus->nodes[__builtin_ctzll(to)].link;
+        if (l && l->ready)         // 링크가 없으면 다시 붙을 때 replay 로
+            link_msg(l, seq, f);
+    }
+    struct fwd *old = bus->replay[seq % BUS_REPLAY].f;
+    if (old)
+        fwd_put(old);
+    bus->replay[seq % BUS_REPLAY].seq = seq;
+    bus->replay[seq % BUS_REPLAY].f = f; // reactor 가 bus 몫으로 준 참조를 replay 가 갖는다
+}
+
+// eventfd 가 울림: 방 생성/삭제 알림과 reactor 들이 넣은 메시지를 처리한다
+static void bus_drain(void)
+{
+    uint64_t v;
+    if (read(bus->efd, &v, sizeof(v)) == -1 && errno != EAGAIN)
+        perror("read(eventfd) error");
+    pthread_mutex_lock(&bus->ctl_lock);
+    struct busctl *c = bus->ctl_head;
+    bus->ctl_head = NULL;
+    bus->ctl_tail = &bus->ctl_head;
+    pthread_mutex_unlock(&bus->ctl_lock);
+    while (c) {
+        struct busctl *next = c->next;
+        struct iroom *ir = c->sub ? iroom_get(c->name, c->name_len, c->hash) : iroom_find(c->name, c->name_len, c->hash);
+        if (ir) {
+            ir->local = c->sub;
+            for (struct link *l = bus->links; l; l = l->next)
+                if (l->slot >= 0)  // HELLO 전이면 HELLO 를 받을 때 목록을 통째로 보낸다
+                    link_frame(l, c->sub ? BUS_SUB : BUS_UNSUB, c->name, c->name_len, NULL, 0);
+            iroom_gc(ir);
+        }
+        free(c);
+        c = next;
+    }
+    for (int s = 0; s < nthreads; s++) {
+        struct fwd *f;
+        while ((f = spsc_pop(&bus->in[s])) != NULL)
+            bus_publish(f);
+    }
+}
+
+static void *bus_main(void *arg)
+{
+    (void)arg;
+    static const uint64_t one = 1;
+    struct epoll_event events[MAX_EVENTS];
+    while (1) {
+        // 링크가 없는 --peer 에 다시 건다 (그 노드가 다른 링크로 붙어 있으면 걸지 않는다)
+        uint64_t now = now_ms(), due = UINT64_MAX;
+        for (int i = 0; i < bus->ntargets; i++) {
+            struct target *t = &bus->targets[i];
+            if (t->link || (t->slot >= 0 && bus->nodes[t->slot].link))
+                continue;
+            if (t->retry_at <= now)
+                bus_dial(t);
+            if (!t->link && t->retry_at < due)
+                due = t->retry_at;
+        }
+        int n = epoll_wait(bus->epfd, events, MAX_EVENTS, due == UINT64_MAX ? -1 : (int)(due > now ? due - now : 0));
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait() error");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            void *p = events[i].data.ptr;
+            if (!p) {
+                bus_accept();
+                continue;
+            }
+            if (p == bus) {
+                bus_drain();
+                continue;
+            }
+            struct link *l = p;
+            if (l->dead)
+                continue;
+            if (l->connecting) {
+                link_connected(l);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                link_read(l);
+        }
+        // 링크마다 write 한 번, 끊은 링크 정리, 메시지를 넣은 reactor 깨우기
+        for (struct link **pl = &bus->links; *pl;) {
+            struct link *l = *pl;
+            link_flush(l);
+            if (!l->dead) {
+                pl = &l->next;
+                continue;
+            }
+            *pl = l->next;
+            close(l->fd);
+            free(l->in);
+            free(l->out);
+            free(l);
+        }
+        while (bus->notify) {
+            int d = __builtin_ctzll(bus->notify);
+            bus->notify &= bus->notify - 1;
+            if (write(reactors[d].efd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+                perror("write(eventfd) error");
+        }
+    }
+    return NULL;
+}
+
+static void bus_init(const char **peers, int npeers)
+{
+    bus = aligned_alloc(64, (sizeof(*bus) + 63) & ~(size_t)63);
+    if (!bus)
+        error_handling("malloc() error");
+    memset(bus, 0, sizeof(*bus));
+    for (int i = 0; i < nthreads; i++)
+        if (spsc_init(&bus->in[i], BUS_RING) == -1 || spsc_init(&bus->out[i], BUS_RING) == -1)
+            error_handling("malloc() error");
+    pthread_mutex_init(&bus->ctl_lock, NULL);
+    bus->ctl_tail = &bus->ctl_head;
+    while (!bus->boot)
+        if (getrandom(&bus->boot, sizeof(bus->boot), 0) != sizeof(bus->boot))
+            error_handling("getrandom() error");
+    bus->epfd = epoll_create1(0);
+    bus->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (bus->epfd == -1 || bus->efd == -1)
+        error_handling("bus init error");
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = bus };
+    if (epoll_ctl(bus->epfd, EPOLL_CTL_ADD, bus->efd, &ev) == -1)
+        error_handling("epoll_ctl() error");
+
+    struct sockaddr_storage ss;
+    socklen_t len;
+    bus->lsock = -1;
+    if (bus_listen) {
+        if (bus_sockaddr(bus_listen, 1, &ss, &len) == -1) {
+            fprintf(stderr, "bad --bus address %s\n", bus_listen);
+            exit(1);
+        }
+        if (ss.ss_family == AF_UNIX)
+            unlink(((struct sockaddr_un *)&ss)->sun_path); // 예전 실행이 남긴 소켓 파일
+        bus->lsock = socket(ss.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int opt = 1;
+        if (bus->lsock != -1)
+            setsockopt(bus->lsock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        if (bus->lsock == -1 || bind(bus->lsock, (struct sockaddr *)&ss, len) == -1 || listen(bus->lsock, SOMAXCONN) == -1)
+            error_handling("bus bind() error");
+        ev.data.ptr = NULL;        // 리슨 소켓은 data.ptr == NULL
+        if (epoll_ctl(bus->epfd, EPOLL_CTL_ADD, bus->lsock, &ev) == -1)
+            error_handling("epoll_ctl() error");
+    }
+    for (int i = 0; i < npeers; i++) {
+        if (bus_sockaddr(peers[i], 0, &ss, &len) == -1) {
+            fprintf(stderr, "bad --peer address %s\n", peers[i]);
+            exit(1);
+        }
+        bus->targets[i].addr = peers[i];
+        bus->targets[i].slot = -1;
+    }
+    bus->ntargets = npeers;
+}
+
+void error_handling(char *message)
+{
+    perror(message);
+    exit(1);
+}
@@ -0,0 +1,545 @@
+/* chat_swarm.c — 채팅 서버 부하 발생기 (봇 떼)
+ *
+ *   gcc -O2 -o chat_swarm chat_swarm.c
+ *   ./chat_swarm --port 9190 --clients 1000 --rooms 10 --rate 1000 --duration 10
+ *   ./chat_swarm --port 9190 --clients 1000,5000,10000 --rate 100,1000 --rooms 10   # 조합마다 한 줄
+ *
+ * 프로세스 하나, epoll 루프 하나로 봇 수천 개를 돌린다. 봇은 프레임 모드로 접속해 --rooms 개 방에 고르게 들어가고,
+ * 모두 들어가면 전체 초당 --rate 개의 메시지를 일정 간격으로 예약해 봇에 돌아가며 배정한다 (open-loop).
+ * 메시지 본문에 예약 시각을 넣어 두고, 같은 방의 다른 봇이 받을 때마다 (받은 시각 - 예약 시각) 을 기록한다.
+ * 결과: 받은 건수/초, 전달 지연 분포 (p50/p99/max), 유실률 (받아야 할 건수 대비 못 받은 건수), 끊긴 봇 수
+ *
+ *   ./chat_swarm --port 9190 --clients 5000 --rooms 10 --storm [--resume]   # 그동안 서버를 재시작한다
+ *   ./chat_swarm --port 9201,9202,9203 --clients 3000 --rooms 10              # 클러스터: 방마다 노드에 고르게 나눠 접속
+ *
+ * --storm: 봇이 모두 들어가면 서버가 끊기를 기다렸다가 (재시작) 모두 다시 접속해 같은 방으로 돌아간다.
+ * --resume 이면 /session 으로 받아 둔 토큰으로 /resume 하고, 아니면 새로 /join 한다.
+ * 결과: 끊긴 뒤 다시 받아 줄 때까지, 그때부터 모두 방에 돌아갈 때까지 걸린 시간, 그동안 받은 바이트 (대부분 입장 알림)
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <getopt.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include "hdr_histogram.h"
+
+#define MAX_EVENTS 256
+#define FRAME_HDR 4
+#define MAX_FRAME 2048             // 서버가 보내는 프레임 본문 최대 길이 (넉넉히)
+#define OUT_MAX 4096               // 봇마다 못 보낸 바이트를 들고 있을 크기. 넘치면 그 메시지는 못 보낸 것으로 센다
+#define MAX_SWEEP 16               // --clients / --rate 목록 최대 길이
+#define READY_TIMEOUT 60           // 모든 봇이 방에 들어가기를 기다리는 최대 초
+
+struct bot {
+    int fd;
+    int room;
+    uint8_t ready;                 // /join 응답을 받음
+    uint8_t dead;                  // 서버가 끊음 (느린 클라이언트로 찍혔거나 오류)
+    uint8_t resumed;               // /resume 이 받아들여짐 (--storm)
+    uint16_t inlen;                // in 에 든 바이트 수
+    uint16_t outlen;               // out 에 든 바이트 수
+    char in[FRAME_HDR + MAX_FRAME]; // 다 못 받은 프레임 (또는 줄)
+    char *out;                     // 소켓 버퍼가 차서 못 보낸 바이트 (있을 때만 할당)
+    char *token;                   // 마지막으로 받은 세션 토큰 (--storm)
+};
+
+static const char *host = "127.0.0.1";
+static int ports[MAX_SWEEP] = { 9190 }, nports = 1; // --port 목록. 방마다 봇을 노드들에 돌아가며 붙인다
+static int clients_list[MAX_SWEEP] = { 1000 }, nclients_list = 1;
+static double rate_list[MAX_SWEEP] = { 1000 };
+static int nrate_list = 1;
+static int rooms = 10;             // 0 이면 모두 lobby
+static size_t size = 64;           // 메시지 본문 크기 (시각 등 머리 포함)
+static double duration = 10, warmup = 2, drain = 2;
+static int storm, resume;          // --storm, --resume
+
+static int epfd;
+static struct bot *bots;
+static int nbots;
+static int *room_live;             // 방마다 살아 있는 봇 수
+static int ready_count, dead_count;
+static uint32_t run_id;            // 이번 실행의 메시지만 센다 (방 기록으로 다시 오는 예전 메시지는 무시)
+static uint64_t warm_end, send_end; // 이 사이에 예약된 메시지만 잰다
+static uint64_t received, expected, unsent;
+static uint64_t rx_bytes;          // 받은 바이트 (--storm 의 알림 트래픽)
+static struct hdr_histogram hist;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void kill_bot(struct bot *b)
+{
+    if (b->dead)
+        return;
+    b->dead = 1;
+    dead_count++;
+    if (b->ready)
+        room_live[b->room]--;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, b->fd, NULL);
+}
+
+// 프레임 하나를 보낸다. 못 보낸 나머지는 out 에 두고 EPOLLOUT 을 켠다. 둘 곳도 없으면 -1
+static int send_frame(struct bot *b, const char *data, size_t len)
+{
+    char buf[FRAME_HDR + MAX_FRAME];
+    buf[0] = len >> 24; buf[1] = len >> 16; buf[2] = len >> 8; buf[3] = len;
+    memcpy(buf + FRAME_HDR, data, len);
+    size_t total = FRAME_HDR + len, off = 0;
+    if (!b->outlen) {
+        ssize_t w = write(b->fd, buf, total);
+        if (w == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            kill_bot(b);
+            return -1;
+        }
+        off = w > 0 ? (size_t)w : 0;
+        if (off == total)
+            return 0;
+    }
+    if (b->outlen + (total - off) > OUT_MAX)
+        return -1;
+    if (!b->out && !(b->out = malloc(OUT_MAX)))
+        return -1;
+    memcpy(b->out + b->outlen, buf + off, total - off);
+    if (!b->outlen) {
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT, .data.ptr = b };
+        epoll_ctl(epfd, EPOLL_CTL_MOD, b->fd, &ev);
+    }
+    b->outlen += total - off;
+    return 0;
+}
+
+static void flush_out(struct bot *b)
+{
+    ssize_t w = write(b->fd, b->out, b->outlen);
+    if (w == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            kill_bot(b);
+        return;
+    }
+    memmove(b->out, b->out + w, b->outlen - w);
+    b->outlen -= w;
+    if (!b->outlen) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = b };
+        epoll_ctl(epfd, EPOLL_CTL_MOD, b->fd, &ev);
+    }
+}
+
+static void send_join(struct bot *b)
+{
+    char cmd[64];
+    int len = rooms ? snprintf(cmd, sizeof(cmd), "/join swarm-%d", b->room)
+                    : snprintf(cmd, sizeof(cmd), "/join lobby");
+    send_frame(b, cmd, len);
+}
+
+// 받은 프레임 하나. 이번 실행의 측정 구간 메시지면 지연을 기록한다
+static void on_frame(struct bot *b, const char *p, size_t len, uint64_t now)
+{
+    char tag[16];
+    int n = snprintf(tag, sizeof(tag), "SW%08x:", run_id);
+    const char *m = memmem(p, len, tag, n);
+    if (!m) {
+        static const char sess[] = "[세션] ";
+        if (len > sizeof(sess) - 1 && memcmp(p, sess, sizeof(sess) - 1) == 0) {
+            free(b->token);
+            b->token = strndup(p + sizeof(sess) - 1, len - (sizeof(sess) - 1));
+        } else if (!b->ready && memmem(p, len, "이어받지 못했습니다", strlen("이어받지 못했습니다"))) {
+            send_join(b);          // 토큰이 안 통하면 새로 들어간다
+        } else if (!b->ready && (memmem(p, len, "들어왔습니다", strlen("들어왔습니다")) ||
+                                 memmem(p, len, "이어받았습니다", strlen("이어받았습니다")))) {
+            b->ready = 1;
+            b->resumed = memmem(p, len, "이어받았습니다", strlen("이어받았습니다")) != NULL;
+            ready_count++;
+            room_live[b->room]++;
+        }
+        return;
+    }
+    // "SW<run>:<예약 시각 ns>:" 뒤는 채움 문자
+    uint64_t ts = strtoull(m + n, NULL, 10);
+    if (ts < warm_end || ts >= send_end)
+        return;
+    received++;
+    hdr_record(&hist, now > ts ? now - ts : 0);
+}
+
+// 읽기 가능: 앞에서 남은 조각 뒤에 이어 읽고, 다 받은 프레임마다 on_frame. 나머지는 다음 read 까지 들고 있는다
+static void on_readable(struct bot *b)
+{
+    char buf[sizeof(b->in) + 64 * 1024];
+    size_t have = b->inlen;
+    memcpy(buf, b->in, have);
+    ssize_t r = read(b->fd, buf + have, sizeof(buf) - have);
+    if (r == 0 || (r == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        kill_bot(b);
+        return;
+    }
+    if (r <= 0)
+        return;
+    rx_bytes += r;
+    have += r;
+    uint64_t now = now_ns();
+    size_t pos = 0;
+    // 서버가 hello(길이 0 프레임)를 읽기 전에 보낸 것은 줄 모드("\r" + 본문 + "\n")로 온다.
+    // 프레임 길이 머리의 첫 바이트는 항상 0 이므로 첫 바이트로 구분한다
+    while (pos < have) {
+        if (buf[pos] == '\r') {
+            char *nl = memchr(buf + pos, '\n', have - pos);
+            if (!nl)
+                break;
+            on_frame(b, buf + pos + 1, nl - (buf + pos + 1), now);
+            pos = nl - buf + 1;
+            continue;
+        }
+        if (have - pos < FRAME_HDR)
+            break;
+        const unsigned char *h = (const unsigned char *)buf + pos;
+        uint32_t len = (uint32_t)h[0] << 24 | (uint32_t)h[1] << 16 | (uint32_t)h[2] << 8 | h[3];
+        if (len > MAX_FRAME) {
+            kill_bot(b);
+            return;
+        }
+        if (have - pos < FRAME_HDR + len)
+            break;
+        on_frame(b, buf + pos + FRAME_HDR, len, now);
+        pos += FRAME_HDR + len;
+    }
+    if (have - pos > sizeof(b->in)) {
+        kill_bot(b);
+        return;
+    }
+    b->inlen = have - pos;
+    memcpy(b->in, buf + pos, b->inlen);
+}
+
+// 이벤트를 처리한다. timeout_ms 만큼까지 기다린다
+static void poll_once(int timeout_ms)
+{
+    struct epoll_event events[MAX_EVENTS];
+    int n = epoll_wait(epfd, events, MAX_EVENTS, timeout_ms);
+    for (int i = 0; i < n; i++) {
+        struct bot *b = events[i].data.ptr;
+        if (b->dead)
+            continue;
+        if (events[i].events & EPOLLOUT)
+            flush_out(b);
+        if (!b->dead && (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+            on_readable(b);
+    }
+}
+
+// 봇 i 가 붙을 주소. 방 i % rooms 의 봇들이 --port 목록에 고르게 퍼지도록
+static struct sockaddr_in server_addr(int i)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(ports[(rooms ? i / rooms : i) % nports]);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        fprintf(stderr, "bad host %s\n", host);
+        exit(1);
+    }
+    return addr;
+}
+
+// 봇 하나를 접속시키고 방에 들어가라고 보낸다 (토큰이 있고 --resume 이면 /resume). 연결이 안 되면 -1
+static int connect_bot(struct bot *b, const struct sockaddr_in *addr)
+{
+    static const char hello[FRAME_HDR] = { 0, 0, 0, 0 }; // 길이 0 프레임: 프레임 모드로 알린다
+    b->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (b->fd == -1)
+        return -1;
+    if (connect(b->fd, (const struct sockaddr *)addr, sizeof(*addr)) == -1) { // 연결은 블로킹으로
+        close(b->fd);
+        b->fd = -1;
+        return -1;
+    }
+    int one = 1;
+    setsockopt(b->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(b->fd, F_SETFL, fcntl(b->fd, F_GETFL) | O_NONBLOCK);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = b };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, b->fd, &ev);
+    if (write(b->fd, hello, sizeof(hello)) != sizeof(hello)) {
+        kill_bot(b);
+        return 0;
+    }
+    if (resume && b->token) {
+        char cmd[MAX_FRAME];
+        int len = snprintf(cmd, sizeof(cmd), "/resume %s", b->token);
+        send_frame(b, cmd, len);
+        return 0;
+    }
+    if (storm)
+        send_frame(b, "/session", 8); // 방에 들어갈 때마다 토큰을 받는다
+    send_join(b);
+    return 0;
+}
+
+// 봇을 모두 접속시키고 방에 넣는다. 준비된 봇 수를 돌려준다
+static int connect_all(int n)
+{
+    for (int i = 0; i < n; i++) {
+        struct bot *b = &bots[i];
+        memset(b, 0, sizeof(*b));
+        b->room = rooms ? i % rooms : 0;
+        struct sockaddr_in addr = server_addr(i);
+        if (connect_bot(b, &addr) == -1) {
+            perror("connect");
+            exit(1);
+        }
+        if (i % 64 == 63)          // 접속하는 동안에도 입장 알림을 읽어 준다 (안 읽으면 서버가 느린 클라이언트로 끊는다)
+            poll_once(0);
+    }
+    uint64_t deadline = now_ns() + READY_TIMEOUT * 1000000000ull;
+    while (ready_count + dead_count < n && now_ns() < deadline)
+        poll_once(10);
+    return ready_count;
+}
+
+// --storm: 서버가 모두를 끊으면 (재시작) 다시 받아 줄 때까지 접속을 되풀이하고, 모두 방에 돌아갈 때까지 잰다
+static void run_storm(int n)
+{
+    fprintf(stderr, "%d bots ready, restart the server now\n", n);
+    while (dead_count == 0)
+        poll_once(100);
+    uint64_t down = now_ns();
+    while (dead_count < n && now_ns() - down < 5000000000ull)
+        poll_once(10);             // 나머지도 끊기를 잠깐 기다린다
+    for (int i = 0; i < n; i++) {
+        struct bot *b = &bots[i];
+        if (!b->dead) {            // 안 끊긴 봇은 여기서 끊고 같이 다시 접속한다
+            kill_bot(b);
+        }
+        close(b->fd);
+        b->fd = -1;
+        free(b->out);
+        b->out = NULL;
+        b->ready = b->dead = b->resumed = 0;
+        b->inlen = b->outlen = 0;
+    }
+    ready_count = dead_count = 0;
+    rx_bytes = 0;
+
+    // 서버가 다시 뜰 때까지 첫 봇으로 두드린다
+    struct sockaddr_in addr = server_addr(0);
+    while (connect_bot(&bots[0], &addr) == -1)
+        usleep(10000);
+    uint64_t up = now_ns();
+    for (int i = 1; i < n; i++) {
+        addr = server_addr(i);
+        while (connect_bot(&bots[i], &addr) == -1) // 백로그가 넘치면 잠깐 쉬었다 다시
+            poll_once(10);
+        if (i % 64 == 63)
+            poll_once(0);
+    }
+    uint64_t deadline = now_ns() + READY_TIMEOUT * 1000000000ull;
+    while (ready_count + dead_count < n && now_ns() < deadline)
+        poll_once(10);
+    uint64_t all = now_ns();
+    int resumed = 0;
+    for (int i = 0; i < n; i++)
+        resumed += bots[i].resumed;
+    printf("%8d %6d %9s %10.2f %10.2f %12.1f %10.0f %8d %6d  (%d/%d ready)\n",
+           n, rooms, resume ? "resume" : "join", (up - down) / 1e9, (all - up) / 1e9, rx_bytes / 1e6,
+           (double)rx_bytes / n, resumed, dead_count, ready_count, n);
+    fflush(stdout);
+}
+
+static void run(int n, double rate)
+{
+    nbots = n;
+    bots = calloc(n, sizeof(*bots));
+    room_live = calloc(rooms ? rooms : 1, sizeof(*room_live));
+    if (!bots || !room_live) {
+        perror("calloc");
+        exit(1);
+    }
+    epfd = epoll_create1(0);
+    ready_count = dead_count = 0;
+    received = expected = unsent = 0;
+    hdr_init(&hist);
+    run_id = (uint32_t)getpid() << 8 ^ (uint32_t)now_ns();
+    warm_end = send_end = UINT64_MAX;   // 준비하는 동안 받은 메시지는 세지 않는다
+
+    uint64_t t0 = now_ns();
+    int ready = connect_all(n);
+    double setup = (now_ns() - t0) / 1e9;
+    if (storm) {
+        run_storm(n);
+        goto out;
+    }
+
+    // 보내기: 예약 시각 next 가 지난 메시지를 봇에 돌아가며 배정한다. 지연은 예약 시각부터 잰다
+    uint64_t interval = (uint64_t)(1e9 / rate);
+    uint64_t start = now_ns();
+    warm_end = start + (uint64_t)(warmup * 1e9);
+    send_end = warm_end + (uint64_t)(duration * 1e9);
+    uint64_t end = send_end + (uint64_t)(drain * 1e9);
+    uint64_t next = start, sent = 0;
+    int k = 0;
+    char payload[MAX_FRAME];
+    uint64_t now;
+    while ((now = now_ns()) < end) {
+        while (next <= now && next < send_end) {
+            struct bot *b = NULL;
+            for (int tries = 0; tries < n && !b; tries++, k = (k + 1) % n)
+                if (!bots[k].dead && bots[k].ready)
+                    b = &bots[k];
+            if (!b)
+                break;
+            int len = snprintf(payload, sizeof(payload), "SW%08x:%llu:", run_id, (unsigned long long)next);
+            while ((size_t)len < size)
+                payload[len++] = 'x';
+            int rc = send_frame(b, payload, len);
+            if (next >= warm_end) {
+                sent++;
+                if (rc == -1)
+                    unsent++;
+                else
+                    expected += room_live[b->room] - 1; // 같은 방의 다른 봇 모두가 받아야 한다
+            }
+            next += interval;
+        }
+        int timeout;
+        if (next < send_end)
+            timeout = next > now ? (int)((next - now + 999999) / 1000000) : 0;
+        else
+            timeout = (int)((end - now + 999999) / 1000000);
+        poll_once(timeout);
+    }
+
+    double secs = duration;
+    printf("%8d %6d %9.0f %9llu %12.0f %8.2f %8.2f %8.2f %8.2f %7.3f%% %6d  (setup %.1fs, %d/%d ready)\n",
+           n, rooms, rate, (unsigned long long)sent, received / secs,
+           hdr_percentile(&hist, 50.0) / 1e6, hdr_percentile(&hist, 99.0) / 1e6,
+           hdr_percentile(&hist, 99.9) / 1e6, hist.max / 1e6,
+           expected ? 100.0 * (double)(expected > received ? expected - received : 0) / expected : 0.0,
+           dead_count, setup, ready, n);
+    if (unsent)
+        printf("         %llu messages not sent (bot send buffer full)\n", (unsigned long long)unsent);
+    fflush(stdout);
+
+out:
+    for (int i = 0; i < n; i++) {
+        close(bots[i].fd);
+        free(bots[i].out);
+        free(bots[i].token);
+    }
+    close(epfd);
+    free(bots);
+    free(room_live);
+}
+
+// "1000,2000,5000" 같은 목록
+static int parse_list(const char *s, double *out)
+{
+    int n = 0;
+    while (*s && n < MAX_SWEEP) {
+        char *end;
+        out[n++] = strtod(s, &end);
+        if (end == s)
+            return 0;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage : %s [--host IP] [--port N[,N...]] [--clients N[,N...]] [--rate MSGS_PER_SEC[,...]] [--rooms K]\n"
+           "               [--size BYTES] [--duration SEC] [--warmup SEC] [--drain SEC] [--storm [--resume]]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_opts[] = {
+        {"host", required_argument, NULL, 'h'},
+        {"port", required_argument, NULL, 'p'},
+        {"clients", required_argument, NULL, 'c'},
+        {"rate", required_argument, NULL, 'r'},
+        {"rooms", required_argument, NULL, 'R'},
+        {"size", required_argument, NULL, 's'},
+        {"duration", required_argument, NULL, 'd'},
+        {"warmup", required_argument, NULL, 'w'},
+        {"drain", required_argument, NULL, 'D'},
+        {"storm", no_argument, NULL, 'S'},
+        {"resume", no_argument, NULL, 'u'},
+        {NULL, 0, NULL, 0}
+    };
+    double tmp[MAX_SWEEP];
+    int ch;
+    while ((ch = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+        switch (ch) {
+        case 'h': host = optarg; break;
+        case 'p':
+            nports = parse_list(optarg, tmp);
+            for (int i = 0; i < nports; i++)
+                ports[i] = (int)tmp[i];
+            break;
+        case 'c':
+            nclients_list = parse_list(optarg, tmp);
+            for (int i = 0; i < nclients_list; i++)
+                clients_list[i] = (int)tmp[i];
+            break;
+        case 'r': nrate_list = parse_list(optarg, rate_list); break;
+        case 'R': rooms = atoi(optarg); break;
+        case 's': size = strtoul(optarg, NULL, 10); break;
+        case 'd': duration = atof(optarg); break;
+        case 'w': warmup = atof(optarg); break;
+        case 'D': drain = atof(optarg); break;
+        case 'S': storm = 1; break;
+        case 'u': resume = 1; break;
+        default: usage(argv[0]); exit(1);
+        }
+    }
+    int bad = optind != argc || nports == 0 || nclients_list == 0 || nrate_list == 0 || rooms < 0 ||
+              size < 32 || size > 900 || duration <= 0 || warmup < 0 || drain < 0;
+    for (int i = 0; i < nclients_list; i++)
+        bad |= clients_list[i] < 2;
+    for (int i = 0; i < nrate_list; i++)
+        bad |= rate_list[i] <= 0;
+    if (bad) {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    // 봇마다 fd 하나. soft 한도를 hard 한도까지 올려 둔다
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    if (storm) {
+        printf("%s:%d, restart storm (seconds)\n", host, ports[0]);
+        printf("%8s %6s %9s %10s %10s %12s %10s %8s %6s\n",
+               "clients", "rooms", "mode", "down", "recover", "rx MB", "rx B/bot", "resumed", "kicked");
+        for (int i = 0; i < nclients_list; i++)
+            run(clients_list[i], rate_list[0]);
+        return 0;
+    }
+    printf("%s:%d%s, size %zu, warmup %.0fs, duration %.0fs, drain %.0fs (latency in ms)\n",
+           host, ports[0], nports > 1 ? " and more" : "", size, warmup, duration, drain);
+    printf("%8s %6s %9s %9s %12s %8s %8s %8s %8s %8s %6s\n",
+           "clients", "rooms", "rate/s", "sent", "deliver/s", "p50", "p99", "p999", "max", "loss", "kicked");
+    for (int i = 0; i < nclients_list; i++)
+        for (int j = 0; j < nrate_list; j++)
+            run(clients_list[i], rate_list[j]);
+    return 0;
+}
@@ -2,6 +2,7 @@
 #include <string> 
 #include <unistd.h> // for close(), read(), write()
 #include <arpa/inet.h>
+#include "fastlog.h"
 
 constexpr int PORT     = 5001;
 constexpr int BUF_SIZE = 1024;
@@ -33,7 +34,8 @@ int main() {
         return 1;
     }
 
-    std::cout << "[C++] Listening on port " << PORT << "...\n";
+    fastlog_init(nullptr, 0);
+    FLOG(FLOG_INFO, "[C++] Listening on port %d...", PORT);
 
     while (true) {
         sockaddr_in client_addr{};
@@ -47,9 +49,7 @@ int main() {
             continue;
         }
 
-        std::cout << "[C++] Client connected: "
-                  << ::inet_ntoa(client_addr.sin_addr)
-                  << ":" << ntohs(client_addr.sin_port) << "\n";
+        FLOG(FLOG_INFO, "[C++] Client connected: " FLOG_ADDR_FMT, FLOG_ADDR_ARGS(&client_addr));
 
         char buf[BUF_SIZE];
 
@@ -59,7 +59,7 @@ int main() {
                 perror("read");
                 break;
             } else if (n == 0) {
-                std::cout << "[C++] Client disconnected\n";
+                FLOG(FLOG_INFO, "[C++] Client disconnected");
                 break;
             }
 
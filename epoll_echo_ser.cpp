@@ -1,17 +1,76 @@
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstddef>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sched.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/epoll.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <linux/io_uring.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include "fastlog.h"
+#include "timer_wheel.h"
 
 constexpr int PORT       = 5001;
 constexpr int MAX_EVENTS = 128;
 constexpr int BUF_SIZE   = 1024;
+constexpr int MAX_IOV    = 64;           // sendmsg 한 번에 넘길 최대 청크 수
+constexpr size_t DEFAULT_HWM = 256 * 1024;  // 출력 큐 high-water mark (바이트)
+constexpr int DEFAULT_ACCEPT_BUDGET = 64;   // 루프 한 바퀴에 accept 할 최대 연결 수
+constexpr uint32_t TIMER_TICK_MS     = 10;  // 타이머 휠 한 틱
+constexpr uint32_t DEFAULT_IDLE_SEC      = 300;  // 읽기/쓰기 진전이 없으면 닫기까지
+constexpr uint32_t DEFAULT_HANDSHAKE_SEC = 30;   // 접속 후 첫 데이터까지
+constexpr uint32_t DEFAULT_STALL_SEC     = 30;   // 상대가 읽지 않아 송신이 막힌 채로 버틸 시간
+constexpr size_t DEFAULT_READ_BUDGET = 64 * 1024; // 한 바퀴에 연결 하나에서 읽을 최대 바이트 (0 이면 무제한)
+constexpr size_t MAX_HWM = UINT32_MAX - BUF_SIZE; // Connection::pending 이 32비트라서
+
+enum class Engine { Epoll, Uring };
+
+// 로그 샘플링 단위 (FASTLOG_SAMPLE=conn=100,close=100)
+enum { EV_CONN, EV_CLOSE, EV_SHED, EV_TIMEOUT };
+static const char* const log_events[] = { "conn", "close", "shed", "timeout" };
+
+// 실행 옵션
+//   --engine=epoll|uring : 이벤트 엔진 (기본 epoll). uring 을 못 쓰는 커널이면 epoll 로 대체
+//   --threads N : reactor 스레드 수 (스레드마다 epoll/io_uring 인스턴스 + SO_REUSEPORT 리슨 소켓)
+//   --pin       : reactor i 를 허용된 CPU 중 i 번째(순환)에 고정
+//   --hwm BYTES : 연결별 출력 큐가 이만큼 쌓이면 그 연결은 읽기를 멈춘다 (절반 이하로 줄면 재개)
+//   --accept-budget N : 루프 한 바퀴에 accept 할 최대 연결 수 (epoll 엔진. uring 은 완료 단위로 처리)
+//   --max-conns N     : 프로세스 전체 동시 연결 상한. reactor 마다 N/threads 씩 나눠 갖는다
+//   --idle-timeout / --handshake-timeout / --stall-timeout SEC : 연결 타임아웃 (epoll 엔진, 0 이면 끔)
+//   --read-budget BYTES : 한 바퀴에 연결 하나에서 읽을 최대 바이트 (epoll 엔진, 0 이면 무제한)
+struct Options {
+    Engine engine  = Engine::Epoll;
+    int    threads = 1;
+    bool   pin     = false;
+    size_t hwm     = DEFAULT_HWM;
+    int    accept_budget = DEFAULT_ACCEPT_BUDGET;
+    size_t max_conns = 0;
+    uint32_t idle_ms      = DEFAULT_IDLE_SEC * 1000;
+    uint32_t handshake_ms = DEFAULT_HANDSHAKE_SEC * 1000;
+    uint32_t stall_ms     = DEFAULT_STALL_SEC * 1000;
+    size_t   read_budget  = DEFAULT_READ_BUDGET;
+};
+
+// reactor 하나의 연결 상한 (올림). reactor 끼리 카운터를 공유하지 않으려고 미리 나눠 둔다
+static size_t per_reactor_cap(const Options& opt) {
+    if (opt.max_conns == 0) return 0;
+    return (opt.max_conns + opt.threads - 1) / opt.threads;
+}
 
 int make_socket_nonblocking(int fd) {
     int flags = ::fcntl(fd, F_GETFL, 0);
@@ -20,15 +79,23 @@ int make_socket_nonblocking(int fd) {
     return 0;
 }
 
-int main() {
+// 스레드마다 하나씩 만드는 리슨 소켓.
+// SO_REUSEPORT 로 같은 포트에 여러 소켓을 bind 하면 커널이 4-tuple 해시로
+// 새 연결을 소켓(=reactor)들에 나눠 준다. accept 경쟁(thundering herd)도 없다.
+static int create_listen_socket() {
     int listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
     if (listen_fd == -1) {
         perror("socket");
-        return 1;
+        return -1;
     }
 
     int opt = 1;
     ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1) {
+        perror("setsockopt SO_REUSEPORT");
+        ::close(listen_fd);
+        return -1;
+    }
 
     sockaddr_in serv_addr{};
     serv_addr.sin_family      = AF_INET;
@@ -39,134 +106,1295 @@ int main() {
                sizeof(serv_addr)) == -1) {
         perror("bind");
         ::close(listen_fd);
-        return 1;
+        return -1;
     }
 
     if (::listen(listen_fd, SOMAXCONN) == -1) {
         perror("listen");
         ::close(listen_fd);
-        return 1;
+        return -1;
     }
 
     if (make_socket_nonblocking(listen_fd) == -1) {
         perror("fcntl");
         ::close(listen_fd);
-        return 1;
+        return -1;
+    }
+    return listen_fd;
+}
+
+// 현재 스레드를 허용된 CPU 목록 중 (id % 개수) 번째 CPU에 고정
+static void pin_to_cpu(int id) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (::sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+        perror("sched_getaffinity");
+        return;
+    }
+
+    int ncpu = CPU_COUNT(&allowed);
+    if (ncpu <= 0) return;
+
+    int target = id % ncpu;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed)) continue;
+        if (target-- > 0) continue;
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        int rc = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+        if (rc != 0)
+            std::cerr << "pthread_setaffinity_np: " << std::strerror(rc) << "\n";
+        return;
+    }
+}
+
+// 에코 데이터 조각 (출력 큐의 원소). ChunkPool 에서만 꺼내고 돌려준다.
+struct Chunk {
+    Chunk*   next;
+    uint32_t off;              // 여기까지는 이미 보냄
+    uint32_t len;              // data 에 채워진 길이
+    char     data[BUF_SIZE];
+};
+
+// reactor 마다 하나씩 있는 청크 풀.
+// 비면 CHUNKS_PER_SLAB 개를 한 번에 할당해서 free list 에 넣고, 쓴 청크는 해제하지 않고 되돌린다.
+// 정상 상태의 읽기/쓰기 경로에서는 malloc/free 가 일어나지 않는다.
+class ChunkPool {
+public:
+    ChunkPool() = default;
+    ChunkPool(const ChunkPool&) = delete;
+    ChunkPool& operator=(const ChunkPool&) = delete;
+    ~ChunkPool() {
+        for (Chunk* slab : slabs_) delete[] slab;
+    }
+
+    Chunk* get() {
+        if (!free_) grow();
+        Chunk* c = free_;
+        free_   = c->next;
+        c->next = nullptr;
+        c->off  = 0;
+        c->len  = 0;
+        return c;
+    }
+
+    void put(Chunk* c) {
+        c->next = free_;
+        free_   = c;
+    }
+
+private:
+    static constexpr size_t CHUNKS_PER_SLAB = 256;
+
+    void grow() {
+        Chunk* slab = new Chunk[CHUNKS_PER_SLAB];
+        slabs_.push_back(slab);
+        for (size_t i = 0; i < CHUNKS_PER_SLAB; ++i) put(&slab[i]);
+    }
+
+    Chunk*              free_ = nullptr;
+    std::vector<Chunk*> slabs_;
+};
+
+// 연결 하나의 상태. epoll_event.data.ptr 로 바로 찾아온다.
+// 버퍼는 데이터가 밀려 있을 때만 청크로 붙으므로 유휴 연결은 이 구조체(캐시 라인 하나, 아래 assert)만 차지한다.
+// 큐가 비어 있지 않을 때만 EPOLLOUT 을 켜고, high-water mark 를 넘으면 EPOLLIN 을 꺼서
+// 느린 클라이언트가 메모리를 무한정 쓰지 못하게 한다.
+struct Connection {
+    int         fd      = -1;
+    uint32_t    events  = 0;      // 지금 epoll 에 등록된 이벤트
+    Chunk*      head    = nullptr;
+    Chunk*      tail    = nullptr;
+    uint32_t    pending = 0;      // 출력 큐에 남은 바이트 (hwm + BUF_SIZE 를 넘지 않는다)
+    uint32_t    last_active = 0;  // 마지막으로 읽기/쓰기가 진전된 타이머 틱
+    union {                       // 빈 칸일 때는 free list 링크, 쓰는 중에는 타이머 노드
+        Connection* next_free = nullptr;
+        tw_node     timer;
+    };
+    bool        blocked = false;  // 마지막 sendmsg 가 EAGAIN: EPOLLOUT 전까지 쓰기 시도 안 함
+    bool        paused  = false;  // high-water mark 초과로 읽기 중단
+    bool        eof     = false;  // 상대가 FIN 을 보냄: 남은 데이터만 보내고 닫는다
+    bool        active  = false;  // 첫 데이터를 받음 (그 전에는 핸드셰이크 타임아웃)
+    bool        ready   = false;  // 읽기 예산을 다 써서 Loop::ready 에 올라 있음
+};
+static_assert(sizeof(Connection) <= 64, "Connection 은 캐시 라인 하나에 들어가야 한다");
+
+// Connection 슬랩. 블록 단위로 할당해서 주소가 움직이지 않으므로 (data.ptr 에 넣어도 안전)
+// reactor 마다 따로 두면 fd 번호 공간을 스레드 수만큼 중복해서 잡을 필요가 없다.
+class ConnSlab {
+public:
+    ConnSlab() = default;
+    ConnSlab(const ConnSlab&) = delete;
+    ConnSlab& operator=(const ConnSlab&) = delete;
+    ~ConnSlab() {
+        for (Connection* block : blocks_) delete[] block;
+    }
+
+    Connection* get(int fd) {
+        if (!free_) grow();
+        Connection* c = free_;
+        free_ = c->next_free;
+        *c = Connection{};
+        c->fd = fd;
+        ++live_;
+        return c;
+    }
+
+    void put(Connection* c) {
+        c->fd        = -1;
+        c->next_free = free_;
+        free_        = c;
+        --live_;
+    }
+
+    size_t live() const { return live_; }
+
+private:
+    static constexpr size_t CONNS_PER_BLOCK = 4096;
+
+    void grow() {
+        Connection* block = new Connection[CONNS_PER_BLOCK];
+        blocks_.push_back(block);
+        for (size_t i = CONNS_PER_BLOCK; i-- > 0;) {
+            block[i].next_free = free_;
+            free_ = &block[i];
+        }
+    }
+
+    Connection*              free_ = nullptr;
+    std::vector<Connection*> blocks_;
+    size_t                   live_ = 0;
+};
+
+struct Loop {
+    int         epfd      = -1;
+    int         listen_fd = -1;
+    size_t      hwm       = 0;
+    int         accept_budget = DEFAULT_ACCEPT_BUDGET;
+    size_t      max_conns = 0;       // 이 reactor 의 동시 연결 상한 (0 이면 fd 한도까지)
+    bool        accept_paused = false;
+    int         reserve_fd = -1;     // fd 가 바닥났을 때 연결을 받아서 끊어 주기 위한 예비 fd
+    std::string tag;
+    ConnSlab    conns;
+    ChunkPool   chunks;
+    timer_wheel wheel;
+    uint32_t    idle_ms = 0, handshake_ms = 0, stall_ms = 0;
+    // 공정한 읽기: 연결마다 한 바퀴에 read_budget 바이트까지만 읽고, 데이터가 남은 연결은
+    // ready 에 올려 배치가 끝난 뒤 돌아가며 한 몫씩 더 읽는다 (대량 송신자 뒤에서 작은 요청이 밀리지 않게).
+    // 닫힌 연결은 빼지 않고 ready 플래그만 지운다. 슬랩 칸이 재사용돼도 get() 이 플래그를 지운다
+    size_t      read_budget = 0;
+    std::vector<Connection*> ready;
+};
+
+// 리슨 소켓 감시를 켜고 끈다. 멈춘 동안 새 연결은 커널 backlog 에서 기다린다.
+// (level-triggered 라서 받지 않고 감시만 계속하면 epoll_wait 가 헛돈다)
+static void set_accepting(Loop& lp, bool on) {
+    epoll_event ev{};
+    ev.events   = on ? static_cast<uint32_t>(EPOLLIN) : 0u;
+    ev.data.ptr = nullptr;
+    if (::epoll_ctl(lp.epfd, EPOLL_CTL_MOD, lp.listen_fd, &ev) == -1) {
+        perror("epoll_ctl listen_fd");
+        return;
+    }
+    lp.accept_paused = !on;
+}
+
+static void resume_accept(Loop& lp) {
+    if (!lp.accept_paused) return;
+    if (lp.max_conns && lp.conns.live() >= lp.max_conns) return;
+    if (lp.reserve_fd == -1)   // fd 고갈로 멈췄던 경우: 예비 fd 부터 다시 확보
+        lp.reserve_fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    set_accepting(lp, true);
+}
+
+static void close_conn(Loop& lp, Connection* c) {
+    tw_del(&lp.wheel, &c->timer);   // put 이 같은 자리에 free list 링크를 쓰기 전에 뗀다
+    c->ready = false;               // ready 에 남은 포인터는 차례가 와도 건너뛴다
+    while (c->head) {
+        Chunk* ch = c->head;
+        c->head = ch->next;
+        lp.chunks.put(ch);
+    }
+    ::epoll_ctl(lp.epfd, EPOLL_CTL_DEL, c->fd, nullptr);
+    ::close(c->fd);
+    lp.conns.put(c);
+    resume_accept(lp);
+}
+
+// 큐를 sendmsg 로 보낼 수 있는 만큼 보낸다. 소켓 에러면 false
+static bool flush_queue(Loop& lp, Connection* c) {
+    while (c->head) {
+        iovec iov[MAX_IOV];
+        int cnt = 0;
+        for (Chunk* ch = c->head; ch && cnt < MAX_IOV; ch = ch->next, ++cnt) {
+            iov[cnt].iov_base = ch->data + ch->off;
+            iov[cnt].iov_len  = ch->len - ch->off;
+        }
+
+        // writev 와 같은 gather 쓰기. 끊긴 소켓이면 SIGPIPE 대신 EPIPE 로 받는다
+        msghdr mh{};
+        mh.msg_iov    = iov;
+        mh.msg_iovlen = static_cast<size_t>(cnt);
+        ssize_t w = ::sendmsg(c->fd, &mh, MSG_NOSIGNAL);
+        if (w == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                c->blocked = true;
+                return true;
+            }
+            perror("sendmsg");
+            return false;
+        }
+
+        c->pending -= w;
+        while (w > 0) {
+            Chunk* ch = c->head;
+            size_t left = ch->len - ch->off;
+            if (static_cast<size_t>(w) < left) {
+                ch->off += w;
+                break;
+            }
+            w -= left;
+            c->head = ch->next;
+            lp.chunks.put(ch);
+        }
+        if (!c->head) c->tail = nullptr;
+    }
+    return true;
+}
+
+// 큐 상태에 맞게 epoll 관심 이벤트를 갱신 (바뀔 때만 epoll_ctl)
+static bool update_events(Loop& lp, Connection* c) {
+    if (c->paused && c->pending <= lp.hwm / 2)
+        c->paused = false;
+
+    uint32_t want = 0;
+    if (!c->eof && !c->paused) want |= EPOLLIN;
+    if (c->pending)            want |= EPOLLOUT;
+    if (want == c->events) return true;
+
+    epoll_event ev{};
+    ev.events   = want;
+    ev.data.ptr = c;
+    if (::epoll_ctl(lp.epfd, EPOLL_CTL_MOD, c->fd, &ev) == -1) {
+        perror("epoll_ctl mod");
+        return false;
+    }
+    c->events = want;
+    return true;
+}
+
+// 지금 상태의 타임아웃: 송신이 막혀 있으면 쓰기 정체, 첫 데이터 전이면 핸드셰이크, 아니면 유휴
+static uint32_t conn_timeout_ms(const Loop& lp, const Connection* c) {
+    if (c->blocked) return lp.stall_ms;
+    return c->active ? lp.idle_ms : lp.handshake_ms;
+}
+
+// 타이머를 last_active + 타임아웃에 건다. 더 이른 만료가 이미 걸려 있으면 두고, 만료 때 다시 계산한다.
+// (읽기/쓰기마다 타이머를 옮기지 않고 last_active 만 갱신)
+static void arm_timer(Loop& lp, Connection* c) {
+    uint32_t ms = conn_timeout_ms(lp, c);
+    if (!ms) {
+        tw_del(&lp.wheel, &c->timer);
+        return;
+    }
+    uint32_t deadline = c->last_active + tw_ms_to_ticks(&lp.wheel, ms);
+    if (!tw_armed(&c->timer) || static_cast<int32_t>(deadline - c->timer.expires) < 0)
+        tw_add_at(&lp.wheel, &c->timer, deadline);
+}
+
+static void expire_timers(Loop& lp) {
+    while (tw_node* t = tw_pop(&lp.wheel)) {
+        auto* c = reinterpret_cast<Connection*>(reinterpret_cast<char*>(t) - offsetof(Connection, timer));
+        uint32_t ms = conn_timeout_ms(lp, c);
+        if (!ms) continue;
+        uint32_t deadline = c->last_active + tw_ms_to_ticks(&lp.wheel, ms);
+        if (static_cast<int32_t>(deadline - lp.wheel.now) > 0) {   // 그사이 활동이 있었음
+            tw_add_at(&lp.wheel, t, deadline);
+            continue;
+        }
+        FLOG_EV(EV_TIMEOUT, FLOG_INFO, "%sclient fd=%d %s timeout", lp.tag.c_str(), c->fd,
+                c->blocked ? "write-stall" : c->active ? "idle" : "handshake");
+        close_conn(lp, c);
     }
+}
+
+// EPOLLIN: 읽은 데이터를 큐 끝에 붙이고 곧바로 보내 본다.
+// 연결이 닫혔으면 false
+static bool handle_read(Loop& lp, Connection* c) {
+    size_t got = 0;
+    c->last_active = lp.wheel.now;
+    c->active = true;
+    while (!c->eof) {
+        if (c->pending >= lp.hwm) {
+            c->paused = true;
+            break;
+        }
 
-    int epfd = ::epoll_create1(0);
-    if (epfd == -1) {
+        // 마지막 청크에 빈 자리가 있으면 거기에 이어서 읽는다
+        Chunk* ch = c->tail;
+        bool fresh = !ch || ch->len == BUF_SIZE;
+        if (fresh) ch = lp.chunks.get();
+
+        ssize_t cnt = ::read(c->fd, ch->data + ch->len, BUF_SIZE - ch->len);
+        if (cnt <= 0) {
+            if (fresh) lp.chunks.put(ch);
+            if (cnt == 0) {
+                c->eof = true;
+                break;
+            }
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // 지금은 더 읽을 데이터 없음
+                break;
+            }
+            perror("read");
+            close_conn(lp, c);
+            return false;
+        }
+
+        if (fresh) {
+            if (c->tail) c->tail->next = ch;
+            else         c->head = ch;
+            c->tail = ch;
+        }
+        ch->len    += cnt;
+        c->pending += cnt;
+
+        if (!c->blocked && !flush_queue(lp, c)) {
+            close_conn(lp, c);
+            return false;
+        }
+        got += cnt;
+        if (lp.read_budget && got >= lp.read_budget) {
+            // 이번 몫은 끝. 남은 데이터는 ready 에서 차례를 기다린다
+            if (!c->ready) {
+                c->ready = true;
+                lp.ready.push_back(c);
+            }
+            break;
+        }
+    }
+
+    if (c->eof && c->pending == 0) {
+        FLOG_EV(EV_CLOSE, FLOG_INFO, "%sclient fd=%d closed", lp.tag.c_str(), c->fd);
+        close_conn(lp, c);
+        return false;
+    }
+    arm_timer(lp, c);   // 송신이 막혔으면 쓰기 정체 타임아웃으로 당겨진다
+    if (!update_events(lp, c)) {
+        close_conn(lp, c);
+        return false;
+    }
+    return true;
+}
+
+// EPOLLOUT: 소켓 버퍼에 자리가 생김. 연결이 닫혔으면 false
+static bool handle_write(Loop& lp, Connection* c) {
+    c->last_active = lp.wheel.now;
+    c->blocked = false;
+    if (!flush_queue(lp, c)) {
+        close_conn(lp, c);
+        return false;
+    }
+    if (c->eof && c->pending == 0) {
+        FLOG_EV(EV_CLOSE, FLOG_INFO, "%sclient fd=%d closed", lp.tag.c_str(), c->fd);
+        close_conn(lp, c);
+        return false;
+    }
+    arm_timer(lp, c);   // 송신이 막혔으면 쓰기 정체 타임아웃으로 당겨진다
+    if (!update_events(lp, c)) {
+        close_conn(lp, c);
+        return false;
+    }
+    return true;
+}
+
+// 리슨 소켓 EPOLLIN: 대기 중인 연결을 최대 accept_budget 개까지 받는다.
+// 남은 연결은 다음 바퀴에 받으므로 재접속 폭주 중에도 기존 클라이언트가 밀리지 않는다.
+static void handle_accept(Loop& lp) {
+    for (int budget = lp.accept_budget; budget > 0; --budget) {
+        if (lp.max_conns && lp.conns.live() >= lp.max_conns) {
+            set_accepting(lp, false);   // 상한 도달: 자리가 날 때까지 accept 중단
+            return;
+        }
+
+        sockaddr_in caddr{};
+        socklen_t clen = sizeof(caddr);
+        // accept4: 논블로킹/close-on-exec 를 같은 시스템 콜에서 설정 (fcntl 2번 절약)
+        int cfd = ::accept4(lp.listen_fd,
+                            reinterpret_cast<sockaddr*>(&caddr),
+                            &clen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (cfd == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return;
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno == EMFILE || errno == ENFILE) {
+                // fd 고갈: 예비 fd 를 잠깐 놓고 대기 중인 연결 하나를 받아 바로 닫는다.
+                // EMFILE 은 대기 중인 연결이 없어도 나오므로 받을 게 없으면 멈춘다.
+                if (lp.reserve_fd != -1) {
+                    ::close(lp.reserve_fd);
+                    int shed = ::accept(lp.listen_fd, nullptr, nullptr);
+                    if (shed != -1) {
+                        ::close(shed);
+                        FLOG_EV(EV_SHED, FLOG_WARN, "%sout of fds: shed one connection", lp.tag.c_str());
+                    }
+                    lp.reserve_fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+                    if (shed == -1) return;
+                    if (lp.reserve_fd != -1) continue;
+                }
+                set_accepting(lp, false);   // 예비 fd 도 없음: 연결이 닫힐 때까지 중단
+                return;
+            }
+            perror("accept");
+            return;
+        }
+
+        Connection* c = lp.conns.get(cfd);
+        epoll_event cev{};
+        cev.events   = EPOLLIN;
+        cev.data.ptr = c;
+        if (::epoll_ctl(lp.epfd, EPOLL_CTL_ADD, cfd, &cev) == -1) {
+            perror("epoll_ctl client");
+            lp.conns.put(c);
+            ::close(cfd);
+            continue;
+        }
+        c->events = EPOLLIN;
+        c->last_active = lp.wheel.now;
+        arm_timer(lp, c);   // 첫 데이터까지 핸드셰이크 타임아웃
+
+        FLOG_EV(EV_CONN, FLOG_INFO, "%sclient fd=%d connected, " FLOG_ADDR_FMT,
+                lp.tag.c_str(), cfd, FLOG_ADDR_ARGS(&caddr));
+    }
+}
+
+// 배치가 끝난 뒤 ready 의 앞쪽 n 개에게 한 몫씩 더 읽힌다. 또 예산을 다 쓴 연결은 끝에 다시 붙어
+// 다음 바퀴로 넘어가고, 그 사이에 epoll_wait(timeout 0) 로 새 이벤트가 끼어든다
+static void run_ready(Loop& lp, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        Connection* c = lp.ready[i];
+        if (!c->ready) continue;    // 그 사이에 닫힌 연결
+        c->ready = false;
+        handle_read(lp, c);
+    }
+    lp.ready.erase(lp.ready.begin(), lp.ready.begin() + n);
+}
+
+// epoll 엔진: reactor 스레드 하나가 epoll 인스턴스 하나를 돈다
+static int run_epoll_reactor(int id, const Options& opt) {
+    Loop lp;
+    lp.hwm           = opt.hwm;
+    lp.accept_budget = opt.accept_budget;
+    lp.max_conns     = per_reactor_cap(opt);
+    lp.idle_ms       = opt.idle_ms;
+    lp.handshake_ms  = opt.handshake_ms;
+    lp.stall_ms      = opt.stall_ms;
+    lp.read_budget   = opt.read_budget;
+    tw_init(&lp.wheel, TIMER_TICK_MS, tw_clock_ms());
+    // 로그 접두사: 여러 스레드가 cout 을 나눠 쓰므로 한 줄을 만들어 한 번에 출력
+    lp.tag = "[C++/epoll#" + std::to_string(id) + "] ";
+
+    lp.listen_fd = create_listen_socket();
+    if (lp.listen_fd == -1) return 1;
+    lp.reserve_fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    lp.epfd = ::epoll_create1(0);
+    if (lp.epfd == -1) {
         perror("epoll_create1");
-        ::close(listen_fd);
+        ::close(lp.listen_fd);
         return 1;
     }
 
+    // 리슨 소켓은 data.ptr == nullptr 로 구분한다
     epoll_event ev{};
-    ev.events  = EPOLLIN;
-    ev.data.fd = listen_fd;
-    if (::epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev) == -1) {
+    ev.events   = EPOLLIN;
+    ev.data.ptr = nullptr;
+    if (::epoll_ctl(lp.epfd, EPOLL_CTL_ADD, lp.listen_fd, &ev) == -1) {
         perror("epoll_ctl listen_fd");
-        ::close(epfd);
-        ::close(listen_fd);
+        ::close(lp.epfd);
+        ::close(lp.listen_fd);
         return 1;
     }
 
-    std::cout << "[C++/epoll] Listening on port " << PORT << "\n";
+    FLOG(FLOG_INFO, "%sListening on port %d", lp.tag.c_str(), PORT);
 
     epoll_event events[MAX_EVENTS];
 
     while (true) {
-        int n = ::epoll_wait(epfd, events, MAX_EVENTS, -1);
+        // 다음 타이머 만료까지만 기다린다 (걸린 타이머가 없으면 -1).
+        // ready 에 읽을 연결이 남아 있으면 기다리지 않고 새 이벤트만 걷어 온다
+        size_t carry = lp.ready.size();
+        int n = ::epoll_wait(lp.epfd, events, MAX_EVENTS,
+                             carry ? 0 : tw_timeout_ms(&lp.wheel, tw_clock_ms()));
         if (n == -1) {
             if (errno == EINTR) continue;
             perror("epoll_wait");
             break;
         }
+        tw_advance(&lp.wheel, tw_clock_ms());
 
         for (int i = 0; i < n; ++i) {
-            int fd = events[i].data.fd;
+            auto* c = static_cast<Connection*>(events[i].data.ptr);
             uint32_t evs = events[i].events;
 
-            if (fd == listen_fd) {
-                // accept 루프
-                while (true) {
-                    sockaddr_in caddr{};
-                    socklen_t clen = sizeof(caddr);
-                    int cfd = ::accept(listen_fd,
-                                       reinterpret_cast<sockaddr*>(&caddr),
-                                       &clen);
-                    if (cfd == -1) {
-                        if (errno == EAGAIN || errno == EWOULDBLOCK)
-                            break;
-                        perror("accept");
-                        break;
-                    }
+            if (!c) {
+                handle_accept(lp);
+                continue;
+            }
 
-                    if (make_socket_nonblocking(cfd) == -1) {
-                        perror("fcntl client");
-                        ::close(cfd);
-                        continue;
-                    }
+            if (evs & (EPOLLERR | EPOLLHUP)) {
+                FLOG_EV(EV_CLOSE, FLOG_INFO, "%sfd=%d error/hup", lp.tag.c_str(), c->fd);
+                close_conn(lp, c);
+                continue;
+            }
 
-                    epoll_event cev{};
-                    cev.events  = EPOLLIN;
-                    cev.data.fd = cfd;
-                    if (::epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &cev) == -1) {
-                        perror("epoll_ctl client");
-                        ::close(cfd);
-                        continue;
-                    }
+            // 쓰기를 먼저 처리해야 큐가 줄어든 상태에서 읽기를 재개할 수 있다
+            if ((evs & EPOLLOUT) && !handle_write(lp, c)) continue;
+            if ((evs & EPOLLIN) && !c->ready)   // ready 에 있으면 배치 뒤에 차례대로 읽는다
+                handle_read(lp, c);
+        }
+        run_ready(lp, carry);
+        expire_timers(lp);
+    }
 
-                    std::cout << "[C++/epoll] client fd=" << cfd
-                              << " connected, ip="
-                              << ::inet_ntoa(caddr.sin_addr)
-                              << " port=" << ntohs(caddr.sin_port)
-                              << "\n";
-                }
-            } else {
-                if (evs & (EPOLLERR | EPOLLHUP)) {
-                    std::cout << "[C++/epoll] fd=" << fd << " error/hup\n";
-                    ::close(fd);
-                    ::epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
-                    continue;
-                }
+    if (lp.reserve_fd != -1) ::close(lp.reserve_fd);
+    ::close(lp.epfd);
+    ::close(lp.listen_fd);
+    return 0;
+}
 
-                if (evs & EPOLLIN) {
-                    char buf[BUF_SIZE];
-
-                    while (true) {
-                        ssize_t cnt = ::read(fd, buf, sizeof(buf));
-                        if (cnt == -1) {
-                            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                                // 지금은 더 읽을 데이터 없음
-                                break;
-                            }
-                            perror("read");
-                            ::close(fd);
-                            ::epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
-                            break;
-                        } else if (cnt == 0) {
-                            std::cout << "[C++/epoll] client fd=" << fd
-                                      << " closed\n";
-                            ::close(fd);
-                            ::epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
-                            break;
-                        } else {
-                            ssize_t w = ::write(fd, buf, cnt);
-                            if (w == -1) {
-                                perror("write");
-                                ::close(fd);
-                                ::epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
-                                break;
-                            }
-                        }
-                    }
-                }
+// ---------------------------------------------------------------------------
+// io_uring 엔진 (--engine=uring)
+//
+// epoll 엔진과 같은 에코 의미(순서 보장, hwm backpressure, FIN 뒤 남은 데이터 전송)를
+// 시스템 콜 수를 줄여서 구현한다. liburing 없이 <linux/io_uring.h> 만 사용한다.
+//   - multishot accept : SQE 하나로 계속 accept, 새 소켓은 registered file 슬롯에 바로 설치
+//   - multishot recv   : SQE 하나로 계속 수신, 버퍼는 provided buffer ring 에서 커널이 고름
+//   - registered files : 소켓을 fd 테이블 대신 링의 고정 슬롯으로 참조 (fget/fput 비용 없음)
+// 받은 버퍼를 그대로 send 하고, send 가 끝나면 버퍼를 링에 되돌린다. (복사 없음)
+// 연결당 send 는 한 번에 하나만 띄워서 에코 순서를 지킨다.
+// ---------------------------------------------------------------------------
+
+constexpr unsigned URING_SQ_ENTRIES = 256;
+constexpr unsigned URING_CQ_ENTRIES = 4096;
+constexpr unsigned URING_BUF_COUNT  = 1024;   // provided buffer 개수 (2의 거듭제곱)
+constexpr unsigned URING_BUF_SIZE   = 4096;
+constexpr uint16_t URING_BGID       = 0;      // buffer group id
+constexpr unsigned URING_MAX_FILES  = 1u << 20;
+constexpr int      ENGINE_UNSUPPORTED = -1;   // 이 커널에서 못 씀: epoll 로 대체
+
+// user_data 배치: op(8) | bid(16) | gen(20) | slot(20)
+// gen 은 슬롯이 닫힐 때마다 증가해서, 닫힌 연결에 대한 늦은 CQE 를 걸러낸다.
+enum UringOp : uint8_t { OP_ACCEPT = 1, OP_RECV, OP_SEND, OP_CLOSE, OP_CANCEL };
+
+static uint64_t make_ud(UringOp op, uint32_t slot, uint32_t gen = 0, uint16_t bid = 0) {
+    return static_cast<uint64_t>(op) << 56 | static_cast<uint64_t>(bid) << 40 |
+           static_cast<uint64_t>(gen & 0xFFFFF) << 20 | (slot & 0xFFFFF);
+}
+static UringOp  ud_op(uint64_t ud)   { return static_cast<UringOp>(ud >> 56); }
+static uint16_t ud_bid(uint64_t ud)  { return static_cast<uint16_t>(ud >> 40); }
+static uint32_t ud_gen(uint64_t ud)  { return (ud >> 20) & 0xFFFFF; }
+static uint32_t ud_slot(uint64_t ud) { return ud & 0xFFFFF; }
+
+// 연결 하나 (registered file 슬롯 번호로 인덱싱)
+struct UConn {
+    uint32_t gen        = 0;
+    bool     open       = false;
+    bool     recv_armed = false;  // multishot recv 가 걸려 있음
+    bool     sending    = false;  // send 가 하나 떠 있음
+    bool     paused     = false;  // hwm 초과로 recv 취소
+    bool     eof        = false;
+    int32_t  head       = -1;     // 보낼 버퍼(bid) FIFO
+    int32_t  tail       = -1;
+    uint32_t send_off   = 0;      // head 버퍼에서 이미 보낸 바이트
+    size_t   pending    = 0;
+};
+
+struct Uring {
+    int            fd = -1;
+    // SQ
+    unsigned*      sq_head  = nullptr;
+    unsigned*      sq_tail  = nullptr;
+    unsigned       sq_mask  = 0;
+    unsigned       sq_entries = 0;
+    io_uring_sqe*  sqes     = nullptr;
+    unsigned       sq_local_tail = 0;
+    unsigned       to_submit = 0;
+    // CQ
+    unsigned*      cq_head  = nullptr;
+    unsigned*      cq_tail  = nullptr;
+    unsigned       cq_mask  = 0;
+    io_uring_cqe*  cqes     = nullptr;
+    // mmap 영역
+    void*          sq_ptr   = MAP_FAILED;
+    size_t         sq_len   = 0;
+    void*          cq_ptr   = MAP_FAILED;
+    size_t         cq_len   = 0;
+    size_t         sqes_len = 0;
+    // provided buffer ring
+    io_uring_buf_ring* br   = nullptr;
+    size_t         br_len   = 0;
+    uint16_t       br_tail  = 0;
+    char*          bufs     = nullptr;
+};
+
+struct ULoop {
+    Uring                 ring;
+    int                   listen_fd = -1;
+    size_t                hwm       = 0;
+    std::string           tag;
+    std::vector<UConn>    conns;
+    std::vector<int32_t>  next_bid;     // 버퍼 FIFO 의 다음 원소
+    std::vector<uint32_t> buf_len;      // 버퍼에 받은 바이트
+    std::vector<uint32_t> starved;      // 버퍼가 떨어져 recv 가 끝난 연결들
+    unsigned              bufs_out  = 0;  // 커널이 가져간(아직 안 돌려준) 버퍼 수
+    size_t                live      = 0;  // 열려 있는 연결 수
+    size_t                max_conns = 0;  // 이 reactor 의 동시 연결 상한 (0 이면 슬롯 테이블 크기까지)
+    bool                  accept_armed  = false;  // multishot accept 가 걸려 있음
+    bool                  accept_paused = false;  // 상한 도달/슬롯 고갈로 accept 중단
+    // SQE 를 얻지 못해 미룬 일. 다음 바퀴에 다시 시도한다
+    std::vector<io_uring_cqe> cq_backlog;  // get_sqe 가 SQ 를 비우려고 CQ 에서 먼저 꺼내 둔 CQE
+    std::vector<uint32_t> retry;        // recv/send 를 못 건 연결
+    std::vector<uint64_t> retry_cancel; // 못 보낸 cancel 의 대상 user_data
+    std::vector<uint32_t> retry_close;  // 못 닫은 registered 슬롯
+    bool                  retry_accept = false;   // accept 를 다시 걸거나 (paused 면) 취소해야 함
+};
+
+static int sys_uring_setup(unsigned entries, io_uring_params* p) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+static int sys_uring_enter(int fd, unsigned submit, unsigned wait, unsigned flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, submit, wait, flags, nullptr, 0));
+}
+static int sys_uring_register(int fd, unsigned op, void* arg, unsigned nr) {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, op, arg, nr));
+}
+
+static void uring_destroy(Uring& r) {
+    if (r.br)                   ::munmap(r.br, r.br_len);
+    delete[] r.bufs;
+    if (r.sqes)                 ::munmap(r.sqes, r.sqes_len);
+    if (r.cq_ptr != MAP_FAILED && r.cq_ptr != r.sq_ptr) ::munmap(r.cq_ptr, r.cq_len);
+    if (r.sq_ptr != MAP_FAILED) ::munmap(r.sq_ptr, r.sq_len);
+    if (r.fd != -1)             ::close(r.fd);
+    r = Uring{};
+}
+
+// 링 생성 + mmap. 커널이 지원하지 않으면 false
+static bool uring_init(Uring& r) {
+    io_uring_params p{};
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN |
+              IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    p.cq_entries = URING_CQ_ENTRIES;
+    r.fd = sys_uring_setup(URING_SQ_ENTRIES, &p);
+    if (r.fd == -1 && errno == EINVAL) {
+        // 6.1 이전 커널: 최적화 플래그 없이 다시 시도
+        p = io_uring_params{};
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = URING_CQ_ENTRIES;
+        r.fd = sys_uring_setup(URING_SQ_ENTRIES, &p);
+    }
+    if (r.fd == -1) {
+        perror("io_uring_setup");
+        return false;
+    }
+
+    r.sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r.cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        r.sq_len = r.cq_len = std::max(r.sq_len, r.cq_len);
+
+    r.sq_ptr = ::mmap(nullptr, r.sq_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, r.fd, IORING_OFF_SQ_RING);
+    if (r.sq_ptr == MAP_FAILED) {
+        perror("mmap sq");
+        uring_destroy(r);
+        return false;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r.cq_ptr = r.sq_ptr;
+    } else {
+        r.cq_ptr = ::mmap(nullptr, r.cq_len, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, r.fd, IORING_OFF_CQ_RING);
+        if (r.cq_ptr == MAP_FAILED) {
+            perror("mmap cq");
+            uring_destroy(r);
+            return false;
+        }
+    }
+
+    r.sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, r.sqes_len, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, r.fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        perror("mmap sqes");
+        uring_destroy(r);
+        return false;
+    }
+    r.sqes = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(r.sq_ptr);
+    char* cq = static_cast<char*>(r.cq_ptr);
+    r.sq_head    = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    r.sq_tail    = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    r.sq_mask    = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    r.sq_entries = p.sq_entries;
+    r.cq_head    = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    r.cq_tail    = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    r.cq_mask    = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    r.cqes       = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+    r.sq_local_tail = *r.sq_tail;
+
+    // SQ 인덱스 배열은 항상 0..n-1 그대로 쓴다
+    unsigned* array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    for (unsigned i = 0; i < p.sq_entries; ++i) array[i] = i;
+    return true;
+}
+
+// 제출하고 완료를 최소 wait 개 기다린다 (0 이면 기다리지 않음).
+// DEFER_TASKRUN 링에서는 GETEVENTS 로 들어갈 때만 완료 처리(task work)가 돌아 CQ 에 CQE 가 채워지고
+// overflow 도 풀리므로, 기다리지 않을 때도 항상 준다
+static int uring_submit(Uring& r, unsigned wait) {
+    __atomic_store_n(r.sq_tail, r.sq_local_tail, __ATOMIC_RELEASE);
+    int ret = sys_uring_enter(r.fd, r.to_submit, wait, IORING_ENTER_GETEVENTS);
+    if (ret > 0) r.to_submit -= std::min<unsigned>(ret, r.to_submit);
+    return ret;
+}
+
+static bool sq_full(const Uring& r) {
+    return r.sq_local_tail - __atomic_load_n(r.sq_head, __ATOMIC_ACQUIRE) >= r.sq_entries;
+}
+
+// CQ 에 쌓인 CQE 를 모두 lp.cq_backlog 로 옮긴다 (처리는 메인 루프가 다음 바퀴에)
+static void drain_cq(ULoop& lp) {
+    Uring& r = lp.ring;
+    unsigned head = *r.cq_head;
+    unsigned tail = __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+        lp.cq_backlog.push_back(r.cqes[head & r.cq_mask]);
+    __atomic_store_n(r.cq_head, head, __ATOMIC_RELEASE);
+}
+
+// 빈 SQE 하나. SQ 가 가득 차면 쌓인 것을 제출하고, 그래도 안 들어가면 (CQ overflow 로
+// io_uring_enter 가 EBUSY/EAGAIN) CQ 를 비워 커널이 overflow 를 풀게 한 뒤 한 번 더 제출한다.
+// 그래도 자리가 없으면 nullptr: 호출한 쪽이 미뤄 두고 다음 바퀴에 다시 한다
+static io_uring_sqe* get_sqe(ULoop& lp) {
+    Uring& r = lp.ring;
+    if (sq_full(r)) {
+        uring_submit(r, 0);
+        if (sq_full(r)) {
+            drain_cq(lp);
+            uring_submit(r, 0);
+            if (sq_full(r)) {
+                FLOG(FLOG_WARN, "%sSQ full, deferring", lp.tag.c_str());
+                return nullptr;
+            }
+        }
+    }
+    io_uring_sqe* sqe = &r.sqes[r.sq_local_tail & r.sq_mask];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ++r.sq_local_tail;
+    ++r.to_submit;
+    return sqe;
+}
+
+// 버퍼 bid 를 provided buffer ring 에 되돌린다 (tail 공개는 제출 직전에 한 번)
+static void recycle_buf(ULoop& lp, uint16_t bid) {
+    Uring& r = lp.ring;
+    // C++ 에서는 헤더의 빈 구조체(__empty_bufs)가 1바이트를 차지해서 r.br->bufs 가
+    // 8바이트 밀린다. 커널이 보는 배치 그대로 링 시작 주소부터 직접 인덱싱한다.
+    io_uring_buf* b = reinterpret_cast<io_uring_buf*>(r.br) + (r.br_tail & (URING_BUF_COUNT - 1));
+    b->addr = reinterpret_cast<uint64_t>(r.bufs + static_cast<size_t>(bid) * URING_BUF_SIZE);
+    b->len  = URING_BUF_SIZE;
+    b->bid  = bid;
+    ++r.br_tail;
+    --lp.bufs_out;
+}
+
+// 링에 provided buffer 묶음과 sparse registered file 테이블을 등록
+static bool uring_register_resources(ULoop& lp) {
+    Uring& r = lp.ring;
+
+    rlimit rl{};
+    ::getrlimit(RLIMIT_NOFILE, &rl);
+    unsigned nfiles = static_cast<unsigned>(std::min<rlim_t>(rl.rlim_cur, URING_MAX_FILES));
+    io_uring_rsrc_register files{};
+    files.nr    = nfiles;
+    files.flags = IORING_RSRC_REGISTER_SPARSE;
+    if (sys_uring_register(r.fd, IORING_REGISTER_FILES2, &files, sizeof(files)) == -1) {
+        perror("io_uring_register files");
+        return false;
+    }
+
+    r.br_len = URING_BUF_COUNT * sizeof(io_uring_buf);
+    void* br = ::mmap(nullptr, r.br_len, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (br == MAP_FAILED) {
+        perror("mmap buf ring");
+        return false;
+    }
+    r.br = static_cast<io_uring_buf_ring*>(br);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr    = reinterpret_cast<uint64_t>(r.br);
+    reg.ring_entries = URING_BUF_COUNT;
+    reg.bgid         = URING_BGID;
+    if (sys_uring_register(r.fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1) {
+        perror("io_uring_register pbuf ring");
+        return false;
+    }
+
+    r.bufs = new char[static_cast<size_t>(URING_BUF_COUNT) * URING_BUF_SIZE];
+    lp.next_bid.assign(URING_BUF_COUNT, -1);
+    lp.buf_len.assign(URING_BUF_COUNT, 0);
+    lp.bufs_out = URING_BUF_COUNT;
+    for (unsigned bid = 0; bid < URING_BUF_COUNT; ++bid)
+        recycle_buf(lp, static_cast<uint16_t>(bid));
+    __atomic_store_n(&r.br->tail, r.br_tail, __ATOMIC_RELEASE);
+
+    lp.conns.resize(1024);
+    return true;
+}
+
+static void arm_accept(ULoop& lp) {
+    io_uring_sqe* sqe = get_sqe(lp);
+    if (!sqe) {
+        lp.retry_accept = true;
+        return;
+    }
+    lp.accept_armed = true;
+    sqe->opcode      = IORING_OP_ACCEPT;
+    sqe->fd          = lp.listen_fd;
+    sqe->ioprio      = IORING_ACCEPT_MULTISHOT;
+    sqe->file_index  = IORING_FILE_INDEX_ALLOC;   // 빈 registered 슬롯에 바로 설치
+    sqe->user_data   = make_ud(OP_ACCEPT, 0);
+}
+
+static void arm_recv(ULoop& lp, uint32_t slot) {
+    UConn& c = lp.conns[slot];
+    io_uring_sqe* sqe = get_sqe(lp);
+    if (!sqe) {
+        lp.retry.push_back(slot);
+        return;
+    }
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = static_cast<int>(slot);
+    sqe->flags     = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->buf_group = URING_BGID;
+    sqe->user_data = make_ud(OP_RECV, slot, c.gen);
+    c.recv_armed = true;
+}
+
+// target 이 가리키는 요청을 취소한다. SQE 가 없으면 다음 바퀴에 다시
+static void cancel_ud(ULoop& lp, uint64_t target) {
+    io_uring_sqe* sqe = get_sqe(lp);
+    if (!sqe) {
+        lp.retry_cancel.push_back(target);
+        return;
+    }
+    sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+    sqe->addr      = target;
+    sqe->user_data = make_ud(OP_CANCEL, ud_slot(target));
+}
+
+static void cancel_accept(ULoop& lp) {
+    cancel_ud(lp, make_ud(OP_ACCEPT, 0));
+}
+
+static void cancel_recv(ULoop& lp, uint32_t slot) {
+    cancel_ud(lp, make_ud(OP_RECV, slot, lp.conns[slot].gen));
+}
+
+static void close_slot(ULoop& lp, uint32_t slot) {
+    io_uring_sqe* sqe = get_sqe(lp);
+    if (!sqe) {
+        lp.retry_close.push_back(slot);   // 닫힐 때까지 커널이 이 슬롯을 다시 내주지 않는다
+        return;
+    }
+    sqe->opcode     = IORING_OP_CLOSE;
+    sqe->file_index = slot + 1;
+    sqe->user_data  = make_ud(OP_CLOSE, slot);
+}
+
+// FIFO 맨 앞 버퍼의 남은 부분을 보낸다
+static void send_head(ULoop& lp, uint32_t slot) {
+    UConn& c = lp.conns[slot];
+    uint16_t bid = static_cast<uint16_t>(c.head);
+    io_uring_sqe* sqe = get_sqe(lp);
+    if (!sqe) {
+        lp.retry.push_back(slot);
+        return;
+    }
+    sqe->opcode    = IORING_OP_SEND;
+    sqe->fd        = static_cast<int>(slot);
+    sqe->flags     = IOSQE_FIXED_FILE;
+    sqe->addr      = reinterpret_cast<uint64_t>(lp.ring.bufs +
+                     static_cast<size_t>(bid) * URING_BUF_SIZE + c.send_off);
+    sqe->len       = lp.buf_len[bid] - c.send_off;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = make_ud(OP_SEND, slot, c.gen, bid);
+    c.sending = true;
+}
+
+static void uring_close_conn(ULoop& lp, uint32_t slot) {
+    UConn& c = lp.conns[slot];
+    // 떠 있는 send 의 버퍼는 그 CQE 가 돌아올 때 회수한다
+    int32_t bid = c.sending ? lp.next_bid[c.head] : c.head;
+    while (bid != -1) {
+        int32_t next = lp.next_bid[bid];
+        recycle_buf(lp, static_cast<uint16_t>(bid));
+        bid = next;
+    }
+    if (c.recv_armed) cancel_recv(lp, slot);
+    close_slot(lp, slot);
+
+    uint32_t gen = c.gen + 1;   // 이후 도착하는 이 연결의 CQE 는 모두 무시
+    c = UConn{};
+    c.gen = gen;
+
+    --lp.live;
+    if (lp.accept_paused && (!lp.max_conns || lp.live < lp.max_conns)) {
+        lp.accept_paused = false;   // 자리가 났으니 다시 받는다
+        if (!lp.accept_armed) arm_accept(lp);
+    }
+}
+
+static void on_accept(ULoop& lp, const io_uring_cqe* cqe) {
+    if (cqe->res == -ENFILE) {
+        // registered 슬롯이 모두 사용 중: 연결이 닫혀 자리가 날 때까지 accept 중단
+        lp.accept_paused = true;
+    } else if (cqe->res < 0 && cqe->res != -ECANCELED) {
+        FLOG(FLOG_WARN, "%saccept: %s", lp.tag.c_str(), std::strerror(-cqe->res));
+    }
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        lp.accept_armed = false;
+        if (!lp.accept_paused) arm_accept(lp);   // multishot 이 끝났으면 다시 건다
+    }
+    if (cqe->res < 0) return;
+
+    uint32_t slot = static_cast<uint32_t>(cqe->res);
+    if (slot >= lp.conns.size())
+        lp.conns.resize(std::max<size_t>(slot + 1, lp.conns.size() * 2));
+    UConn& c = lp.conns[slot];
+    c.open = true;
+    arm_recv(lp, slot);
+
+    ++lp.live;
+    if (lp.max_conns && lp.live >= lp.max_conns && !lp.accept_paused) {
+        // 상한 도달: multishot accept 를 취소. 새 연결은 커널 backlog 에서 기다린다
+        lp.accept_paused = true;
+        if (lp.accept_armed) cancel_accept(lp);
+    }
+
+    FLOG_EV(EV_CONN, FLOG_INFO, "%sclient slot=%u connected", lp.tag.c_str(), slot);
+}
+
+static void on_recv(ULoop& lp, const io_uring_cqe* cqe) {
+    uint32_t slot = ud_slot(cqe->user_data);
+    bool has_buf  = cqe->flags & IORING_CQE_F_BUFFER;
+    uint16_t bid  = static_cast<uint16_t>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    if (has_buf) ++lp.bufs_out;
+
+    UConn& c = lp.conns[slot];
+    if (!c.open || c.gen != ud_gen(cqe->user_data)) {
+        if (has_buf) recycle_buf(lp, bid);
+        return;
+    }
+    bool more = cqe->flags & IORING_CQE_F_MORE;
+    if (!more) c.recv_armed = false;
+
+    if (cqe->res > 0) {
+        // 받은 버퍼를 그대로 보낼 FIFO 끝에 붙인다
+        lp.buf_len[bid]  = static_cast<uint32_t>(cqe->res);
+        lp.next_bid[bid] = -1;
+        if (c.tail != -1) lp.next_bid[c.tail] = bid;
+        else              c.head = bid;
+        c.tail = bid;
+        c.pending += cqe->res;
+        if (!c.sending) send_head(lp, slot);
+
+        if (c.pending >= lp.hwm && !c.paused) {
+            c.paused = true;
+            if (c.recv_armed) cancel_recv(lp, slot);
+        }
+    } else if (cqe->res == 0) {
+        c.eof = true;
+        if (!c.sending) {
+            FLOG_EV(EV_CLOSE, FLOG_INFO, "%sclient slot=%u closed", lp.tag.c_str(), slot);
+            uring_close_conn(lp, slot);
+        }
+        return;
+    } else if (cqe->res == -ENOBUFS) {
+        // 버퍼가 모두 사용 중: send 가 버퍼를 돌려줄 때 다시 건다
+        lp.starved.push_back(slot);
+        return;
+    } else if (cqe->res != -ECANCELED) {
+        FLOG(FLOG_WARN, "%srecv: %s", lp.tag.c_str(), std::strerror(-cqe->res));
+        uring_close_conn(lp, slot);
+        return;
+    }
+
+    if (!more && !c.recv_armed && !c.paused && !c.eof)
+        arm_recv(lp, slot);
+}
+
+static void on_send(ULoop& lp, const io_uring_cqe* cqe) {
+    uint32_t slot = ud_slot(cqe->user_data);
+    uint16_t bid  = ud_bid(cqe->user_data);
+    UConn& c = lp.conns[slot];
+    if (!c.open || c.gen != ud_gen(cqe->user_data)) {
+        recycle_buf(lp, bid);
+        return;
+    }
+    c.sending = false;
+    if (cqe->res < 0) {
+        FLOG(FLOG_WARN, "%ssend: %s", lp.tag.c_str(), std::strerror(-cqe->res));
+        uring_close_conn(lp, slot);
+        return;
+    }
+
+    c.send_off += cqe->res;
+    c.pending  -= cqe->res;
+    if (c.send_off == lp.buf_len[bid]) {
+        // 버퍼 하나를 다 보냄: FIFO 에서 빼고 링에 돌려준다
+        c.head = lp.next_bid[bid];
+        if (c.head == -1) c.tail = -1;
+        c.send_off = 0;
+        recycle_buf(lp, bid);
+    }
+
+    if (c.head != -1) {
+        send_head(lp, slot);
+    } else if (c.eof) {
+        FLOG_EV(EV_CLOSE, FLOG_INFO, "%sclient slot=%u closed", lp.tag.c_str(), slot);
+        uring_close_conn(lp, slot);
+        return;
+    }
+
+    if (c.paused && c.pending <= lp.hwm / 2) {
+        c.paused = false;
+        if (!c.recv_armed && !c.eof) arm_recv(lp, slot);
+    }
+}
+
+static void dispatch_cqe(ULoop& lp, const io_uring_cqe* cqe) {
+    switch (ud_op(cqe->user_data)) {
+    case OP_ACCEPT: on_accept(lp, cqe); break;
+    case OP_RECV:   on_recv(lp, cqe);   break;
+    case OP_SEND:   on_send(lp, cqe);   break;
+    default:        break;              // close / cancel 결과는 볼 필요 없음
+    }
+}
+
+// SQE 가 없어 미뤄 둔 일을 다시 한다. 그 사이 상태가 바뀌었을 수 있으니 지금 필요한 것만.
+// 또 실패하면 각 함수가 목록에 다시 넣는다
+static void retry_deferred(ULoop& lp) {
+    if (lp.retry_accept) {
+        lp.retry_accept = false;
+        if (lp.accept_paused && lp.accept_armed) cancel_accept(lp);
+        else if (!lp.accept_paused && !lp.accept_armed) arm_accept(lp);
+    }
+    std::vector<uint64_t> cancels;
+    cancels.swap(lp.retry_cancel);
+    for (uint64_t ud : cancels) cancel_ud(lp, ud);
+    std::vector<uint32_t> closes;
+    closes.swap(lp.retry_close);
+    for (uint32_t slot : closes) close_slot(lp, slot);
+    std::vector<uint32_t> slots;
+    slots.swap(lp.retry);
+    for (uint32_t slot : slots) {
+        UConn& c = lp.conns[slot];
+        if (!c.open) continue;
+        if (!c.sending && c.head != -1) send_head(lp, slot);
+        if (!c.recv_armed && !c.paused && !c.eof) arm_recv(lp, slot);
+    }
+}
+
+// io_uring 엔진 reactor. 커널이 필요한 기능을 지원하지 않으면 ENGINE_UNSUPPORTED
+static int run_uring_reactor(int id, const Options& opt) {
+    ULoop lp;
+    lp.hwm       = opt.hwm;
+    lp.max_conns = per_reactor_cap(opt);
+    lp.tag = "[C++/uring#" + std::to_string(id) + "] ";
+
+    if (!uring_init(lp.ring)) return ENGINE_UNSUPPORTED;
+    if (!uring_register_resources(lp)) {
+        uring_destroy(lp.ring);
+        return ENGINE_UNSUPPORTED;
+    }
+
+    lp.listen_fd = create_listen_socket();
+    if (lp.listen_fd == -1) {
+        uring_destroy(lp.ring);
+        return 1;
+    }
+
+    FLOG(FLOG_INFO, "%sListening on port %d", lp.tag.c_str(), PORT);
+
+    arm_accept(lp);
+    Uring& r = lp.ring;
+
+    std::vector<io_uring_cqe> backlog;
+    while (true) {
+        __atomic_store_n(&r.br->tail, r.br_tail, __ATOMIC_RELEASE);
+        // 제출 + 최소 1개 완료 대기를 시스템 콜 한 번에. 미뤄 둔 일이 있으면 기다리지 않는다
+        bool deferred = !lp.cq_backlog.empty() || !lp.retry.empty() || !lp.retry_cancel.empty() ||
+                        !lp.retry_close.empty() || lp.retry_accept;
+        int ret = uring_submit(r, deferred ? 0 : 1);
+        if (ret == -1 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            perror("io_uring_enter");
+            break;
+        }
+
+        // get_sqe 가 먼저 꺼내 둔 것부터. 처리 중에 또 쌓이면 다음 바퀴에
+        backlog.swap(lp.cq_backlog);
+        for (const io_uring_cqe& cqe : backlog) dispatch_cqe(lp, &cqe);
+        backlog.clear();
+
+        // 핸들러 안의 get_sqe 가 CQ 를 비울 수 있으므로 head 는 CQE 마다 다시 읽고,
+        // 처리 전에 복사해서 먼저 넘긴다
+        while (true) {
+            unsigned head = *r.cq_head;
+            if (head == __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE)) break;
+            io_uring_cqe cqe = r.cqes[head & r.cq_mask];
+            __atomic_store_n(r.cq_head, head + 1, __ATOMIC_RELEASE);
+            dispatch_cqe(lp, &cqe);
+        }
+
+        retry_deferred(lp);
+
+        // 버퍼가 돌아왔으면 굶고 있던 연결의 recv 를 다시 건다
+        while (!lp.starved.empty() && lp.bufs_out < URING_BUF_COUNT) {
+            uint32_t slot = lp.starved.back();
+            lp.starved.pop_back();
+            UConn& c = lp.conns[slot];
+            if (c.open && !c.recv_armed && !c.paused && !c.eof)
+                arm_recv(lp, slot);
+        }
+    }
+
+    ::close(lp.listen_fd);
+    uring_destroy(lp.ring);
+    return 0;
+}
+
+// reactor 하나 = 스레드 하나 = epoll 또는 io_uring 인스턴스 하나.
+// reactor 끼리 공유하는 상태가 없으므로 락도 없다.
+static int run_reactor(int id, const Options& opt) {
+    if (opt.pin) pin_to_cpu(id);
+
+    if (opt.engine == Engine::Uring) {
+        int rc = run_uring_reactor(id, opt);
+        if (rc != ENGINE_UNSUPPORTED) return rc;
+        FLOG(FLOG_WARN, "[C++/uring#%d] io_uring unavailable, falling back to epoll", id);
+    }
+    return run_epoll_reactor(id, opt);
+}
+
+// 타임아웃 옵션(초) → ms. 숫자만 받고, 타이머 휠이 표현하는 범위(약 46시간)를 넘으면 false
+static bool parse_timeout(const char* s, uint32_t& ms) {
+    if (*s < '0' || *s > '9') return false;      // strtoul 은 "-1" 도 받아서 wrap 시킨다
+    char* end;
+    errno = 0;
+    unsigned long sec = std::strtoul(s, &end, 10);
+    if (errno || *end || sec > uint64_t{TW_MAX_TICKS} * TIMER_TICK_MS / 1000) return false;
+    ms = static_cast<uint32_t>(sec) * 1000;
+    return true;
+}
+
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [--engine=epoll|uring] [--threads N] [--pin] [--hwm BYTES]"
+                 " [--accept-budget N] [--max-conns N]\n"
+                 "          [--idle-timeout SEC] [--handshake-timeout SEC] [--stall-timeout SEC]"
+                 " [--read-budget BYTES]\n";
+}
+
+// "--name=value" 와 "--name value" 두 형태 모두 허용
+static bool take_value(int argc, char* argv[], int& i,
+                       const char* name, const char*& value) {
+    size_t len = std::strlen(name);
+    if (std::strncmp(argv[i], name, len) != 0) return false;
+    if (argv[i][len] == '=') {
+        value = argv[i] + len + 1;
+        return true;
+    }
+    if (argv[i][len] == '\0' && i + 1 < argc) {
+        value = argv[++i];
+        return true;
+    }
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* val = nullptr;
+        if (take_value(argc, argv, i, "--engine", val)) {
+            if (std::strcmp(val, "epoll") == 0)      opt.engine = Engine::Epoll;
+            else if (std::strcmp(val, "uring") == 0) opt.engine = Engine::Uring;
+            else {
+                usage(argv[0]);
+                return 1;
             }
+        } else if (take_value(argc, argv, i, "--threads", val)) {
+            opt.threads = std::atoi(val);
+        } else if (take_value(argc, argv, i, "--accept-budget", val)) {
+            opt.accept_budget = std::atoi(val);
+        } else if (take_value(argc, argv, i, "--max-conns", val)) {
+            opt.max_conns = std::strtoull(val, nullptr, 10);
+        } else if (take_value(argc, argv, i, "--idle-timeout", val)) {
+            if (!parse_timeout(val, opt.idle_ms)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (take_value(argc, argv, i, "--handshake-timeout", val)) {
+            if (!parse_timeout(val, opt.handshake_ms)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (take_value(argc, argv, i, "--stall-timeout", val)) {
+            if (!parse_timeout(val, opt.stall_ms)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (take_value(argc, argv, i, "--read-budget", val)) {
+            opt.read_budget = std::strtoull(val, nullptr, 10);
+        } else if (take_value(argc, argv, i, "--hwm", val)) {
+            opt.hwm = std::strtoull(val, nullptr, 10);
+        } else if (std::strcmp(argv[i], "--pin") == 0) {
+            opt.pin = true;
+        } else {
+            usage(argv[0]);
+            return 1;
         }
     }
+    if (opt.threads < 1 || opt.hwm < BUF_SIZE || opt.hwm > MAX_HWM || opt.accept_budget < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    ::signal(SIGPIPE, SIG_IGN);   // 출력 큐는 MSG_NOSIGNAL 로 보내지만, 혹시 남은 쓰기 경로가 있어도 프로세스가 죽지 않게
+    fastlog_init(log_events, sizeof(log_events) / sizeof(log_events[0])); // 로그는 flusher 스레드가 모아서 출력 (FASTLOG_LEVEL/FASTLOG_SAMPLE)
+
+    // 스레드 1개면 기존처럼 main 스레드에서 바로 루프를 돈다
+    if (opt.threads == 1)
+        return run_reactor(0, opt);
+
+    std::vector<int> results(opt.threads, 0);
+    std::vector<std::thread> reactors;
+    reactors.reserve(opt.threads);
+    for (int id = 0; id < opt.threads; ++id)
+        reactors.emplace_back([&results, &opt, id] { results[id] = run_reactor(id, opt); });
+
+    for (auto& t : reactors) t.join();
 
-    ::close(epfd);
-    ::close(listen_fd);
+    for (int r : results)
+        if (r != 0) return r;
     return 0;
 }
@@ -5,16 +5,108 @@
 #include <string.h>              // memset, memcpy 등 문자열/메모리 관련 함수 선언
 #include <unistd.h>              // close, read, write, fcntl 등 POSIX 함수 선언
 #include <errno.h>               // errno 전역 변수 및 오류 코드 상수 정의
+#include <signal.h>              // signal(SIGPIPE, SIG_IGN): splice 경로용
 #include <fcntl.h>               // fcntl, O_NONBLOCK 등 파일 제어 및 플래그 상수 정의
 #include <sys/types.h>           // 시스템 자료형 정의 (size_t, ssize_t, socklen_t 등)
 #include <sys/socket.h>          // socket, bind, listen, accept, setsockopt 등 소켓 함수 선언
 #include <sys/epoll.h>           // epoll_create1, epoll_ctl, epoll_wait 등 epoll 관련 함수/구조체 선언
+#include <sys/uio.h>             // writev, struct iovec (여러 버퍼를 한 번의 시스템 콜로 쓰기)
+#include <sys/resource.h>        // getrlimit(RLIMIT_NOFILE): 연결 테이블 크기 결정
+#include <getopt.h>              // getopt_long: --hwm 같은 긴 옵션 파싱
 #include <netinet/in.h>          // sockaddr_in 구조체, AF_INET, INADDR_ANY 등 인터넷 주소 관련 상수/구조체
 #include <arpa/inet.h>           // htons, htonl, ntohs, ntohl 등 바이트 순서 변환 함수
+#include "fastlog.h"             // 비동기 로거: 접속/종료 로그를 스레드 링에 넣고 flusher 가 출력
+#include "timer_wheel.h"         // 계층형 타이머 휠: 유휴/핸드셰이크/쓰기 정체 타임아웃
 
 #define PORT       5000          // 서버가 바인드하고 listen할 TCP 포트 번호
 #define MAX_EVENTS 128           // epoll_wait에서 한 번에 처리할 수 있는 최대 이벤트 수
 #define BUF_SIZE   1024          // 클라이언트로부터 읽고 쓸 때 사용할 버퍼 크기
+#define MAX_IOV    64            // sendmsg 한 번에 넘길 최대 청크 수
+#define DEFAULT_HWM (256 * 1024) // 출력 큐 high-water mark 기본값 (바이트)
+
+#define CHUNKS_PER_SLAB 256      // 청크 풀이 비었을 때 한 번에 할당하는 청크 수
+#define SPLICE_LEN (64 * 1024)   // splice 한 번에 옮길 최대 바이트
+#define PIPE_POOL_MAX 1024       // 풀에 남겨 둘 유휴 파이프 최대 개수 (넘치면 닫음)
+#define DEFAULT_ACCEPT_BUDGET 64 // 루프 한 바퀴에 accept 할 최대 연결 수 기본값
+#define TIMER_TICK_MS 10         // 타이머 휠 한 틱 (타임아웃 정밀도)
+#define DEFAULT_IDLE_SEC      300 // 읽기/쓰기 진전이 없으면 닫기까지 (초)
+#define DEFAULT_HANDSHAKE_SEC 30  // 접속 후 첫 데이터가 올 때까지 (초)
+#define DEFAULT_STALL_SEC     30  // 상대가 읽지 않아 송신이 막힌 채로 버틸 시간 (초)
+#define DEFAULT_READ_BUDGET (64 * 1024) // 한 바퀴에 연결 하나에서 읽을 최대 바이트 (0 이면 무제한)
+
+enum { EV_CONN, EV_CLOSE, EV_SHED, EV_TIMEOUT }; // 로그 샘플링 단위 (FASTLOG_SAMPLE=conn=100,...)
+static const char *const log_events[] = { "conn", "close", "shed", "timeout" };
+
+// --splice 모드에서 소켓→파이프→소켓으로 데이터를 옮길 때 쓰는 파이프 한 쌍.
+// 데이터가 파이프에 머무는 동안만 연결에 붙어 있고, 비면 풀로 돌아간다.
+struct pipe_pair {
+    int rd, wr;                  // pipe2 로 만든 읽기/쓰기 끝
+    struct pipe_pair *next;      // 풀(free list)에서 다음 파이프
+};
+
+// 에코 데이터 조각 (출력 큐의 원소). 청크 풀에서만 꺼내고 돌려준다.
+struct chunk {
+    struct chunk *next;          // 큐(또는 free list)에서 다음 청크
+    uint32_t off;                // 여기까지는 이미 보냄
+    uint32_t len;                // data 에 채워진 길이
+    char data[BUF_SIZE];
+};
+
+// 연결 하나의 상태. fd 번호로 인덱싱하는 평평한 배열(conns)에 들어 있고,
+// epoll 에는 이 구조체의 주소를 data.ptr 로 등록해서 이벤트가 오면 바로 찾아온다.
+// 버퍼(청크, 파이프)는 데이터가 밀려 있을 때만 붙으므로 유휴 연결은 이 구조체(캐시 라인 하나, 아래 assert)만 차지한다.
+//  - 큐가 비어 있지 않을 때만 EPOLLOUT 을 켠다 (비어 있는데 켜 두면 epoll_wait 가 계속 깨어남)
+//  - pending 이 high-water mark 를 넘으면 EPOLLIN 을 꺼서 느린 클라이언트의 메모리 사용을 제한
+//  - hwm/2 이하로 줄어들면 다시 읽기 시작 (히스테리시스)
+struct conn {
+    struct chunk *head, *tail;   // 출력 큐: 보낼 순서대로 연결된 청크 목록
+    struct pipe_pair *pipe;      // --splice: 아직 못 보낸 데이터가 들어 있는 파이프 (청크보다 먼저 보냄)
+    size_t pending;              // 큐(파이프 + 청크)에 남은 바이트 수
+    int fd;                      // 소켓
+    uint32_t events;             // 지금 epoll 에 등록된 이벤트 (바뀔 때만 epoll_ctl 호출)
+    uint32_t piped;              // pending 중 파이프에 들어 있는 바이트 수
+    uint32_t last_active;        // 마지막으로 읽기/쓰기가 진전된 타이머 틱
+    uint8_t blocked;             // 마지막 sendmsg/splice 가 EAGAIN: EPOLLOUT 이 올 때까지 쓰기 시도 안 함
+    uint8_t paused;              // high-water mark 초과로 읽기 중단 상태
+    uint8_t pipe_full;           // 파이프가 가득 차서 읽기 중단: EPOLLOUT 으로 비워지면 재개
+    uint8_t eof;                 // 상대가 FIN 을 보냄: 남은 데이터만 보내고 닫는다
+    uint8_t nosplice;            // 이 소켓은 splice 를 못 씀: 복사 경로로만 처리
+    uint8_t active;              // 첫 데이터를 받음 (그 전에는 핸드셰이크 타임아웃 적용)
+    uint8_t ready;               // 읽기 예산을 다 써서 ready 목록에 올라 있음 (소켓에 데이터가 남음)
+};
+_Static_assert(sizeof(struct conn) <= 64, "struct conn 은 캐시 라인 하나에 들어가야 한다");
+
+static int epfd = -1;                   // epoll 인스턴스
+static int listen_fd = -1;              // 리슨 소켓
+static size_t hwm = DEFAULT_HWM;        // --hwm 옵션 값
+static struct conn *conns;              // fd 로 인덱싱하는 연결 테이블 (RLIMIT_NOFILE 칸)
+static int nconns;                      // conns 배열 크기
+static struct chunk *free_chunks;       // 청크 풀의 free list
+static int use_splice;                  // --splice 옵션: 소켓→파이프→소켓 zero-copy 에코
+static struct pipe_pair *free_pipes;    // 파이프 풀의 free list
+static int nfree_pipes;                 // 풀에 있는 유휴 파이프 수
+
+// 연결 수락(admission) 상태
+static int accept_budget = DEFAULT_ACCEPT_BUDGET; // --accept-budget: 루프 한 바퀴에 받을 최대 연결 수
+static int max_conns;                   // --max-conns: 동시 연결 상한 (0 이면 fd 한도까지)
+static int nlive;                       // 지금 열려 있는 클라이언트 연결 수
+static int accept_paused;               // 상한 도달/fd 고갈로 리슨 소켓 감시를 멈춘 상태
+static int reserve_fd = -1;             // fd 가 바닥났을 때 연결을 받아서 끊어 주기 위한 예비 fd
+
+// 타임아웃 (ms, 0 이면 끔). 연결마다 타이머 하나를 두고 상태에 맞는 값으로 건다
+static struct timer_wheel wheel;
+static struct tw_node *timers;          // fd 로 인덱싱하는 타이머 노드 (conns 와 같은 크기, 구조체를 64바이트 안에 두려고 분리)
+static uint32_t idle_ms      = DEFAULT_IDLE_SEC * 1000;
+static uint32_t handshake_ms = DEFAULT_HANDSHAKE_SEC * 1000;
+static uint32_t stall_ms     = DEFAULT_STALL_SEC * 1000;
+
+// 공정한 읽기 스케줄링. 대량으로 보내는 연결이 한 번의 EPOLLIN 에서 소켓을 끝까지 비우면
+// 같은 배치의 작은 요청들이 그만큼 기다린다. 그래서 연결마다 한 바퀴에 read_budget 바이트까지만 읽고,
+// 데이터가 남은 연결은 ready 목록에 올려 배치가 끝난 뒤 돌아가며(round-robin) 한 몫씩 더 읽는다.
+// 닫힌 연결은 목록에서 빼지 않는다. close_conn 이 ready 플래그를 지우므로 차례가 오면 건너뛴다.
+static size_t read_budget = DEFAULT_READ_BUDGET; // --read-budget 옵션 값
+static struct conn **ready;             // ready 목록 (배열, 앞에서부터 처리)
+static int nready, ready_cap;
 
 // 소켓을 논블로킹 모드로 변경하는 유틸리티 함수
 static int make_socket_nonblocking(int fd) { // static 쓰는 이유: 이 함수가 정의된 파일 내에서만 사용되도록 제한
@@ -42,8 +134,568 @@ O_NONBLOCK:
   - 읽기/쓰기 호출이 즉시 완료될 수 없을 때, 블록(대기)하지 않고 -1과 errno=EAGAIN/EWOULDBLOCK을 반환하도록 함
 */
 
-int main(void) {
-    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);   // 서버 리슨용 TCP 소켓 생성
+// 청크 풀: 비었을 때만 CHUNKS_PER_SLAB 개를 한 번에 할당하고, 다 쓴 청크는 free 하지 않고 되돌린다.
+// 정상 상태의 읽기/쓰기 경로에서는 malloc/free 가 일어나지 않는다.
+static struct chunk *alloc_chunk(void) {
+    if (!free_chunks) {
+        struct chunk *slab = malloc(CHUNKS_PER_SLAB * sizeof(*slab)); // 슬랩은 프로세스 끝까지 유지
+        if (!slab) return NULL;
+        for (int i = 0; i < CHUNKS_PER_SLAB; i++) {
+            slab[i].next = free_chunks;
+            free_chunks = &slab[i];
+        }
+    }
+    struct chunk *c = free_chunks;              // free list 맨 앞에서 하나 꺼냄
+    free_chunks = c->next;
+    c->next = NULL;
+    c->off = c->len = 0;
+    return c;
+}
+
+static void free_chunk(struct chunk *c) {
+    c->next = free_chunks;                      // free list 맨 앞에 되돌림
+    free_chunks = c;
+}
+
+// fd 로 인덱싱하는 연결 테이블을 RLIMIT_NOFILE 크기로 한 번에 잡는다.
+// 한 번 잡으면 움직이지 않으므로 원소 주소를 epoll data.ptr 에 넣어도 안전하다.
+// calloc 한 큰 영역은 실제로 건드린 페이지만 메모리를 차지한다.
+static int init_conn_table(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == -1) {
+        perror("getrlimit");
+        return -1;
+    }
+    nconns = rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur > (1 << 24) ? (1 << 24) : (int)rl.rlim_cur;
+    conns = calloc(nconns, sizeof(*conns));
+    timers = calloc(nconns, sizeof(*timers));
+    if (!conns || !timers) {
+        perror("calloc");
+        return -1;
+    }
+    return 0;
+}
+
+// 파이프 풀: 연결마다 pipe2 를 부르지 않도록 다 쓴(빈) 파이프를 모아 두었다가 다시 준다
+static struct pipe_pair *acquire_pipe(void) {
+    struct pipe_pair *p = free_pipes;
+    if (p) {                                    // 풀에 있으면 그대로 재사용
+        free_pipes = p->next;
+        nfree_pipes--;
+        return p;
+    }
+
+    if (!(p = malloc(sizeof(*p))))              // 풀이 비었을 때만 새로 만든다
+        return NULL;
+    int fds[2];
+    if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) == -1) { // EMFILE 등: 호출한 쪽이 복사 경로로 대신 처리
+        free(p);
+        return NULL;
+    }
+    p->rd = fds[0];
+    p->wr = fds[1];
+    return p;
+}
+
+// 빈 파이프만 풀에 돌려준다. 데이터가 남은 파이프(연결이 중간에 끊김)나 풀이 꽉 찬 경우는 닫는다
+static void release_pipe(struct pipe_pair *p, int dirty) {
+    if (dirty || nfree_pipes >= PIPE_POOL_MAX) {
+        close(p->rd);
+        close(p->wr);
+        free(p);
+        return;
+    }
+    p->next = free_pipes;
+    free_pipes = p;
+    nfree_pipes++;
+}
+
+// 리슨 소켓 감시를 켜고 끈다. 멈춘 동안 새 연결은 커널 backlog 에서 기다린다.
+// (level-triggered 라서 받지 않고 감시만 계속하면 epoll_wait 가 헛돈다)
+static void set_accepting(int on) {
+    struct epoll_event ev;
+    ev.events   = on ? EPOLLIN : 0;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, listen_fd, &ev) == -1) {
+        perror("epoll_ctl listen_fd");
+        return;
+    }
+    accept_paused = !on;
+}
+
+static void resume_accept(void) {
+    if (!accept_paused) return;
+    if (max_conns && nlive >= max_conns) return;
+    if (reserve_fd == -1)                       // fd 고갈로 멈췄던 경우: 예비 fd 부터 다시 확보
+        reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    set_accepting(1);
+}
+
+// 연결 종료: 큐를 풀에 돌려주고 epoll 에서 제거한 뒤 소켓을 닫는다
+static void close_conn(struct conn *c) {
+    if (c->pipe)
+        release_pipe(c->pipe, c->piped != 0);
+    while (c->head) {
+        struct chunk *ch = c->head;
+        c->head = ch->next;
+        free_chunk(ch);
+    }
+    tw_del(&wheel, &timers[c->fd]);
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL); // 닫기 전에 제거 (닫은 뒤에는 EBADF)
+    close(c->fd);
+    memset(c, 0, sizeof(*c));                   // 테이블 칸 비우기
+    nlive--;
+    resume_accept();                            // 자리가 났으면 다시 연결을 받는다
+}
+
+// 큐를 보낼 수 있는 만큼 보낸다. 파이프에 든 데이터가 먼저 들어온 것이므로 splice 로 먼저 비우고,
+// 그다음 청크들을 sendmsg 로 보낸다. 소켓 에러면 -1
+static int flush_queue(struct conn *c) {
+    while (c->piped) {
+        ssize_t w = splice(c->pipe->rd, NULL, c->fd, NULL, c->piped,
+                           SPLICE_F_MOVE | SPLICE_F_NONBLOCK); // 파이프→소켓: 사용자 공간 복사 없음
+        if (w == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                c->blocked = 1;                  // 소켓 송신 버퍼가 가득 참: EPOLLOUT 을 기다린다
+                return 0;
+            }
+            perror("splice out");            // 끊긴 소켓이면 EPIPE (SIGPIPE 는 main 에서 무시)
+            return -1;
+        }
+        c->piped -= w;
+        c->pending -= w;
+    }
+    if (c->pipe) {                               // 파이프가 비었으면 풀에 돌려준다
+        release_pipe(c->pipe, 0);
+        c->pipe = NULL;
+    }
+
+    while (c->head) {
+        struct iovec iov[MAX_IOV];
+        int cnt = 0;
+        for (struct chunk *ch = c->head; ch && cnt < MAX_IOV; ch = ch->next, cnt++) {
+            iov[cnt].iov_base = ch->data + ch->off; // 아직 안 보낸 부분부터
+            iov[cnt].iov_len  = ch->len - ch->off;
+        }
+
+        // 여러 청크를 시스템 콜 한 번에 (writev 와 같은 gather 쓰기). 상대가 끊었으면
+        // SIGPIPE 로 프로세스가 죽지 않고 EPIPE 로 받도록 MSG_NOSIGNAL
+        struct msghdr mh = { .msg_iov = iov, .msg_iovlen = cnt };
+        ssize_t w = sendmsg(c->fd, &mh, MSG_NOSIGNAL);
+        if (w == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                c->blocked = 1;                  // 소켓 송신 버퍼가 가득 참: EPOLLOUT 을 기다린다
+                return 0;
+            }
+            perror("sendmsg");
+            return -1;
+        }
+
+        // short write: 보낸 만큼만 큐 앞에서 제거
+        c->pending -= w;
+        while (w > 0) {
+            struct chunk *ch = c->head;
+            size_t left = ch->len - ch->off;
+            if ((size_t)w < left) {              // 이 청크는 일부만 나감
+                ch->off += w;
+                break;
+            }
+            w -= left;                           // 이 청크는 전부 나감
+            c->head = ch->next;
+            free_chunk(ch);
+        }
+        if (!c->head) c->tail = NULL;
+    }
+    return 0;
+}
+
+// 지금 상태에 적용할 타임아웃: 송신이 막혀 있으면 쓰기 정체, 첫 데이터 전이면 핸드셰이크, 아니면 유휴
+static uint32_t conn_timeout_ms(const struct conn *c) {
+    if (c->blocked) return stall_ms;
+    return c->active ? idle_ms : handshake_ms;
+}
+
+// 연결 타이머를 last_active + 타임아웃에 건다. 이미 더 이른 만료가 걸려 있으면 그대로 둔다.
+// 읽기/쓰기마다 타이머를 옮기지 않고 last_active 만 갱신하고, 만료됐을 때 다시 계산한다.
+static void arm_timer(struct conn *c) {
+    uint32_t ms = conn_timeout_ms(c);
+    struct tw_node *t = &timers[c->fd];
+    if (!ms) {                                   // 이 상태에는 타임아웃 없음
+        tw_del(&wheel, t);
+        return;
+    }
+    uint32_t deadline = c->last_active + tw_ms_to_ticks(&wheel, ms);
+    if (!tw_armed(t) || (int32_t)(deadline - t->expires) < 0)
+        tw_add_at(&wheel, t, deadline);
+}
+
+// 만료된 타이머 처리: 그사이 활동이 있었으면 남은 시간만큼 다시 걸고, 아니면 연결을 닫는다
+static void expire_timers(void) {
+    struct tw_node *t;
+    while ((t = tw_pop(&wheel)) != NULL) {
+        struct conn *c = &conns[t - timers];     // 타이머 칸 번호 = fd
+        uint32_t ms = conn_timeout_ms(c);
+        if (!ms)
+            continue;
+        uint32_t deadline = c->last_active + tw_ms_to_ticks(&wheel, ms);
+        if ((int32_t)(deadline - wheel.now) > 0) {
+            tw_add_at(&wheel, t, deadline);
+            continue;
+        }
+        FLOG_EV(EV_TIMEOUT, FLOG_INFO, "[C/epoll] client fd=%d %s timeout", c->fd,
+                c->blocked ? "write-stall" : c->active ? "idle" : "handshake");
+        close_conn(c);
+    }
+}
+
+// 큐 상태에 맞게 epoll 관심 이벤트를 갱신 (바뀔 때만 epoll_ctl 호출)
+static int update_events(struct conn *c) {
+    if (c->paused && c->pending <= hwm / 2)
+        c->paused = 0;                           // 절반 이하로 줄었으면 읽기 재개
+
+    uint32_t want = 0;
+    if (!c->eof && !c->paused && !c->pipe_full) want |= EPOLLIN;
+    if (c->pending)            want |= EPOLLOUT; // 보낼 데이터가 있을 때만
+    if (want == c->events) return 0;
+
+    struct epoll_event ev;
+    ev.events   = want;
+    ev.data.ptr = c;
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev) == -1) {
+        perror("epoll_ctl mod");
+        return -1;
+    }
+    c->events = want;
+    return 0;
+}
+
+// 읽기 예산을 다 썼지만 소켓에 데이터가 남았을 수 있는 연결을 ready 목록 끝에 올린다.
+// 목록을 못 늘려도 괜찮다: level-triggered 라서 다음 epoll_wait 가 다시 EPOLLIN 을 준다
+static void mark_ready(struct conn *c) {
+    if (c->ready) return;
+    if (nready == ready_cap) {
+        int cap = ready_cap ? ready_cap * 2 : 256;
+        struct conn **p = realloc(ready, cap * sizeof(*p));
+        if (!p) return;
+        ready = p;
+        ready_cap = cap;
+    }
+    ready[nready++] = c;
+    c->ready = 1;
+}
+
+// --splice 모드의 EPOLLIN: 소켓→파이프로 옮기고 곧바로 파이프→소켓으로 에코한다.
+// 데이터가 사용자 공간을 거치지 않는다.
+// 반환값: 1 처리 완료, 0 splice 를 못 써서 복사 경로로 대신 처리해야 함, -1 연결이 닫힘
+static int splice_in(struct conn *c, size_t *got) {
+    while (!c->eof) {
+        if (c->pending >= hwm) {                 // 큐가 너무 길면 더 읽지 않음 (backpressure)
+            c->paused = 1;
+            break;
+        }
+        if (!c->pipe && !(c->pipe = acquire_pipe()))
+            return 0;                            // 파이프를 못 얻음 (fd 부족 등): 이번에는 복사 경로로
+
+        ssize_t n = splice(c->fd, NULL, c->pipe->wr, NULL, SPLICE_LEN,
+                           SPLICE_F_MOVE | SPLICE_F_NONBLOCK); // 소켓→파이프
+        if (n == 0) {                            // 클라이언트가 FIN 을 보냄
+            c->eof = 1;
+            break;
+        }
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // 소켓이 비었거나 파이프가 가득 참. 보내지 못하고 밀려 있으면(blocked) 파이프가 찬 것으로 보고
+                // EPOLLOUT 으로 비워질 때까지 읽기를 멈춘다 (안 그러면 level-triggered EPOLLIN 이 계속 깨움)
+                if (c->blocked && c->piped)
+                    c->pipe_full = 1;
+                break;
+            }
+            if (errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP) {
+                c->nosplice = 1;                 // 이 소켓은 splice 불가: 앞으로 복사 경로만 사용
+                if (!c->piped) {
+                    release_pipe(c->pipe, 0);
+                    c->pipe = NULL;
+                }
+                return 0;
+            }
+            perror("splice in");
+            close_conn(c);
+            return -1;
+        }
+
+        c->piped += n;
+        c->pending += n;
+        if (!c->blocked && flush_queue(c) == -1) { // 송신 버퍼에 자리가 있으면 바로 에코
+            close_conn(c);
+            return -1;
+        }
+        *got += n;
+        if (read_budget && *got >= read_budget) { // 이번 몫은 끝: 나머지는 ready 목록에서 차례를 기다림
+            mark_ready(c);
+            break;
+        }
+    }
+    return 1;
+}
+
+// EPOLLIN: 읽은 데이터를 큐 끝에 붙이고 바로 보내 본다. 연결이 닫혔으면 -1
+static int handle_read(struct conn *c) {
+    size_t got = 0;                              // 이번 호출에서 읽은 바이트 (read_budget 과 비교)
+    c->last_active = wheel.now;                  // 타이머는 옮기지 않는다 (만료 때 다시 계산)
+    c->active = 1;
+    // 청크 큐가 비어 있을 때만 splice 를 쓴다 (청크에 먼저 들어온 데이터보다 앞서 나가면 안 되므로)
+    if (use_splice && !c->nosplice && !c->head) {
+        int r = splice_in(c, &got);
+        if (r == -1) return -1;
+        if (r == 1) goto done;
+    }
+
+    while (!c->eof) {
+        if (c->pending >= hwm) {                 // 큐가 너무 길면 더 읽지 않음 (backpressure)
+            c->paused = 1;
+            break;
+        }
+
+        // 마지막 청크에 빈 자리가 있으면 거기에 이어서 읽는다
+        struct chunk *ch = c->tail;
+        int fresh = !ch || ch->len == BUF_SIZE;
+        if (fresh && !(ch = alloc_chunk())) {
+            perror("malloc");
+            close_conn(c);
+            return -1;
+        }
+
+        ssize_t cnt = read(c->fd, ch->data + ch->len, BUF_SIZE - ch->len);
+        if (cnt <= 0) {
+            if (fresh) free_chunk(ch);
+            if (cnt == 0) {                      // 클라이언트가 FIN 을 보냄
+                c->eof = 1;
+                break;
+            }
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;                           // 지금은 더 읽을 데이터 없음
+            perror("read");
+            close_conn(c);
+            return -1;
+        }
+
+        if (fresh) {                             // 새 청크를 큐 끝에 연결
+            if (c->tail) c->tail->next = ch;
+            else c->head = ch;
+            c->tail = ch;
+        }
+        ch->len += cnt;
+        c->pending += cnt;
+
+        if (!c->blocked && flush_queue(c) == -1) { // 송신 버퍼에 자리가 있으면 바로 에코
+            close_conn(c);
+            return -1;
+        }
+        got += cnt;
+        if (read_budget && got >= read_budget) { // 이번 몫은 끝: 나머지는 ready 목록에서 차례를 기다림
+            mark_ready(c);
+            break;
+        }
+    }
+
+done:
+    if (c->eof && c->pending == 0) {             // 남은 데이터도 다 보냈으면 종료
+        FLOG_EV(EV_CLOSE, FLOG_INFO, "[C/epoll] client fd=%d closed", c->fd);
+        close_conn(c);
+        return -1;
+    }
+    arm_timer(c);                                // 송신이 막혔으면 쓰기 정체 타임아웃으로 당긴다
+    if (update_events(c) == -1) {
+        close_conn(c);
+        return -1;
+    }
+    return 0;
+}
+
+// EPOLLOUT: 송신 버퍼에 자리가 생겼으니 남은 큐를 보낸다. 연결이 닫혔으면 -1
+static int handle_write(struct conn *c) {
+    c->last_active = wheel.now;                  // 상대가 읽어 가서 자리가 생김 = 진전
+    c->blocked = 0;
+    c->pipe_full = 0;                            // 파이프가 비워지기 시작하면 다시 읽어도 된다
+    if (flush_queue(c) == -1) {
+        close_conn(c);
+        return -1;
+    }
+    if (c->eof && c->pending == 0) {
+        FLOG_EV(EV_CLOSE, FLOG_INFO, "[C/epoll] client fd=%d closed", c->fd);
+        close_conn(c);
+        return -1;
+    }
+    arm_timer(c);
+    if (update_events(c) == -1) {
+        close_conn(c);
+        return -1;
+    }
+    return 0;
+}
+
+// 리슨 소켓 EPOLLIN: 대기 중인 연결을 최대 accept_budget 개까지 받는다.
+// 남은 연결은 다음 바퀴에 받으므로, 재접속 폭주 중에도 기존 클라이언트의 이벤트가 밀리지 않는다.
+static void handle_accept(void) {
+    for (int budget = accept_budget; budget > 0; budget--) {
+        if (max_conns && nlive >= max_conns) {  // 동시 연결 상한 도달: 자리가 날 때까지 accept 중단
+            set_accepting(0);
+            return;
+        }
+
+        struct sockaddr_in caddr;               // 클라이언트 주소 정보
+        socklen_t clen = sizeof(caddr);         // 주소 길이
+        // accept4: 논블로킹/close-on-exec 를 accept 와 같은 시스템 콜에서 설정 (fcntl 2번 절약)
+        int cfd = accept4(listen_fd, (struct sockaddr*)&caddr, &clen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (cfd == -1) {                        // accept 실패
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return;                         // 논블로킹: 더 이상 대기 중인 연결 없음
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;                       // 대기 중에 끊긴 연결 등: 다음 연결 시도
+            if (errno == EMFILE || errno == ENFILE) {
+                // fd 고갈: 그냥 두면 리슨 소켓이 계속 readable 이라 루프가 헛돈다.
+                // 예비 fd 를 잠깐 놓고 대기 중인 연결 하나를 받아 바로 닫는다 (클라이언트는 즉시 실패를 알게 됨)
+                // (EMFILE 은 대기 중인 연결이 없어도 나오므로, 받을 연결이 없으면 거기서 멈춘다)
+                if (reserve_fd != -1) {
+                    close(reserve_fd);
+                    int shed = accept(listen_fd, NULL, NULL);
+                    if (shed != -1) {
+                        close(shed);
+                        FLOG_EV(EV_SHED, FLOG_WARN, "[C/epoll] out of fds: shed one connection");
+                    }
+                    reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                    if (shed == -1) return;
+                    if (reserve_fd != -1) continue;
+                }
+                set_accepting(0);               // 예비 fd 도 없음: 연결이 닫혀 자리가 날 때까지 중단
+                return;
+            }
+            perror("accept");                   // 그 밖의 에러(ENOBUFS 등)는 다음 바퀴에 다시 시도
+            return;
+        }
+
+        if (cfd >= nconns) {                    // 테이블은 RLIMIT_NOFILE 크기라 보통은 없는 일
+            fprintf(stderr, "fd %d exceeds connection table\n", cfd);
+            close(cfd);
+            continue;
+        }
+        struct conn *nc = &conns[cfd];          // fd 번호가 곧 테이블 인덱스
+        nc->fd = cfd;
+
+        struct epoll_event cev;                 // 클라이언트용 epoll 이벤트 구조체
+        cev.events   = EPOLLIN;                 // 이 클라이언트에서 읽기 이벤트(데이터 도착) 감시
+        cev.data.ptr = nc;                      // 이벤트가 오면 fd 대신 연결 구조체를 바로 받는다
+
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &cev) == -1) {
+            perror("epoll_ctl client");         // 클라이언트 fd epoll 등록 실패
+            close(cfd);                         // 소켓 닫기
+            continue;                           // 다음 클라이언트 처리
+        }
+        nc->events = EPOLLIN;                   // 지금 등록된 이벤트 기록
+        nc->last_active = wheel.now;
+        arm_timer(nc);                          // 첫 데이터가 올 때까지 핸드셰이크 타임아웃
+        nlive++;
+
+        FLOG_EV(EV_CONN, FLOG_INFO, "[C/epoll] client fd=%d connected, " FLOG_ADDR_FMT,
+                cfd, FLOG_ADDR_ARGS(&caddr));   // 새 클라이언트 접속 로그 (꺼진 레벨이면 비교 한 번)
+    }
+}
+
+// 배치가 끝난 뒤 ready 목록의 앞쪽 n 개에게 한 몫씩 더 읽힌다. 또 예산을 다 쓴 연결은 목록 끝에
+// 다시 붙으므로 다음 바퀴로 넘어가고, 그 사이에 epoll_wait(timeout 0) 로 새 이벤트가 끼어든다
+static void run_ready(int n) {
+    for (int i = 0; i < n; i++) {
+        struct conn *c = ready[i];
+        if (!c->ready) continue;                 // 그 사이에 닫힌 연결 (또는 같은 칸의 새 연결이 이미 처리됨)
+        c->ready = 0;
+        handle_read(c);
+    }
+    nready -= n;
+    memmove(ready, ready + n, nready * sizeof(*ready)); // 이번 바퀴에 새로 올라온 연결을 앞으로
+}
+
+// 타임아웃 옵션(초) → ms. 숫자만 받고, 타이머 휠이 표현하는 범위(10ms 틱이면 약 46시간)를 넘으면 -1.
+// (그보다 긴 값은 휠이 범위 끝으로 당겨서 조용히 짧아진다)
+static int parse_timeout(const char *s, uint32_t *ms) {
+    char *end;
+    if (*s < '0' || *s > '9') return -1;         // strtoul 은 "-1" 도 받아서 wrap 시킨다
+    errno = 0;
+    unsigned long sec = strtoul(s, &end, 10);
+    if (errno || *end || sec > (uint64_t)TW_MAX_TICKS * TIMER_TICK_MS / 1000) return -1;
+    *ms = (uint32_t)sec * 1000;
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--hwm BYTES] [--splice] [--accept-budget N] [--max-conns N]\n"
+                    "          [--idle-timeout SEC] [--handshake-timeout SEC] [--stall-timeout SEC]  (0 이면 끔)\n"
+                    "          [--read-budget BYTES]  (0 이면 무제한)\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    static const struct option long_opts[] = {
+        {"hwm", required_argument, NULL, 'w'},  // 출력 큐 high-water mark (바이트)
+        {"splice", no_argument, NULL, 's'},     // 소켓→파이프→소켓 zero-copy 에코
+        {"accept-budget", required_argument, NULL, 'a'}, // 루프 한 바퀴에 accept 할 최대 연결 수
+        {"max-conns", required_argument, NULL, 'm'},     // 동시 연결 상한
+        {"idle-timeout", required_argument, NULL, 'i'},      // 진전 없는 연결을 닫기까지 (초)
+        {"handshake-timeout", required_argument, NULL, 'H'}, // 접속 후 첫 데이터까지 (초)
+        {"stall-timeout", required_argument, NULL, 'S'},     // 송신이 막힌 채로 버틸 시간 (초)
+        {"read-budget", required_argument, NULL, 'r'},       // 한 바퀴에 연결 하나에서 읽을 최대 바이트
+        {NULL, 0, NULL, 0}
+    };
+    int c, bad = 0;
+    while ((c = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'w':
+            hwm = strtoull(optarg, NULL, 10);
+            break;
+        case 's':
+            use_splice = 1;
+            break;
+        case 'a':
+            accept_budget = atoi(optarg);
+            break;
+        case 'm':
+            max_conns = atoi(optarg);
+            break;
+        case 'i':
+            if (parse_timeout(optarg, &idle_ms) == -1) bad = 1;
+            break;
+        case 'H':
+            if (parse_timeout(optarg, &handshake_ms) == -1) bad = 1;
+            break;
+        case 'S':
+            if (parse_timeout(optarg, &stall_ms) == -1) bad = 1;
+            break;
+        case 'r':
+            read_budget = strtoull(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+    if (bad || optind != argc || hwm < BUF_SIZE || accept_budget < 1 || max_conns < 0) {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    if (init_conn_table() == -1)                       // fd 인덱스 연결 테이블 준비
+        exit(1);
+    tw_init(&wheel, TIMER_TICK_MS, tw_clock_ms());     // 타임아웃용 타이머 휠
+    signal(SIGPIPE, SIG_IGN);                          // --splice: splice 는 MSG_NOSIGNAL 을 못 주므로 끊긴 소켓에 쓰면 SIGPIPE (기본 동작은 프로세스 종료). 무시하고 EPIPE 로 받는다
+
+    fastlog_init(log_events, sizeof(log_events) / sizeof(log_events[0])); // 로그 flusher 스레드 시작 (FASTLOG_LEVEL/FASTLOG_SAMPLE)
+
+    reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC); // fd 고갈 대비 예비 fd 확보
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);       // 서버 리슨용 TCP 소켓 생성
     if (listen_fd == -1) {                             // 소켓 생성 실패 시
         perror("socket");                              // 오류 메시지 출력
         exit(1);                                       // 비정상 종료
@@ -94,7 +746,7 @@ int main(void) {
         exit(1);                                      // 종료
     }
 
-    int epfd = epoll_create1(0);                      // epoll 인스턴스 생성
+    epfd = epoll_create1(0);                          // epoll 인스턴스 생성
     if (epfd == -1) {                                 // 실패 시
         perror("epoll_create1");                      // 오류 출력
         close(listen_fd);                             // 리슨 소켓 닫기
@@ -114,7 +766,7 @@ int main(void) {
 
     struct epoll_event ev;                            // epoll에 등록할 이벤트 구조체
     ev.events  = EPOLLIN;                             // 읽기 가능 이벤트(데이터 도착/새 연결) 감지
-    ev.data.fd = listen_fd;                           // 이 이벤트는 리슨 소켓과 연관
+    ev.data.ptr = NULL;                               // 리슨 소켓은 data.ptr == NULL 로 구분 (클라이언트는 연결 구조체 주소)
 
     if (epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev) == -1) {
         perror("epoll_ctl listen_fd");                // 리슨 소켓 epoll 등록 실패 시
@@ -133,16 +785,19 @@ int main(void) {
       - event: 감시할 이벤트 종류 및 관련 데이터 (EPOLLIN, EPOLLOUT 등 + data 필드)
     struct epoll_event {
         uint32_t events;  // 이벤트 비트 플래그 (EPOLLIN, EPOLLOUT, EPOLLERR 등)
-        epoll_data_t data;// 사용자 정의 데이터 (여기서는 fd를 저장)
+        epoll_data_t data;// 사용자 정의 데이터 (fd, ptr 등 union: 여기서는 ptr 에 연결 구조체 주소를 저장)
     };
     */
 
-    printf("[C/epoll] Listening on port %d\n", PORT); // 서버가 해당 포트에서 리슨 중이라고 출력
+    FLOG(FLOG_INFO, "[C/epoll] Listening on port %d%s", PORT, use_splice ? " (splice)" : ""); // 서버가 해당 포트에서 리슨 중이라고 출력
 
     struct epoll_event events[MAX_EVENTS];            // epoll_wait 결과를 담을 배열 (최대 MAX_EVENTS개)
 
     while (1) {                                       // 메인 이벤트 루프 (무한 루프)
-        int n = epoll_wait(epfd, events, MAX_EVENTS, -1); // 이벤트가 발생할 때까지 대기
+        // 다음 타이머 만료까지만 대기 (걸린 타이머가 없으면 -1: 이벤트가 올 때까지).
+        // ready 목록에 읽을 연결이 남아 있으면 기다리지 않고 새 이벤트만 걷어 온다
+        int carry = nready;                           // 지난 바퀴에 예산을 다 쓴 연결 수 (이번 배치 뒤에 처리)
+        int n = epoll_wait(epfd, events, MAX_EVENTS, carry ? 0 : tw_timeout_ms(&wheel, tw_clock_ms()));
         if (n == -1) {                                // epoll_wait 실패 시
             if (errno == EINTR) continue;             // 시그널로 인한 중단(EINTR)이면 다시 대기
             perror("epoll_wait");                     // 그 외 에러는 출력
@@ -162,88 +817,36 @@ int main(void) {
               * 실패 시 -1 (errno 설정)
         */
         
+        tw_advance(&wheel, tw_clock_ms());            // 이벤트 처리 전에 시각을 맞춘다 (last_active 가 이 틱을 씀)
+
         for (int i = 0; i < n; i++) {                 // 발생한 각 이벤트를 순회하면서 처리
-            int fd = events[i].data.fd;               // 이벤트와 연관된 파일 디스크립터
+            struct conn *c = events[i].data.ptr;      // 이벤트와 연관된 연결 (리슨 소켓이면 NULL)
             uint32_t evs = events[i].events;          // 어떤 이벤트(EPOLLIN, EPOLLERR 등)가 발생했는지
 
-            if (fd == listen_fd) {                    // 리슨 소켓에서 이벤트 발생: 새 클라이언트 연결 도착
-                // 새 연결 처리 (accept 루프)
-                while (1) {
-                    struct sockaddr_in caddr;         // 클라이언트 주소 정보
-                    socklen_t clen = sizeof(caddr);   // 주소 길이
-                    int cfd = accept(listen_fd, (struct sockaddr*)&caddr, &clen); // 새 연결 수락
-
-                    if (cfd == -1) {                  // accept 실패
-                        if (errno == EAGAIN || errno == EWOULDBLOCK)
-                            break;                    // 논블로킹: 더 이상 대기 중인 연결 없음, 루프 탈출
-                        perror("accept");             // 다른 에러는 출력
-                        break;                        // 그리고 루프 탈출
-                    }
-
-                    if (make_socket_nonblocking(cfd) == -1) { // 새 클라이언트 소켓을 논블로킹으로 전환
-                        perror("fcntl client");        // 실패 시 에러 출력
-                        close(cfd);                    // 해당 클라이언트 소켓 닫기
-                        continue;                      // 다음 연결 처리 시도
-                    }
-
-                    struct epoll_event cev;            // 클라이언트용 epoll 이벤트 구조체
-                    cev.events  = EPOLLIN;             // 이 클라이언트에서 읽기 이벤트(데이터 도착) 감시
-                    cev.data.fd = cfd;                 // 이 이벤트의 data에 클라이언트 fd 저장
-
-                    if (epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &cev) == -1) {
-                        perror("epoll_ctl client");    // 클라이언트 fd epoll 등록 실패
-                        close(cfd);                    // 소켓 닫기
-                        continue;                      // 다음 클라이언트 처리
-                    }
-
-                    printf("[C/epoll] client fd=%d connected\n", cfd); // 새 클라이언트 접속 로그 출력
-                }
+            if (!c) {                    // 리슨 소켓에서 이벤트 발생: 새 클라이언트 연결 도착
+                handle_accept();                      // 새 연결 처리 (accept 루프, 한 번에 accept_budget 개까지)
             } else {
                 // 클라이언트 소켓(fd)에 대한 이벤트 처리
                 if (evs & (EPOLLERR | EPOLLHUP)) {     // 에러 또는 연결 종료(HUP) 이벤트
-                    printf("[C/epoll] fd=%d error/hup\n", fd);
-                    close(fd);                         // 소켓 닫기
-                    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL); // epoll 감시 목록에서 제거
+                    FLOG_EV(EV_CLOSE, FLOG_INFO, "[C/epoll] fd=%d error/hup", c->fd);
+                    close_conn(c);                     // 큐 정리 + epoll 제거 + 소켓 닫기
                     continue;                          // 다음 이벤트 처리
                 }
 
-                if (evs & EPOLLIN) {                   // 읽기 가능 이벤트가 발생한 경우
-                    char buf[BUF_SIZE];                // 읽기/쓰기용 버퍼
-
-                    while (1) {                        // 가능한 만큼 반복해서 읽기
-                        ssize_t cnt = read(fd, buf, sizeof(buf)); // 클라이언트로부터 데이터 읽기
-                        if (cnt == -1) {               // read 에러
-                            if (errno == EAGAIN || errno == EWOULDBLOCK) { 
-                                // 논블로킹: 현재 시점에는 더 이상 읽을 데이터 없음
-                                break;                 // 읽기 루프 종료, 다음 이벤트로
-                            }
-                            perror("read");            // 다른 read 에러
-                            close(fd);                 // 소켓 닫기
-                            epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL); // epoll에서 제거
-                            break;                     // 읽기 루프 종료
-                        } else if (cnt == 0) {
-                            // 클라이언트가 orderly shutdown (FIN 보냄): 연결 종료
-                            printf("[C/epoll] client fd=%d closed\n", fd);
-                            close(fd);                 // 소켓 닫기
-                            epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL); // epoll에서 제거
-                            break;                     // 읽기 루프 종료
-                        } else {
-                            // cnt > 0 인 경우: 실제로 cnt 바이트만큼 데이터를 읽어옴
-                            // 에코 서버: 받은 데이터를 그대로 다시 클라이언트에게 돌려줌
-                            ssize_t w = write(fd, buf, cnt); // 읽은 만큼 그대로 쓰기
-                            if (w == -1) {             // write 에러
-                                perror("write");
-                                close(fd);             // 소켓 닫기
-                                epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL); // epoll에서 제거
-                                break;                 // 읽기 루프 종료
-                            }
-                        }
-                    }
-                }
+                if ((evs & EPOLLOUT) && handle_write(c) == -1) // 송신 버퍼에 자리가 생김: 밀린 데이터부터 보냄
+                    continue;                          // handle_write 안에서 연결이 닫힘
+
+                if ((evs & EPOLLIN) && !c->ready)      // 읽기 가능: 읽어서 큐에 넣고 에코 (ready 목록에 있으면 차례를 기다림)
+                    handle_read(c);
             }
         }
+        run_ready(carry);                             // 배치 뒤에 ready 목록을 돌아가며 한 몫씩 읽기
+        expire_timers();                              // 타임아웃된 연결 정리 (방금 활동한 연결은 다시 걸림)
     }
 
+    free(conns);                                      // 연결 테이블 반환
+    free(timers);
+    free(ready);
     close(epfd);                                      // epoll 인스턴스 닫기
     close(listen_fd);                                 // 리슨 소켓 닫기
     return 0;                                         // 정상 종료
@@ -0,0 +1,343 @@
+/* fastlog.h — 핫패스용 비동기 로거 (header-only, C/C++ 공용)
+ *
+ * 사용법:
+ *   enum { EV_CONN, EV_CLOSE };
+ *   static const char *const ev_names[] = { "conn", "close" };
+ *   fastlog_init(ev_names, 2);                       // main 시작 시 한 번
+ *   FLOG(FLOG_INFO, "listening on %d", port);
+ *   FLOG_EV(EV_CONN, FLOG_INFO, "fd=%d connected", fd); // 이벤트 종류별 샘플링 적용
+ *
+ * 구조:
+ *   - 스레드마다 SPSC 링 버퍼(레코드 FASTLOG_RING_SLOTS 개)를 하나씩 가진다. 처음 로그를 남길 때
+ *     할당해서 전역 목록에 lock-free 로 끼워 넣는다. 생산자는 자기 링에만 쓰므로 락이 없다.
+ *   - 백그라운드 flusher 스레드 하나가 모든 링을 돌며 레코드를 꺼내 큰 버퍼에 모은 뒤
+ *     write 한 번으로 내보낸다. 터미널/파이프가 느려도 막히는 것은 flusher 뿐이다.
+ *   - 링이 가득 차면 기다리지 않고 버린다. 버린 개수는 flusher 가 따로 한 줄로 알려 준다.
+ *   - 꺼진 레벨은 FLOG 매크로 안의 정수 비교 하나로 끝난다. 인자도 평가하지 않는다.
+ *   - 스레드 사이의 순서는 보장하지 않는다. (한 스레드의 로그는 남긴 순서대로 나간다)
+ *
+ * 환경 변수:
+ *   FASTLOG_LEVEL=debug|info|warn|error|off     (기본 info)
+ *   FASTLOG_SAMPLE=conn=100,close=100           이벤트별로 N 번에 한 번만 기록 (스레드별로 셈)
+ *
+ * 프로세스가 exit 로 끝나면 atexit 에서 남은 로그를 비운다. 시그널로 죽으면 마지막
+ * 몇 ms 분량은 잃을 수 있다.
+ */
+#ifndef FASTLOG_H
+#define FASTLOG_H
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+#ifndef FASTLOG_RING_SLOTS
+#define FASTLOG_RING_SLOTS 1024     // 스레드당 레코드 수 (2의 거듭제곱)
+#endif
+#ifndef FASTLOG_MSG_MAX
+#define FASTLOG_MSG_MAX    112      // 레코드 본문 최대 길이. 넘으면 잘린다 (레코드 = 128바이트)
+#endif
+#ifndef FASTLOG_IDLE_US
+#define FASTLOG_IDLE_US    5000     // 링이 모두 비었을 때 flusher 가 쉬는 시간
+#endif
+#define FASTLOG_MAX_EVENTS 16       // 샘플링할 수 있는 이벤트 종류 수
+
+enum { FLOG_DEBUG, FLOG_INFO, FLOG_WARN, FLOG_ERROR, FLOG_OFF };
+
+struct fastlog_rec {
+    uint64_t ts_ns;                 // CLOCK_REALTIME (coarse)
+    uint16_t len;
+    uint8_t  level;
+    char     msg[FASTLOG_MSG_MAX];
+};
+
+struct fastlog_ring {
+    // 생산자/소비자가 쓰는 인덱스를 서로 다른 캐시 라인에 둔다 (false sharing 방지)
+    uint64_t head __attribute__((aligned(64)));  // 생산자(로그를 남기는 스레드)만 씀
+    uint64_t tail_cache;                         // 생산자가 마지막으로 본 tail
+    uint64_t ev_seen[FASTLOG_MAX_EVENTS];        // 샘플링 카운터 (생산자 전용)
+    uint64_t tail __attribute__((aligned(64)));  // 소비자(flusher)만 씀
+    uint64_t dropped;                            // 링이 가득 차서 버린 레코드 수
+    int      closed;                             // 주인 스레드가 끝남
+    struct fastlog_ring *next;
+    struct fastlog_rec recs[FASTLOG_RING_SLOTS];
+};
+
+static int          fastlog_level = FLOG_INFO;
+static unsigned     fastlog_sample[FASTLOG_MAX_EVENTS];   // 0/1 이면 모두 기록
+static int          fastlog_fd = STDOUT_FILENO;
+static int          fastlog_started;
+static int          fastlog_stopping;
+static pthread_t    fastlog_thread;
+static pthread_key_t fastlog_key;
+static struct fastlog_ring *fastlog_rings;                // 모든 링 (앞에만 추가됨)
+static __thread struct fastlog_ring *fastlog_tls;         // 이 스레드의 링
+
+#define FLOG_ON(lvl) __builtin_expect((lvl) >= __atomic_load_n(&fastlog_level, __ATOMIC_RELAXED), 0)
+
+#define FLOG(lvl, ...) \
+    do { if (FLOG_ON(lvl)) fastlog_write((lvl), __VA_ARGS__); } while (0)
+
+#define FLOG_EV(ev, lvl, ...) \
+    do { if (FLOG_ON(lvl) && fastlog_sampled(ev)) fastlog_write((lvl), __VA_ARGS__); } while (0)
+
+// inet_ntoa 대신: 정적 버퍼가 없어 스레드 안전하고, 문자열 변환도 한 번의 포맷으로 끝난다
+#define FLOG_ADDR_FMT "%u.%u.%u.%u:%u"
+#define FLOG_ADDR_ARGS(sin)                                        \
+    (unsigned)((const unsigned char *)&(sin)->sin_addr)[0],        \
+    (unsigned)((const unsigned char *)&(sin)->sin_addr)[1],        \
+    (unsigned)((const unsigned char *)&(sin)->sin_addr)[2],        \
+    (unsigned)((const unsigned char *)&(sin)->sin_addr)[3],        \
+    (unsigned)ntohs((sin)->sin_port)
+
+static inline void fastlog_thread_exit(void *arg)
+{
+    struct fastlog_ring *r = (struct fastlog_ring *)arg;
+    __atomic_store_n(&r->closed, 1, __ATOMIC_RELEASE);  // 다 비우면 flusher 가 해제
+    fastlog_tls = NULL;
+}
+
+static inline struct fastlog_ring *fastlog_get_ring(void)
+{
+    struct fastlog_ring *r = fastlog_tls;
+    if (__builtin_expect(r != NULL, 1))
+        return r;
+
+    void *p;
+    if (posix_memalign(&p, 64, sizeof(struct fastlog_ring)) != 0)
+        return NULL;
+    r = (struct fastlog_ring *)p;
+    memset(r, 0, sizeof(*r));
+
+    r->next = __atomic_load_n(&fastlog_rings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&fastlog_rings, &r->next, r, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;                                               // 실패하면 r->next 가 최신 head 로 갱신됨
+    pthread_setspecific(fastlog_key, r);                // 스레드가 끝나면 fastlog_thread_exit
+    fastlog_tls = r;
+    return r;
+}
+
+static inline int fastlog_sampled(int ev)
+{
+    unsigned n = fastlog_sample[ev];
+    if (n <= 1)
+        return 1;
+    struct fastlog_ring *r = fastlog_get_ring();
+    return r && r->ev_seen[ev]++ % n == 0;
+}
+
+static inline void fastlog_write(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static inline void fastlog_write(int level, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (!__atomic_load_n(&fastlog_started, __ATOMIC_ACQUIRE)) {
+        char line[FASTLOG_MSG_MAX + 1];                 // init 전: 동기식으로 바로 쓴다
+        va_start(ap, fmt);
+        int n = vsnprintf(line, sizeof(line) - 1, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if (n > (int)sizeof(line) - 2) n = sizeof(line) - 2;
+        line[n++] = '\n';
+        if (write(fastlog_fd, line, n) < 0) { }
+        return;
+    }
+
+    struct fastlog_ring *r = fastlog_get_ring();
+    if (!r)
+        return;
+    uint64_t head = r->head;
+    if (head - r->tail_cache >= FASTLOG_RING_SLOTS) {
+        r->tail_cache = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);  // 가득 차 보일 때만 다시 읽음
+        if (head - r->tail_cache >= FASTLOG_RING_SLOTS) {
+            __atomic_fetch_add(&r->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+
+    struct fastlog_rec *rec = &r->recs[head & (FASTLOG_RING_SLOTS - 1)];
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);          // vDSO, 시스템 콜 없음
+    rec->ts_ns = (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+    rec->level = (uint8_t)level;
+    va_start(ap, fmt);
+    int n = vsnprintf(rec->msg, FASTLOG_MSG_MAX, fmt, ap);
+    va_end(ap);
+    if (n < 0) n = 0;
+    if (n > FASTLOG_MSG_MAX - 1) n = FASTLOG_MSG_MAX - 1;
+    rec->len = (uint16_t)n;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);  // 레코드 내용이 먼저 보이도록
+}
+
+static inline void fastlog_out(const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fastlog_fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;                                     // 출력이 닫힘: 버린다
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+}
+
+// 모든 링을 한 바퀴 비운다. 꺼낸 레코드 수를 돌려준다.
+static inline size_t fastlog_drain(char *buf, size_t cap)
+{
+    static const char lv[] = "DIWE";
+    static time_t cached_sec = -1;
+    static char   cached_hms[16];
+    size_t used = 0, count = 0;
+
+    struct fastlog_ring *prev = NULL;
+    struct fastlog_ring *r = __atomic_load_n(&fastlog_rings, __ATOMIC_ACQUIRE);
+    while (r) {
+        int closed = __atomic_load_n(&r->closed, __ATOMIC_ACQUIRE);
+        uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = r->tail;
+
+        for (; tail != head; tail++) {
+            const struct fastlog_rec *rec = &r->recs[tail & (FASTLOG_RING_SLOTS - 1)];
+            if (cap - used < FASTLOG_MSG_MAX + 32) {
+                fastlog_out(buf, used);
+                used = 0;
+            }
+            time_t sec = (time_t)(rec->ts_ns / 1000000000u);
+            if (sec != cached_sec) {                    // localtime_r 은 초가 바뀔 때만
+                struct tm tm;
+                localtime_r(&sec, &tm);
+                strftime(cached_hms, sizeof(cached_hms), "%H:%M:%S", &tm);
+                cached_sec = sec;
+            }
+            used += (size_t)snprintf(buf + used, cap - used, "%s.%03u %c ", cached_hms,
+                                     (unsigned)(rec->ts_ns % 1000000000u / 1000000u),
+                                     lv[rec->level & 3]);
+            memcpy(buf + used, rec->msg, rec->len);
+            used += rec->len;
+            if (rec->len == 0 || rec->msg[rec->len - 1] != '\n')
+                buf[used++] = '\n';
+            count++;
+        }
+        __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+
+        uint64_t dropped = __atomic_exchange_n(&r->dropped, 0, __ATOMIC_RELAXED);
+        if (dropped) {
+            if (cap - used < 64) {
+                fastlog_out(buf, used);
+                used = 0;
+            }
+            used += (size_t)snprintf(buf + used, cap - used,
+                                     "fastlog: %llu records dropped (ring full)\n",
+                                     (unsigned long long)dropped);
+        }
+
+        struct fastlog_ring *next = r->next;
+        if (closed && prev) {
+            // 주인이 끝났고 (closed 를 본 뒤에 head 를 읽었으므로) 이제 비었음.
+            // 목록 맨 앞이 아니면 떼어 낸다. 새 링은 맨 앞에만 붙으므로 prev->next 는 flusher 만 바꾼다.
+            prev->next = next;
+            free(r);
+        } else {
+            prev = r;
+        }
+        r = next;
+    }
+    if (used)
+        fastlog_out(buf, used);
+    return count;
+}
+
+static inline void *fastlog_flusher(void *arg)
+{
+    static char buf[64 * 1024];
+    (void)arg;
+    for (;;) {
+        int stopping = __atomic_load_n(&fastlog_stopping, __ATOMIC_ACQUIRE);
+        if (fastlog_drain(buf, sizeof(buf)) > 0)
+            continue;                                   // 바쁠 때는 쉬지 않고 계속 비운다
+        if (stopping)
+            break;                                      // stop 을 본 뒤 한 바퀴 더 비웠음
+        usleep(FASTLOG_IDLE_US);
+    }
+    return NULL;
+}
+
+static inline void fastlog_shutdown(void)
+{
+    if (!__atomic_load_n(&fastlog_started, __ATOMIC_ACQUIRE))
+        return;
+    __atomic_store_n(&fastlog_stopping, 1, __ATOMIC_RELEASE);
+    pthread_join(fastlog_thread, NULL);
+    __atomic_store_n(&fastlog_started, 0, __ATOMIC_RELEASE);  // 이후 로그는 동기식
+}
+
+static inline int fastlog_parse_level(const char *s)
+{
+    static const char *const names[] = { "debug", "info", "warn", "error", "off" };
+    for (int i = 0; i <= FLOG_OFF; i++)
+        if (strcasecmp(s, names[i]) == 0)
+            return i;
+    return -1;
+}
+
+static inline void fastlog_set_level(int level)
+{
+    __atomic_store_n(&fastlog_level, level, __ATOMIC_RELAXED);
+}
+
+static inline void fastlog_set_sample(int ev, unsigned every)
+{
+    if (ev >= 0 && ev < FASTLOG_MAX_EVENTS)
+        fastlog_sample[ev] = every;
+}
+
+// FASTLOG_SAMPLE="name=N,name=N" 해석. 이름은 events[] 의 인덱스가 이벤트 번호
+static inline void fastlog_parse_sample(const char *spec, const char *const *events, int nev)
+{
+    while (spec && *spec) {
+        const char *eq = strchr(spec, '=');
+        const char *end = strchr(spec, ',');
+        if (!end) end = spec + strlen(spec);
+        if (eq && eq < end) {
+            for (int i = 0; i < nev && i < FASTLOG_MAX_EVENTS; i++) {
+                if (strlen(events[i]) == (size_t)(eq - spec) && strncmp(spec, events[i], eq - spec) == 0)
+                    fastlog_set_sample(i, (unsigned)strtoul(eq + 1, NULL, 10));
+            }
+        }
+        spec = *end ? end + 1 : end;
+    }
+}
+
+// flusher 를 띄우고 환경 변수로 레벨/샘플링을 설정한다. events 는 FLOG_EV 의 이벤트 이름 (NULL 가능)
+static inline int fastlog_init(const char *const *events, int nev)
+{
+    const char *s = getenv("FASTLOG_LEVEL");
+    if (s) {
+        int lvl = fastlog_parse_level(s);
+        if (lvl < 0)
+            fprintf(stderr, "fastlog: unknown FASTLOG_LEVEL '%s'\n", s);
+        else
+            fastlog_set_level(lvl);
+    }
+    if (events)
+        fastlog_parse_sample(getenv("FASTLOG_SAMPLE"), events, nev);
+
+    if (pthread_key_create(&fastlog_key, fastlog_thread_exit) != 0)
+        return -1;
+    if (pthread_create(&fastlog_thread, NULL, fastlog_flusher, NULL) != 0)
+        return -1;                                      // 실패하면 계속 동기식으로 쓴다
+    __atomic_store_n(&fastlog_started, 1, __ATOMIC_RELEASE);
+    atexit(fastlog_shutdown);
+    return 0;
+}
+
+#endif /* FASTLOG_H */
@@ -0,0 +1,105 @@
+/* hdr_histogram.h — HDR 방식(log-linear) 지연 시간 히스토그램 (header-only, C/C++ 공용)
+ *
+ * 사용법:
+ *   struct hdr_histogram h;
+ *   hdr_init(&h);
+ *   hdr_record(&h, latency_ns);
+ *   hdr_merge(&total, &h);                       // 스레드별 히스토그램 합치기
+ *   uint64_t p99 = hdr_percentile(&total, 99.0);
+ *
+ * 구조:
+ *   - 2의 거듭제곱 구간마다 HDR_SUB/2 개의 같은 폭 버킷을 둔다. 값이 커져도 상대 오차가
+ *     2^-(HDR_SUB_BITS-1) (약 1.6%) 이하로 유지되고, 버킷 수는 값의 범위가 아니라 비트 수에 비례한다.
+ *   - 기록은 비트 연산 몇 개 + 카운터 증가. 할당도 락도 없다 (스레드마다 하나씩 두고 끝에서 합친다).
+ *   - HDR_MAX_BITS 이상인 값(기본 2^42 ns ≈ 73분)은 최댓값 버킷에 넣는다.
+ */
+#ifndef HDR_HISTOGRAM_H
+#define HDR_HISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define HDR_SUB_BITS 7                                   // 구간당 유효 비트
+#define HDR_SUB      (1u << HDR_SUB_BITS)
+#define HDR_MAX_BITS 42                                  // 기록 가능한 값의 비트 수
+#define HDR_BUCKETS  ((HDR_MAX_BITS - HDR_SUB_BITS + 2) * (HDR_SUB / 2))
+
+struct hdr_histogram {
+    uint64_t counts[HDR_BUCKETS];
+    uint64_t total;
+    uint64_t min, max;
+    uint64_t sum;                                        // 평균 계산용 (ns 합, 2^64 까지)
+};
+
+static inline void hdr_init(struct hdr_histogram *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+// 값 → 버킷. HDR_SUB 미만은 그대로, 그 위는 최상위 HDR_SUB_BITS 비트만 남긴다
+static inline unsigned hdr_index(uint64_t v)
+{
+    if (v >= (1ull << HDR_MAX_BITS))
+        v = (1ull << HDR_MAX_BITS) - 1;
+    if (v < HDR_SUB)
+        return (unsigned)v;
+    unsigned shift = (unsigned)(63 - __builtin_clzll(v)) - HDR_SUB_BITS + 1;
+    return shift * (HDR_SUB / 2) + (unsigned)(v >> shift);
+}
+
+// 버킷에 들어가는 가장 큰 값
+static inline uint64_t hdr_highest(unsigned idx)
+{
+    if (idx < HDR_SUB)
+        return idx;
+    unsigned shift = idx / (HDR_SUB / 2) - 1;
+    uint64_t mant = idx - shift * (HDR_SUB / 2);
+    return ((mant + 1) << shift) - 1;
+}
+
+static inline void hdr_record(struct hdr_histogram *h, uint64_t v)
+{
+    h->counts[hdr_index(v)]++;
+    h->total++;
+    h->sum += v;
+    if (v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+}
+
+static inline void hdr_merge(struct hdr_histogram *dst, const struct hdr_histogram *src)
+{
+    for (unsigned i = 0; i < HDR_BUCKETS; i++)
+        dst->counts[i] += src->counts[i];
+    dst->total += src->total;
+    dst->sum   += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+// p 백분위 값 (0 < p <= 100). 버킷의 상한을 돌려주되 실제 최댓값을 넘지 않는다
+static inline uint64_t hdr_percentile(const struct hdr_histogram *h, double p)
+{
+    if (h->total == 0)
+        return 0;
+    uint64_t want = (uint64_t)(p / 100.0 * (double)h->total + 0.5);
+    if (want < 1) want = 1;
+    if (want > h->total) want = h->total;
+
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HDR_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= want) {
+            uint64_t v = hdr_highest(i);
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+static inline double hdr_mean(const struct hdr_histogram *h)
+{
+    return h->total ? (double)h->sum / (double)h->total : 0.0;
+}
+
+#endif /* HDR_HISTOGRAM_H */
@@ -0,0 +1,418 @@
+// loadgen.cpp — 에코 서버 부하 발생기
+//
+//   ./loadgen --port 5000 --threads 4 --conns 16 --size 64 --depth 1 --duration 10 --warmup 2
+//   ./loadgen --port 5001 --rate 100000            // open-loop: 초당 10만 요청을 일정 간격으로
+//
+// 스레드마다 epoll 루프 하나가 자기 연결 M 개를 돈다. 요청 = size 바이트를 보내고
+// 같은 바이트 수가 에코되어 돌아오면 응답 하나로 센다.
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "hdr_histogram.h"
+
+constexpr int    MAX_EVENTS = 256;
+constexpr size_t RECV_BUF   = 64 * 1024;
+constexpr uint32_t QUEUE_CAP = 4096;   // 연결당 (보냈거나 보낼) 요청 타임스탬프 수. 2의 거듭제곱
+
+// 실행 옵션
+//   --host IP / --port N : 대상 서버 (기본 127.0.0.1:5000)
+//   --threads N          : 부하 스레드 수
+//   --conns M            : 스레드당 연결 수 (전체 N×M)
+//   --size BYTES         : 요청 하나의 크기
+//   --depth D            : 연결당 동시에 띄워 둘 요청 수 (파이프라이닝)
+//   --rate R             : 0 이면 closed-loop (응답이 오면 바로 다음 요청),
+//                          아니면 open-loop: 전체 초당 R 요청을 일정 간격으로 예약한다
+//   --duration SEC / --warmup SEC : 측정 시간 / 측정 전에 버리는 시간
+struct Options {
+    std::string host    = "127.0.0.1";
+    int         port    = 5000;
+    int         threads = 1;
+    int         conns   = 1;
+    size_t      size    = 64;
+    uint32_t    depth   = 1;
+    double      rate    = 0;
+    double      duration = 10;
+    double      warmup   = 2;
+    bool        nodelay  = true;
+};
+
+static uint64_t now_ns() {
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+// 연결 하나의 상태. ts[tail..head) 가 아직 응답을 못 받은 요청이고,
+// 그중 뒤쪽 unsent 개는 아직 (다) 보내지 못한 요청이다.
+struct Conn {
+    int      fd       = -1;
+    uint32_t head     = 0;
+    uint32_t tail     = 0;
+    uint32_t unsent   = 0;
+    size_t   send_off = 0;     // 보내는 중인 요청에서 이미 나간 바이트
+    size_t   recv_off = 0;     // 받는 중인 응답에서 이미 들어온 바이트
+    uint32_t events   = 0;     // epoll 에 등록된 이벤트
+    bool     dead     = false;
+    uint64_t ts[QUEUE_CAP];    // 요청 시각. open-loop 는 실제로 보낸 시각이 아니라 예약된 시각
+};
+
+struct Result {
+    hdr_histogram hist;
+    uint64_t bytes      = 0;   // 측정 구간에 받은 바이트
+    uint64_t errors     = 0;   // 끊긴 연결
+    uint64_t overflow   = 0;   // open-loop: 연결 큐가 가득 차서 예약하지 못한 요청
+    bool     failed     = false;
+};
+
+class Worker {
+public:
+    Worker(const Options& opt, int id, uint64_t start, Result& res)
+        : opt_(opt), res_(res) {
+        warm_end_ = start + static_cast<uint64_t>(opt.warmup * 1e9);
+        end_      = warm_end_ + static_cast<uint64_t>(opt.duration * 1e9);
+        if (opt.rate > 0) {
+            interval_ = 1e9 * opt.threads / opt.rate;
+            // 스레드마다 시작 위치를 어긋나게 해서 요청이 한꺼번에 몰리지 않게 한다
+            next_due_ = start + static_cast<uint64_t>(interval_ * id / opt.threads);
+        }
+        // 보낼 데이터: 요청 depth 개 분량을 미리 채워 두고, 보낼 위치만 옮기며 write 한다
+        payload_.resize(opt.size * opt.depth);
+        for (size_t i = 0; i < payload_.size(); ++i)
+            payload_[i] = static_cast<char>('a' + i % opt.size % 26);
+        recv_buf_.resize(RECV_BUF);
+    }
+
+    void run();
+
+private:
+    bool connect_all();
+    void schedule(Conn& c, uint64_t ts);
+    bool flush(Conn& c);
+    bool on_readable(Conn& c, uint64_t now);
+    void set_events(Conn& c);
+    void fail(Conn& c);
+
+    const Options&     opt_;
+    Result&            res_;
+    int                epfd_ = -1;
+    std::vector<Conn*> conns_;
+    std::vector<char>  payload_;
+    std::vector<char>  recv_buf_;
+    uint64_t           warm_end_ = 0, end_ = 0;
+    double             interval_ = 0;    // open-loop: 이 스레드의 요청 간격 (ns)
+    uint64_t           next_due_ = 0;
+    size_t             rr_ = 0;          // open-loop: 다음 요청을 받을 연결
+};
+
+bool Worker::connect_all() {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(opt_.port);
+    if (::inet_pton(AF_INET, opt_.host.c_str(), &addr.sin_addr) <= 0) {
+        std::cerr << "bad host: " << opt_.host << "\n";
+        return false;
+    }
+
+    for (int i = 0; i < opt_.conns; ++i) {
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            perror("socket");
+            return false;
+        }
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {   // 연결은 블로킹으로
+            perror("connect");
+            ::close(fd);
+            return false;
+        }
+        int one = opt_.nodelay ? 1 : 0;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));   // 작은 요청이 Nagle 에 묶이지 않게
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+        Conn* c = new Conn;
+        c->fd = fd;
+        epoll_event ev{};
+        ev.events   = EPOLLIN;
+        ev.data.ptr = c;
+        if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            perror("epoll_ctl");
+            ::close(fd);
+            delete c;
+            return false;
+        }
+        c->events = EPOLLIN;
+        conns_.push_back(c);
+    }
+    return true;
+}
+
+// 요청 하나를 큐 끝에 예약한다 (보내는 것은 flush)
+void Worker::schedule(Conn& c, uint64_t ts) {
+    c.ts[c.head++ % QUEUE_CAP] = ts;
+    c.unsent++;
+}
+
+// 예약된 요청을 depth 한도 안에서 보낸다. 연결이 끊겼으면 false
+bool Worker::flush(Conn& c) {
+    while (c.unsent > 0) {
+        uint32_t inflight = c.head - c.tail - c.unsent;
+        if (inflight >= opt_.depth) break;                 // 파이프라인이 가득 참
+        uint32_t n = std::min(c.unsent, opt_.depth - inflight);
+        size_t bytes = n * opt_.size - c.send_off;
+
+        ssize_t w = ::write(c.fd, payload_.data() + c.send_off, bytes);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        c.send_off += w;
+        c.unsent   -= static_cast<uint32_t>(c.send_off / opt_.size);
+        c.send_off %= opt_.size;
+        if (static_cast<size_t>(w) < bytes) break;         // 송신 버퍼가 참
+    }
+    set_events(c);
+    return true;
+}
+
+// 보낼 것이 남아 있고 파이프라인에 자리가 있는데 못 보냈으면 EPOLLOUT 을 켠다
+void Worker::set_events(Conn& c) {
+    uint32_t inflight = c.head - c.tail - c.unsent;
+    uint32_t want = EPOLLIN;
+    if (c.unsent > 0 && inflight < opt_.depth) want |= EPOLLOUT;
+    if (want == c.events) return;
+    epoll_event ev{};
+    ev.events   = want;
+    ev.data.ptr = &c;
+    if (::epoll_ctl(epfd_, EPOLL_CTL_MOD, c.fd, &ev) == 0)
+        c.events = want;
+}
+
+// 에코를 읽어 size 바이트마다 응답 하나를 완료 처리한다. 연결이 끊겼으면 false
+bool Worker::on_readable(Conn& c, uint64_t now) {
+    while (true) {
+        ssize_t n = ::read(c.fd, recv_buf_.data(), recv_buf_.size());
+        if (n == 0) return false;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        if (now >= warm_end_) res_.bytes += n;
+        c.recv_off += n;
+        while (c.recv_off >= opt_.size && c.tail != c.head) {
+            c.recv_off -= opt_.size;
+            uint64_t sent = c.ts[c.tail++ % QUEUE_CAP];
+            if (now >= warm_end_ && now < end_)
+                hdr_record(&res_.hist, now - sent);
+            if (opt_.rate <= 0 && now < end_)
+                schedule(c, now);                          // closed-loop: 응답 하나에 요청 하나
+        }
+        if (static_cast<size_t>(n) < recv_buf_.size()) break;
+    }
+    return flush(c);
+}
+
+void Worker::fail(Conn& c) {
+    if (c.dead) return;
+    c.dead = true;
+    res_.errors++;
+    ::epoll_ctl(epfd_, EPOLL_CTL_DEL, c.fd, nullptr);
+    ::close(c.fd);
+    c.fd = -1;
+}
+
+void Worker::run() {
+    hdr_init(&res_.hist);
+    epfd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epfd_ == -1) {
+        perror("epoll_create1");
+        res_.failed = true;
+        return;
+    }
+    if (!connect_all()) {
+        res_.failed = true;
+        return;
+    }
+
+    uint64_t now = now_ns();
+    if (opt_.rate <= 0) {                                  // closed-loop: 연결마다 depth 개를 띄운다
+        for (Conn* c : conns_) {
+            for (uint32_t i = 0; i < opt_.depth; ++i) schedule(*c, now);
+            if (!flush(*c)) fail(*c);
+        }
+    }
+
+    epoll_event events[MAX_EVENTS];
+    while ((now = now_ns()) < end_) {
+        // open-loop: 예약 시각이 지난 요청을 연결에 돌아가며 넣는다.
+        // 지연은 예약 시각부터 재므로, 서버가 밀려서 늦게 보낸 시간도 지연에 포함된다 (coordinated omission 보정)
+        if (opt_.rate > 0) {
+            while (next_due_ <= now) {
+                Conn* c = conns_[rr_++ % conns_.size()];
+                if (c->dead) {
+                    // 끊긴 연결에 배정된 요청은 버린다
+                } else if (c->head - c->tail >= QUEUE_CAP) {
+                    res_.overflow++;
+                } else {
+                    schedule(*c, next_due_);
+                    if (!flush(*c)) fail(*c);
+                }
+                next_due_ += static_cast<uint64_t>(interval_);
+            }
+        }
+
+        // 다음 예약 시각(없으면 종료 시각)까지 기다린다. 1ms 미만 남으면 0 으로 폴링
+        uint64_t until = opt_.rate > 0 ? std::min(next_due_, end_) : end_;
+        int timeout = static_cast<int>((until - std::min(until, now)) / 1000000);
+
+        int n = ::epoll_wait(epfd_, events, MAX_EVENTS, timeout);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        now = now_ns();
+        for (int i = 0; i < n; ++i) {
+            Conn* c = static_cast<Conn*>(events[i].data.ptr);
+            if (c->dead) continue;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                fail(*c);
+                continue;
+            }
+            if ((events[i].events & EPOLLOUT) && !flush(*c)) {
+                fail(*c);
+                continue;
+            }
+            if ((events[i].events & EPOLLIN) && !on_readable(*c, now))
+                fail(*c);
+        }
+    }
+
+    for (Conn* c : conns_) {
+        if (c->fd != -1) ::close(c->fd);
+        delete c;
+    }
+    ::close(epfd_);
+}
+
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [--host IP] [--port N] [--threads N] [--conns M] [--size BYTES]\n"
+                 "          [--depth D] [--rate REQ_PER_SEC] [--duration SEC] [--warmup SEC] [--no-nodelay]\n";
+}
+
+static bool take_value(int argc, char* argv[], int& i,
+                       const char* name, const char*& value) {
+    size_t len = std::strlen(name);
+    if (std::strncmp(argv[i], name, len) != 0) return false;
+    if (argv[i][len] == '=') {
+        value = argv[i] + len + 1;
+        return true;
+    }
+    if (argv[i][len] == '\0' && i + 1 < argc) {
+        value = argv[++i];
+        return true;
+    }
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* val = nullptr;
+        if (take_value(argc, argv, i, "--host", val)) {
+            opt.host = val;
+        } else if (take_value(argc, argv, i, "--port", val)) {
+            opt.port = std::atoi(val);
+        } else if (take_value(argc, argv, i, "--threads", val)) {
+            opt.threads = std::atoi(val);
+        } else if (take_value(argc, argv, i, "--conns", val)) {
+            opt.conns = std::atoi(val);
+        } else if (take_value(argc, argv, i, "--size", val)) {
+            opt.size = std::strtoull(val, nullptr, 10);
+        } else if (take_value(argc, argv, i, "--depth", val)) {
+            opt.depth = static_cast<uint32_t>(std::strtoul(val, nullptr, 10));
+        } else if (take_value(argc, argv, i, "--rate", val)) {
+            opt.rate = std::atof(val);
+        } else if (take_value(argc, argv, i, "--duration", val)) {
+            opt.duration = std::atof(val);
+        } else if (take_value(argc, argv, i, "--warmup", val)) {
+            opt.warmup = std::atof(val);
+        } else if (std::strcmp(argv[i], "--no-nodelay") == 0) {
+            opt.nodelay = false;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (opt.threads < 1 || opt.conns < 1 || opt.size < 1 || opt.depth < 1 || opt.depth > QUEUE_CAP
+        || opt.rate < 0 || opt.duration <= 0 || opt.warmup < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    ::signal(SIGPIPE, SIG_IGN);   // 서버가 끊은 연결에 쓰면 EPIPE 로 받아 그 연결만 정리
+
+    std::cout << "loadgen: " << opt.host << ":" << opt.port
+              << "  threads=" << opt.threads << " conns=" << opt.threads << "x" << opt.conns
+              << " size=" << opt.size << " depth=" << opt.depth
+              << " mode=" << (opt.rate > 0 ? "open(" + std::to_string(static_cast<long>(opt.rate)) + "/s)" : std::string("closed"))
+              << " duration=" << opt.duration << "s warmup=" << opt.warmup << "s\n";
+
+    // 연결을 다 맺은 뒤에 시작하도록 시작 시각을 조금 뒤로 잡는다
+    uint64_t start = now_ns() + 100000000ull;
+    std::vector<Result> results(opt.threads);
+    std::vector<std::thread> workers;
+    workers.reserve(opt.threads);
+    for (int id = 0; id < opt.threads; ++id)
+        workers.emplace_back([&opt, &results, id, start] {
+            Worker w(opt, id, start, results[id]);
+            w.run();
+        });
+    for (auto& t : workers) t.join();
+
+    Result total;
+    hdr_init(&total.hist);
+    for (const Result& r : results) {
+        if (r.failed) return 1;
+        hdr_merge(&total.hist, &r.hist);
+        total.bytes    += r.bytes;
+        total.errors   += r.errors;
+        total.overflow += r.overflow;
+    }
+
+    const hdr_histogram& h = total.hist;
+    auto us = [](uint64_t ns) { return ns / 1000.0; };
+    char line[256];
+    std::snprintf(line, sizeof(line), "requests  %llu  (%.1f req/s, %.2f MiB/s each way)\n",
+                  static_cast<unsigned long long>(h.total), h.total / opt.duration,
+                  total.bytes / opt.duration / (1024.0 * 1024.0));
+    std::cout << line;
+    if (h.total) {
+        std::snprintf(line, sizeof(line),
+                      "latency us  min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p999 %.1f  max %.1f  mean %.1f\n",
+                      us(h.min), us(hdr_percentile(&h, 50)), us(hdr_percentile(&h, 90)),
+                      us(hdr_percentile(&h, 99)), us(hdr_percentile(&h, 99.9)), us(h.max), hdr_mean(&h) / 1000.0);
+        std::cout << line;
+    }
+    if (total.errors || total.overflow)
+        std::cout << "errors: " << total.errors << " connections lost, "
+                  << total.overflow << " requests not scheduled (queue full)\n";
+    return 0;
+}
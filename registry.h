@@ -0,0 +1,189 @@
+/* registry.h — 읽기 위주 멤버 목록: copy-on-write 스냅샷 + epoch 기반 회수 (header-only, C/C++ 공용)
+ *
+ * 사용법:
+ *   struct registry reg;
+ *   reg_init(&reg);
+ *   struct reg_reader *rd = reg_reader_register(&reg);   // 읽는 스레드마다 한 번
+ *
+ *   const struct reg_snap *s = reg_enter(&reg, rd);       // 브로드캐스트: 락 없음
+ *   for (uint32_t i = 0; i < s->n; i++) send_to(s->items[i], ...);
+ *   reg_exit(rd);                                         // 이후 s 를 쓰면 안 된다
+ *
+ *   reg_add(&reg, c);  reg_remove(&reg, c);               // 입장/퇴장: 새 스냅샷을 만들어 바꿔 끼운다
+ *
+ * 구조:
+ *   - 현재 멤버 목록은 바뀌지 않는 배열(struct reg_snap) 하나이고, 포인터 하나로 공개된다.
+ *     읽는 쪽은 그 포인터를 읽어서 배열을 훑을 뿐이다. 락도, 공유 카운터에 대한 쓰기도 없다.
+ *   - 입장/퇴장은 배열을 통째로 복사해서 고친 뒤 포인터를 바꾼다. O(멤버 수) 이지만 드물다.
+ *     쓰는 쪽끼리는 뮤텍스로 줄을 세운다. 읽는 쪽은 이 뮤텍스를 보지 않는다.
+ *   - 옛 스냅샷은 아직 읽고 있는 스레드가 있을 수 있으므로 바로 해제하지 않는다 (epoch 기반 회수):
+ *       · 전역 epoch 는 스냅샷을 바꿀 때마다 1 씩 오른다. 옛 스냅샷에는 바꾼 뒤의 epoch 를 붙여 둔다.
+ *       · reg_enter 는 자기 슬롯에 지금 epoch 를 적고 나서 포인터를 읽는다. reg_exit 는 슬롯을 0 으로.
+ *       · 슬롯에 적힌 epoch 가 옛 스냅샷의 epoch 이상이면, 그 스레드는 바뀐 뒤에 포인터를 읽었다.
+ *         활성 슬롯이 모두 그렇거나 0 이면 옛 스냅샷을 해제한다. 회수는 쓰는 쪽에서만 한다.
+ *   - 읽는 스레드 슬롯은 REG_MAX_READERS 개이고 캐시 라인마다 하나씩 있다 (false sharing 방지).
+ *   - 읽는 쪽이 오래 머물면 회수가 그만큼 늦어질 뿐, 쓰는 쪽이 기다리지는 않는다.
+ */
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifndef REG_MAX_READERS
+#define REG_MAX_READERS 128         // 읽는 스레드 슬롯 수
+#endif
+
+struct reg_snap {
+    struct reg_snap *next_retired;  // 회수 대기 목록 링크
+    uint64_t retired_epoch;         // 이 스냅샷을 내린 뒤의 epoch
+    uint32_t n;
+    void    *items[];
+};
+
+struct reg_reader {
+    uint64_t epoch __attribute__((aligned(64)));  // 0 이면 읽는 중이 아님
+};
+
+struct registry {
+    struct reg_snap *cur __attribute__((aligned(64)));  // 읽는 쪽이 보는 것은 이것과 epoch 뿐
+    uint64_t epoch;
+    pthread_mutex_t wlock __attribute__((aligned(64)));  // 아래는 쓰는 쪽 전용
+    struct reg_snap *retired;
+    size_t nretired;
+    unsigned nreaders;
+    struct reg_reader readers[REG_MAX_READERS];
+};
+
+static inline struct reg_snap *reg__alloc(uint32_t n)
+{
+    struct reg_snap *s = (struct reg_snap *)malloc(sizeof(*s) + (size_t)n * sizeof(void *));
+    if (s) {
+        s->next_retired = NULL;
+        s->retired_epoch = 0;
+        s->n = n;
+    }
+    return s;
+}
+
+static inline int reg_init(struct registry *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->epoch = 1;                   // 슬롯의 0 은 "읽는 중 아님" 이라 epoch 는 1 부터
+    r->cur = reg__alloc(0);
+    if (!r->cur)
+        return -1;
+    return pthread_mutex_init(&r->wlock, NULL) == 0 ? 0 : -1;
+}
+
+// 읽는 스레드 슬롯을 하나 받는다. 다 찼으면 NULL
+static inline struct reg_reader *reg_reader_register(struct registry *r)
+{
+    unsigned i = __atomic_fetch_add(&r->nreaders, 1, __ATOMIC_ACQ_REL);
+    if (i >= REG_MAX_READERS) {
+        __atomic_fetch_sub(&r->nreaders, 1, __ATOMIC_ACQ_REL);
+        return NULL;
+    }
+    return &r->readers[i];
+}
+
+// 지금 스냅샷을 얻는다. reg_exit 전까지 해제되지 않는다. (한 스레드에서 겹쳐 부르지 않는다)
+static inline const struct reg_snap *reg_enter(struct registry *r, struct reg_reader *rd)
+{
+    __atomic_store_n(&rd->epoch, __atomic_load_n(&r->epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&r->cur, __ATOMIC_SEQ_CST);  // 슬롯을 적은 뒤에 읽어야 한다
+}
+
+static inline void reg_exit(struct reg_reader *rd)
+{
+    __atomic_store_n(&rd->epoch, 0, __ATOMIC_RELEASE);
+}
+
+// 아무도 보고 있지 않은 옛 스냅샷을 해제한다 (wlock 을 잡고 부름)
+static inline void reg__reclaim(struct registry *r)
+{
+    uint64_t min = UINT64_MAX;
+    unsigned n = __atomic_load_n(&r->nreaders, __ATOMIC_ACQUIRE);
+    if (n > REG_MAX_READERS)
+        n = REG_MAX_READERS;
+    for (unsigned i = 0; i < n; i++) {
+        uint64_t e = __atomic_load_n(&r->readers[i].epoch, __ATOMIC_SEQ_CST);
+        if (e && e < min)
+            min = e;
+    }
+    struct reg_snap **pp = &r->retired;
+    while (*pp) {
+        struct reg_snap *s = *pp;
+        if (s->retired_epoch <= min) {
+            *pp = s->next_retired;
+            r->nretired--;
+            free(s);
+        } else {
+            pp = &s->next_retired;
+        }
+    }
+}
+
+// 새 스냅샷을 공개하고 옛 것을 회수 대기 목록에 넣는다 (wlock 을 잡고 부름)
+static inline void reg__publish(struct registry *r, struct reg_snap *s)
+{
+    struct reg_snap *old = __atomic_exchange_n(&r->cur, s, __ATOMIC_SEQ_CST);
+    old->retired_epoch = __atomic_add_fetch(&r->epoch, 1, __ATOMIC_SEQ_CST);
+    old->next_retired = r->retired;
+    r->retired = old;
+    r->nretired++;
+    reg__reclaim(r);
+}
+
+static inline int reg_add(struct registry *r, void *item)
+{
+    pthread_mutex_lock(&r->wlock);
+    struct reg_snap *cur = r->cur;
+    struct reg_snap *s = reg__alloc(cur->n + 1);
+    if (!s) {
+        pthread_mutex_unlock(&r->wlock);
+        return -1;
+    }
+    memcpy(s->items, cur->items, (size_t)cur->n * sizeof(void *));
+    s->items[cur->n] = item;
+    reg__publish(r, s);
+    pthread_mutex_unlock(&r->wlock);
+    return 0;
+}
+
+// 없는 항목이면 -1
+static inline int reg_remove(struct registry *r, void *item)
+{
+    pthread_mutex_lock(&r->wlock);
+    struct reg_snap *cur = r->cur;
+    uint32_t at = 0;
+    while (at < cur->n && cur->items[at] != item)
+        at++;
+    struct reg_snap *s = at < cur->n ? reg__alloc(cur->n - 1) : NULL;
+    if (!s) {
+        pthread_mutex_unlock(&r->wlock);
+        return -1;
+    }
+    memcpy(s->items, cur->items, (size_t)at * sizeof(void *));
+    memcpy(s->items + at, cur->items + at + 1, (size_t)(cur->n - at - 1) * sizeof(void *));
+    reg__publish(r, s);
+    pthread_mutex_unlock(&r->wlock);
+    return 0;
+}
+
+// 읽는 스레드가 모두 끝난 뒤에 부른다
+static inline void reg_destroy(struct registry *r)
+{
+    while (r->retired) {
+        struct reg_snap *s = r->retired;
+        r->retired = s->next_retired;
+        free(s);
+    }
+    free(r->cur);
+    r->cur = NULL;
+    pthread_mutex_destroy(&r->wlock);
+}
+
+#endif
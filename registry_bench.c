@@ -0,0 +1,239 @@
+/* registry_bench.c — 채팅 멤버 목록 경합 벤치마크
+ *
+ *   gcc -O2 -pthread -o registry_bench registry_bench.c
+ *   ./registry_bench --senders 8 --members 1000 --churn 1000 --duration 5
+ *
+ * 보내는 스레드 N 개가 쉬지 않고 "브로드캐스트"(멤버 목록을 훑으며 멤버마다 필드 하나를 읽음)를 하고,
+ * churn 스레드 하나가 초당 --churn 번 퇴장+입장을 한다. 두 방식을 같은 조건으로 돌려 비교한다.
+ *   - mutex:    예전 chat_server_multi.c 처럼 전역 뮤텍스 + 배열. 브로드캐스트도 입장/퇴장도 같은 락을 잡는다
+ *   - snapshot: registry.h. 브로드캐스트는 락 없이 스냅샷을 읽고, 입장/퇴장만 새 스냅샷을 만든다
+ * 결과: 초당 브로드캐스트 수(전체, 스레드당), 입장/퇴장 한 번에 걸린 시간 분포
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+#include "registry.h"
+#include "hdr_histogram.h"
+
+// 멤버 하나. 브로드캐스트는 멤버마다 id 를 읽어 더하는 것으로 fanout(큐에 포인터 넣기) 비용을 흉내 낸다.
+// 공유 카운터에 쓰면 방식과 상관없이 캐시 라인 경합이 결과를 덮으므로 읽기만 한다
+struct member {
+    int id;
+};
+
+enum { MODE_MUTEX, MODE_SNAPSHOT };
+static const char *const mode_names[] = { "mutex", "snapshot" };
+
+static int senders = 4;
+static int nmembers = 1000;
+static double churn = 1000;         // 초당 퇴장+입장 횟수 (0 이면 쉬지 않고)
+static double duration = 5;
+
+static struct member *members;
+static int stop;                    // 보내는 스레드 종료 신호
+
+// mutex 방식의 상태 (예전 client_socks[] + clients_mutex)
+static pthread_mutex_t list_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct member **list;
+static int list_count;
+
+static struct registry reg;
+
+struct sender {
+    pthread_t tid;
+    int mode;
+    uint64_t broadcasts;
+    uint64_t sink;                  // 최적화로 루프가 사라지지 않게
+} __attribute__((aligned(64)));
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void *sender_main(void *arg)
+{
+    struct sender *s = arg;
+    uint64_t n = 0, sum = 0;
+    if (s->mode == MODE_MUTEX) {
+        while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+            pthread_mutex_lock(&list_mutex);
+            for (int i = 0; i < list_count; i++)
+                sum += list[i]->id;
+            pthread_mutex_unlock(&list_mutex);
+            n++;
+        }
+    } else {
+        struct reg_reader *rd = reg_reader_register(&reg);
+        if (!rd) {
+            fprintf(stderr, "too many senders (REG_MAX_READERS=%d)\n", REG_MAX_READERS);
+            exit(1);
+        }
+        while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+            const struct reg_snap *snap = reg_enter(&reg, rd);
+            for (uint32_t i = 0; i < snap->n; i++)
+                sum += ((const struct member *)snap->items[i])->id;
+            reg_exit(rd);
+            n++;
+        }
+    }
+    s->broadcasts = n;
+    s->sink = sum;
+    return NULL;
+}
+
+static void mutex_remove(struct member *m)
+{
+    pthread_mutex_lock(&list_mutex);
+    for (int i = 0; i < list_count; i++) {
+        if (list[i] == m) {
+            list[i] = list[--list_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&list_mutex);
+}
+
+static void mutex_add(struct member *m)
+{
+    pthread_mutex_lock(&list_mutex);
+    list[list_count++] = m;
+    pthread_mutex_unlock(&list_mutex);
+}
+
+// 퇴장과 입장을 번갈아 한다. 각 작업에 걸린 시간을 기록한다
+static void churn_loop(int mode, struct hdr_histogram *h, uint64_t end)
+{
+    uint64_t interval = churn > 0 ? (uint64_t)(1e9 / churn) : 0;
+    uint64_t next = now_ns();
+    unsigned seed = 1;
+    while (now_ns() < end) {
+        if (interval) {
+            next += interval;
+            uint64_t t = now_ns();
+            if (next > t) {
+                struct timespec ts = { (time_t)((next - t) / 1000000000ull), (long)((next - t) % 1000000000ull) };
+                nanosleep(&ts, NULL);
+            }
+        }
+        struct member *m = &members[rand_r(&seed) % nmembers];
+        uint64_t t0 = now_ns();
+        if (mode == MODE_MUTEX) mutex_remove(m);
+        else reg_remove(&reg, m);
+        uint64_t t1 = now_ns();
+        if (mode == MODE_MUTEX) mutex_add(m);
+        else reg_add(&reg, m);
+        uint64_t t2 = now_ns();
+        hdr_record(h, t1 - t0);
+        hdr_record(h, t2 - t1);
+    }
+}
+
+static void run(int mode)
+{
+    if (mode == MODE_MUTEX) {
+        list_count = 0;
+        for (int i = 0; i < nmembers; i++)
+            list[list_count++] = &members[i];
+    } else {
+        if (reg_init(&reg) != 0) {
+            perror("reg_init");
+            exit(1);
+        }
+        for (int i = 0; i < nmembers; i++)
+            reg_add(&reg, &members[i]);
+    }
+
+    struct sender *ss = aligned_alloc(64, sizeof(*ss) * senders);
+    __atomic_store_n(&stop, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < senders; i++) {
+        ss[i].mode = mode;
+        ss[i].broadcasts = 0;
+        if (pthread_create(&ss[i].tid, NULL, sender_main, &ss[i]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    struct hdr_histogram *h = malloc(sizeof(*h));
+    hdr_init(h);
+    uint64_t start = now_ns();
+    churn_loop(mode, h, start + (uint64_t)(duration * 1e9));
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    uint64_t total = 0;
+    for (int i = 0; i < senders; i++) {
+        pthread_join(ss[i].tid, NULL);
+        total += ss[i].broadcasts;
+    }
+    double secs = (now_ns() - start) / 1e9;
+
+    printf("%-8s  broadcasts %10.0f/s (%9.0f/s per sender, %6.1f M deliveries/s)\n",
+           mode_names[mode], total / secs, total / secs / senders, total * (double)nmembers / secs / 1e6);
+    printf("          join/leave %8llu ops  p50 %.1f us  p99 %.1f us  max %.1f us\n",
+           (unsigned long long)h->total,
+           hdr_percentile(h, 50.0) / 1e3, hdr_percentile(h, 99.0) / 1e3, h->max / 1e3);
+
+    if (mode == MODE_SNAPSHOT)
+        reg_destroy(&reg);
+    free(h);
+    free(ss);
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage : %s [--senders N] [--members M] [--churn OPS_PER_SEC] [--duration SEC] [--mode mutex|snapshot|both]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_opts[] = {
+        {"senders", required_argument, NULL, 's'},
+        {"members", required_argument, NULL, 'm'},
+        {"churn", required_argument, NULL, 'c'},
+        {"duration", required_argument, NULL, 'd'},
+        {"mode", required_argument, NULL, 'o'},
+        {NULL, 0, NULL, 0}
+    };
+    int modes = 3;                  // 비트 0: mutex, 비트 1: snapshot
+    int ch;
+    while ((ch = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+        switch (ch) {
+        case 's': senders = atoi(optarg); break;
+        case 'm': nmembers = atoi(optarg); break;
+        case 'c': churn = atof(optarg); break;
+        case 'd': duration = atof(optarg); break;
+        case 'o':
+            if (strcmp(optarg, "mutex") == 0) modes = 1;
+            else if (strcmp(optarg, "snapshot") == 0) modes = 2;
+            else if (strcmp(optarg, "both") == 0) modes = 3;
+            else { usage(argv[0]); exit(1); }
+            break;
+        default: usage(argv[0]); exit(1);
+        }
+    }
+    if (optind != argc || senders <= 0 || nmembers <= 0 || churn < 0 || duration <= 0) {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    members = calloc(nmembers, sizeof(*members));
+    list = calloc(nmembers, sizeof(*list));
+    if (!members || !list) {
+        perror("calloc");
+        exit(1);
+    }
+    for (int i = 0; i < nmembers; i++)
+        members[i].id = i;
+
+    printf("senders %d, members %d, churn %.0f/s, %.0f s each\n", senders, nmembers, churn, duration);
+    if (modes & 1) run(MODE_MUTEX);
+    if (modes & 2) run(MODE_SNAPSHOT);
+    return 0;
+}
@@ -0,0 +1,1136 @@
+/* rudp.h — UDP 위의 다중 스트림 신뢰 전송 (header-only, C/C++ 공용)
+ *
+ * 사용법:
+ *   struct rudp_conn *c = rudp_conn_new(conn_id, &rudp_cubic, rudp_now_us());  // 또는 &rudp_reno
+ *   c->on_data = fn; c->arg = arg;               // 스트림마다 순서대로 맞춰진 데이터 (fin 이면 끝)
+ *   rudp_write(c, sid, data, len);               // 스트림 sid 에 보낼 데이터 추가 (복사한다)
+ *   rudp_finish(c, sid);                         // 스트림 sid 의 끝
+ *   rudp_pause(c, sid); rudp_resume(c);          // 받은 것을 넘겨주기를 멈춘다 / 다시 넘겨준다
+ *
+ *   rudp_input(c, pkt, len, now);                // 받은 데이터그램 하나
+ *   while ((n = rudp_output(c, buf, sizeof(buf), now)) > 0) send(fd, buf, n, 0);
+ *   uint64_t t = rudp_timeout(c, now);           // 이 시각에 rudp_on_timer + rudp_output 을 다시 부른다
+ *   rudp_on_timer(c, now);
+ *
+ * 소켓은 건드리지 않는다. 받은 데이터그램을 넣고 보낼 데이터그램을 꺼내 가는 것은 쓰는 쪽이 한다.
+ *
+ * 구조:
+ *   - 데이터그램 = 머리(magic, conn_id, 패킷 번호) + 프레임들. 프레임은 STREAM(sid, offset, 데이터, fin),
+ *     ACK, PING, CLOSE 이다. (QUIC 과 같은 모양을 줄인 것)
+ *   - 패킷 번호는 보낼 때마다 하나씩 늘고 재전송도 새 번호로 나간다. 그래서 ACK 가 원래 것인지 재전송인지
+ *     헷갈리지 않고 RTT 를 늘 잴 수 있다. 잃은 것은 패킷이 아니라 그 안의 스트림 구간을 다시 보낸다.
+ *   - ACK 는 받은 패킷 번호 구간을 최대 RUDP_ACK_RANGES 개까지 실어 보내는 selective ACK 다.
+ *     ack 를 부르는 패킷 2 개마다, 아니면 RUDP_ACK_DELAY_US 안에 보낸다. 보낼 데이터가 있으면 거기에 얹는다.
+ *   - 손실 판정 (RFC 9002): 더 뒤의 패킷이 3 개 이상 ACK 되었거나, 더 뒤의 것이 ACK 된 지 RTT 의 9/8 이 지났으면 잃은 것이다.
+ *     ACK 가 아예 없으면 PTO 뒤에 probe 두 개를 혼잡 창과 상관없이 보낸다 (PTO 는 매번 두 배).
+ *   - 스트림은 받는 쪽에서 따로 맞춘다. 한 스트림의 구멍은 그 스트림만 세우고 다른 스트림은 계속 넘겨준다.
+ *   - 흐름 제어는 따로 광고하지 않는다. 보내는 쪽이 스트림마다 (연속으로 ACK 된 곳 + RUDP_STREAM_WIN) 까지만 보내므로,
+ *     받는 쪽은 넘겨준 곳부터 RUDP_STREAM_WIN 크기의 링 하나로 순서가 어긋난 데이터를 모두 담을 수 있다.
+ *     순서대로 온 것은 링을 거치지 않고 바로 넘겨주고, 링은 구멍이 있거나 멈춘(rudp_pause) 스트림만 잡는다.
+ *     링은 연결마다 rbuf_max 개, rbuf_pool 을 주면 그 수만큼까지다. 담을 자리가 없는 STREAM (링을 못 잡았거나,
+ *     멈춘 사이 창 밖으로 온 것) 이 든 패킷은 ACK 하지 않고 버린다. 보내는 쪽은 잃은 것으로 보고 나중에 다시 보낸다.
+ *   - 혼잡 제어는 struct rudp_cc_ops 로 갈아 끼운다. Reno 와 CUBIC (RFC 9438) 이 들어 있다.
+ *     혼잡 신호는 RTT 하나에 한 번만 반영한다 (recovery 시작 뒤에 보낸 패킷을 잃었을 때만).
+ *   - 페이싱: cwnd / srtt 의 1.25 배 (slow start 는 2 배) 속도의 토큰 버킷. 버킷은 1ms 분량(최소 10 패킷)까지 쌓인다.
+ *     (호출하는 쪽 타이머가 ms 단위여도 그 사이 보낼 몫을 한 번에 내보낼 수 있게)
+ */
+#ifndef RUDP_H
+#define RUDP_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define RUDP_MAGIC 0xc3
+#define RUDP_MAX_PKT 1200                 // 데이터그램 최대 크기 (IPv6 최소 MTU 에 맞춘 QUIC 의 기본값)
+#define RUDP_HDR 13                       // magic u8 + conn_id u32 + 패킷 번호 u64
+#define RUDP_STREAM_HDR 13                // type u8 + sid u16 + offset u64 + len u16
+#define RUDP_MAX_STREAMS 64
+#define RUDP_STREAM_WIN (1u << 20)        // 스트림마다 받는 쪽이 담아 두는 최대 바이트
+#define RUDP_RBUF_MAX 8                   // 연결마다 동시에 잡아 둘 수 있는 수신 링 수 (rbuf_max 의 기본값)
+#define RUDP_SENT_CAP 16384               // 동시에 날아가 있을 수 있는 패킷 수 (2의 거듭제곱)
+#define RUDP_SENT_INIT 64                 // 보낸 패킷 링의 처음 크기. 모자라면 RUDP_SENT_CAP 까지 두 배씩
+#define RUDP_ACK_RANGES 32
+#define RUDP_ACK_DELAY_US 1000
+#define RUDP_INIT_RTT_US 100000
+#define RUDP_GRANULARITY_US 1000
+#define RUDP_INIT_CWND (10 * RUDP_MAX_PKT)
+#define RUDP_MIN_CWND (2 * RUDP_MAX_PKT)
+#define RUDP_PACE_QUANTUM_US 1000
+#define RUDP_IDLE_US 30000000ull          // 이만큼 아무것도 받지 못하면 연결을 버린다 (rudp_idle)
+
+enum { RUDP_F_STREAM = 0x10, RUDP_F_FIN = 0x01, RUDP_F_ACK = 0x02, RUDP_F_PING = 0x03, RUDP_F_CLOSE = 0x04 };
+
+// 겹치지 않는 [lo, hi) 구간들을 오름차순으로
+struct rudp_ranges {
+    uint64_t (*r)[2];
+    int n, cap;
+};
+
+struct rudp_stream {
+    // 보내기
+    uint8_t *sbuf;                        // [sbase, send_end) 의 바이트
+    size_t scap;
+    uint64_t sbase, send_end;
+    uint64_t snext;                       // 아직 한 번도 안 보낸 첫 offset
+    uint64_t una;                         // 여기까지 연속으로 ACK 됨
+    uint64_t fin_off;
+    uint8_t fin_set, fin_sent, fin_acked, retx_fin;
+    struct rudp_ranges acked;             // una 뒤에 ACK 된 구간
+    struct rudp_ranges retx;              // 다시 보낼 구간
+    // 받기
+    uint8_t *rbuf;                        // RUDP_STREAM_WIN 링. offset % WIN 자리에 둔다. 쌓인 것이 없으면 NULL
+    uint64_t rdeliv;                      // 여기까지 on_data 로 넘겨줌
+    uint64_t rfin_off;
+    uint8_t rfin, rfin_delivered;
+    struct rudp_ranges rcvd;              // rdeliv 뒤에 받아 둔 구간
+};
+
+// 보낸 패킷 하나. 스트림 조각은 패킷마다 최대 하나다
+struct rudp_sent {
+    uint64_t pn;
+    uint64_t time;
+    uint64_t off;
+    uint32_t bytes;
+    uint16_t sid, len;
+    uint8_t state;                        // RUDP_S_*
+    uint8_t eliciting;                    // ACK 를 불러야 하는 패킷 (ACK 만 든 것은 아니다)
+    uint8_t has_data, fin;
+};
+
+enum { RUDP_S_FREE, RUDP_S_INFLIGHT, RUDP_S_DONE };
+
+struct rudp_conn;
+
+// 혼잡 제어기. cwnd/ssthresh 와 알고리즘별 상태는 conn->cc 에 있다
+struct rudp_cc_ops {
+    const char *name;
+    void (*init)(struct rudp_conn *c);
+    void (*on_ack)(struct rudp_conn *c, uint32_t bytes, uint64_t now);
+    void (*on_congestion)(struct rudp_conn *c, uint64_t now);
+};
+
+struct rudp_cc {
+    uint64_t cwnd, ssthresh;
+    uint64_t recovery_start;              // 이 시각 전에 보낸 패킷의 손실은 같은 혼잡 사건이다
+    uint64_t ca_acc;                      // Reno: 혼잡 회피 중 모인 ACK 바이트
+    double w_max, k, origin, w_est;       // CUBIC (MSS 단위)
+    uint64_t epoch;                       // CUBIC: 이번 증가 구간 시작 (0 이면 아직)
+};
+
+struct rudp_stats {
+    uint64_t pkts_sent, pkts_lost, pkts_recv, bytes_sent;
+    uint64_t pto_count;                   // PTO 만료 횟수
+    uint64_t stream_bytes_acked;          // 처음 ACK 된 스트림 바이트 (재전송 포함 한 번만)
+    uint64_t bytes_retx;                  // 다시 보낸 스트림 바이트
+};
+
+struct rudp_conn {
+    uint32_t id;
+    const struct rudp_cc_ops *cc_ops;
+    struct rudp_cc cc;
+    void (*on_data)(void *arg, struct rudp_conn *c, uint32_t sid, const uint8_t *data, size_t len, int fin);
+    void *arg;
+
+    // 보내기
+    uint64_t next_pn;
+    uint64_t una_pn;                      // 이보다 작은 패킷은 모두 결론이 났다 (ACK 또는 손실)
+    uint64_t largest_acked;
+    uint8_t has_acked;
+    struct rudp_sent *sent;               // pn & (sent_cap - 1)
+    uint32_t sent_cap;
+    uint64_t bytes_in_flight;
+    uint64_t unacked;                     // 모든 스트림에서 rudp_write 했지만 아직 ACK 되지 않은 바이트
+    uint64_t last_eliciting;
+    uint64_t loss_time;                   // 시간 기준 손실 판정을 다시 할 시각 (0 이면 없음)
+    int pto_backoff;
+    int probes;                           // PTO 뒤 혼잡 창을 무시하고 보낼 패킷 수
+    uint64_t srtt, rttvar, min_rtt, latest_rtt;
+    uint8_t has_rtt;
+    double pace_tokens;                   // 바이트. 음수면 빚
+    uint64_t pace_last;
+    int rr;                               // 다음에 볼 스트림 (round-robin)
+    uint8_t send_close;
+
+    // 받기
+    struct rudp_ranges rx_pns;            // 받은 패킷 번호 (최근 RUDP_ACK_RANGES 구간)
+    uint64_t largest_rx_time;
+    int ack_pending;                      // 마지막 ACK 뒤에 받은 ack 를 부르는 패킷 수
+    uint64_t ack_deadline;
+    uint64_t last_rx;
+    uint8_t closed;                       // 상대가 CLOSE 를 보냈다
+    uint64_t rpaused;                     // 비트 sid 가 서 있는 스트림은 넘겨주지 않고 쌓아 둔다 (rudp_pause)
+    int rbufs, rbuf_max;                  // 잡고 있는 수신 링 수와 상한 (기본 RUDP_RBUF_MAX)
+    int *rbuf_pool;                       // NULL 이 아니면 여러 연결이 나눠 쓰는 남은 링 수 (링을 잡을 때 빼고 놓을 때 더한다)
+
+    struct rudp_stream streams[RUDP_MAX_STREAMS];
+    struct rudp_stats stats;
+};
+
+static inline uint64_t rudp_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/* ---- 구간 집합 ---- */
+
+static inline void rudp__ranges_free(struct rudp_ranges *rs)
+{
+    free(rs->r);
+    rs->r = NULL;
+    rs->n = rs->cap = 0;
+}
+
+// [lo, hi) 를 더하고 겹치거나 맞닿은 구간과 합친다
+static inline int rudp__ranges_add(struct rudp_ranges *rs, uint64_t lo, uint64_t hi)
+{
+    if (lo >= hi)
+        return 0;
+    int i = rs->n;
+    while (i > 0 && rs->r[i - 1][0] > lo)     // 새 구간은 대개 맨 뒤에 붙는다
+        i--;
+    if (i > 0 && rs->r[i - 1][1] >= lo) {      // 앞 구간과 합친다
+        i--;
+        if (hi <= rs->r[i][1])
+            return 0;
+        rs->r[i][1] = hi;
+    } else {
+        if (rs->n == rs->cap) {
+            int cap = rs->cap ? rs->cap * 2 : 8;
+            void *p = realloc(rs->r, cap * sizeof(*rs->r));
+            if (!p)
+                return -1;
+            rs->r = (uint64_t (*)[2])p;
+            rs->cap = cap;
+        }
+        memmove(rs->r + i + 1, rs->r + i, (rs->n - i) * sizeof(*rs->r));
+        rs->r[i][0] = lo;
+        rs->r[i][1] = hi;
+        rs->n++;
+    }
+    int j = i + 1;                             // 뒤 구간들을 삼킨다
+    while (j < rs->n && rs->r[j][0] <= rs->r[i][1]) {
+        if (rs->r[j][1] > rs->r[i][1])
+            rs->r[i][1] = rs->r[j][1];
+        j++;
+    }
+    if (j > i + 1) {
+        memmove(rs->r + i + 1, rs->r + j, (rs->n - j) * sizeof(*rs->r));
+        rs->n -= j - i - 1;
+    }
+    return 0;
+}
+
+static inline void rudp__ranges_drop_front(struct rudp_ranges *rs, int k)
+{
+    memmove(rs->r, rs->r + k, (rs->n - k) * sizeof(*rs->r));
+    rs->n -= k;
+}
+
+static inline int rudp__ranges_has(const struct rudp_ranges *rs, uint64_t v)
+{
+    for (int i = rs->n - 1; i >= 0; i--) {
+        if (v >= rs->r[i][1])
+            return 0;
+        if (v >= rs->r[i][0])
+            return 1;
+    }
+    return 0;
+}
+
+/* ---- 혼잡 제어 ---- */
+
+static inline void rudp__cc_init(struct rudp_conn *c)
+{
+    memset(&c->cc, 0, sizeof(c->cc));
+    c->cc.cwnd = RUDP_INIT_CWND;
+    c->cc.ssthresh = UINT64_MAX;
+}
+
+static inline void rudp__reno_on_ack(struct rudp_conn *c, uint32_t bytes, uint64_t now)
+{
+    (void)now;
+    struct rudp_cc *cc = &c->cc;
+    if (cc->cwnd < cc->ssthresh) {
+        cc->cwnd += bytes;
+        return;
+    }
+    cc->ca_acc += bytes;                       // cwnd 만큼 ACK 될 때마다 MSS 하나
+    if (cc->ca_acc >= cc->cwnd) {
+        cc->ca_acc -= cc->cwnd;
+        cc->cwnd += RUDP_MAX_PKT;
+    }
+}
+
+static inline void rudp__reno_on_congestion(struct rudp_conn *c, uint64_t now)
+{
+    (void)now;
+    struct rudp_cc *cc = &c->cc;
+    cc->cwnd /= 2;
+    if (cc->cwnd < RUDP_MIN_CWND)
+        cc->cwnd = RUDP_MIN_CWND;
+    cc->ssthresh = cc->cwnd;
+    cc->ca_acc = 0;
+}
+
+static const struct rudp_cc_ops rudp_reno = {
+    "reno", rudp__cc_init, rudp__reno_on_ack, rudp__reno_on_congestion
+};
+
+#define RUDP_CUBIC_C 0.4
+#define RUDP_CUBIC_BETA 0.7
+
+// W(t) = C (t - K)^3 + W_max. 혼잡 직후 W_max * beta 에서 시작해 K 초 뒤 W_max 로 돌아오고,
+// 그 뒤로는 다시 빠르게 늘어난다. 같은 시간 동안 Reno 가 늘렸을 양(w_est)보다 작으면 그쪽을 따른다
+static inline void rudp__cubic_on_ack(struct rudp_conn *c, uint32_t bytes, uint64_t now)
+{
+    struct rudp_cc *cc = &c->cc;
+    if (cc->cwnd < cc->ssthresh) {
+        cc->cwnd += bytes;
+        return;
+    }
+    double mss = RUDP_MAX_PKT;
+    double cwnd = cc->cwnd / mss;
+    if (!cc->epoch) {
+        cc->epoch = now;
+        cc->k = cwnd < cc->w_max ? cbrt((cc->w_max - cwnd) / RUDP_CUBIC_C) : 0;
+        cc->origin = cwnd < cc->w_max ? cc->w_max : cwnd;
+        cc->w_est = cwnd;
+    }
+    double rtt = (c->has_rtt ? c->srtt : RUDP_INIT_RTT_US) / 1e6;
+    double t = (now - cc->epoch) / 1e6 + rtt - cc->k;
+    double target = cc->origin + RUDP_CUBIC_C * t * t * t;
+    cc->w_est += 3.0 * (1 - RUDP_CUBIC_BETA) / (1 + RUDP_CUBIC_BETA) * (bytes / mss) / cwnd;
+    if (target < cc->w_est)
+        target = cc->w_est;
+    if (target > 1.5 * cwnd)
+        target = 1.5 * cwnd;
+    if (target > cwnd)
+        cc->cwnd += (uint64_t)((target - cwnd) / cwnd * bytes);
+}
+
+static inline void rudp__cubic_on_congestion(struct rudp_conn *c, uint64_t now)
+{
+    (void)now;
+    struct rudp_cc *cc = &c->cc;
+    double cwnd = cc->cwnd / (double)RUDP_MAX_PKT;
+    // fast convergence: 지난번보다 낮은 곳에서 또 잃었으면 자리를 내준다
+    cc->w_max = cwnd < cc->w_max ? cwnd * (1 + RUDP_CUBIC_BETA) / 2 : cwnd;
+    cc->cwnd = (uint64_t)(cc->cwnd * RUDP_CUBIC_BETA);
+    if (cc->cwnd < RUDP_MIN_CWND)
+        cc->cwnd = RUDP_MIN_CWND;
+    cc->ssthresh = cc->cwnd;
+    cc->epoch = 0;
+}
+
+static const struct rudp_cc_ops rudp_cubic = {
+    "cubic", rudp__cc_init, rudp__cubic_on_ack, rudp__cubic_on_congestion
+};
+
+/* ---- 연결 ---- */
+
+static inline struct rudp_conn *rudp_conn_new(uint32_t id, const struct rudp_cc_ops *cc, uint64_t now)
+{
+    struct rudp_conn *c = (struct rudp_conn *)calloc(1, sizeof(*c));
+    if (!c)
+        return NULL;
+    c->sent_cap = RUDP_SENT_INIT;
+    c->sent = (struct rudp_sent *)calloc(c->sent_cap, sizeof(*c->sent));
+    if (!c->sent) {
+        free(c);
+        return NULL;
+    }
+    c->id = id;
+    c->cc_ops = cc;
+    cc->init(c);
+    c->srtt = RUDP_INIT_RTT_US;
+    c->rttvar = RUDP_INIT_RTT_US / 2;
+    c->last_rx = now;
+    c->pace_last = now;
+    c->rbuf_max = RUDP_RBUF_MAX;
+    return c;
+}
+
+static inline void rudp__rbuf_put(struct rudp_conn *c, struct rudp_stream *s)
+{
+    if (!s->rbuf)
+        return;
+    free(s->rbuf);
+    s->rbuf = NULL;
+    c->rbufs--;
+    if (c->rbuf_pool)
+        (*c->rbuf_pool)++;
+}
+
+static inline void rudp_conn_free(struct rudp_conn *c)
+{
+    for (int i = 0; i < RUDP_MAX_STREAMS; i++) {
+        struct rudp_stream *s = &c->streams[i];
+        free(s->sbuf);
+        rudp__rbuf_put(c, s);
+        rudp__ranges_free(&s->acked);
+        rudp__ranges_free(&s->retx);
+        rudp__ranges_free(&s->rcvd);
+    }
+    rudp__ranges_free(&c->rx_pns);
+    free(c->sent);
+    free(c);
+}
+
+// 데이터그램 머리의 conn_id. rudp 데이터그램이 아니면 -1
+static inline int64_t rudp_conn_id(const uint8_t *p, size_t len)
+{
+    if (len < RUDP_HDR || p[0] != RUDP_MAGIC)
+        return -1;
+    return (int64_t)((uint32_t)p[1] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 8 | p[4]);
+}
+
+// 처음 보는 conn_id 의 데이터그램으로 연결을 만들어도 되는가: 형식이 맞고 STREAM 이나 PING 을 실었다.
+// ACK/CLOSE 만 든 것이나 빈 것은 살아 있는 연결이 아니면 받을 이유가 없다
+static inline int rudp_opens_conn(const uint8_t *p, size_t len)
+{
+    if (rudp_conn_id(p, len) == -1)
+        return 0;
+    int opens = 0;
+    size_t i = RUDP_HDR;
+    while (i < len) {
+        uint8_t t = p[i];
+        if ((t & ~RUDP_F_FIN) == RUDP_F_STREAM) {
+            if (len - i < RUDP_STREAM_HDR)
+                return 0;
+            size_t n = (size_t)p[i + 11] << 8 | p[i + 12];
+            if (len - i - RUDP_STREAM_HDR < n)
+                return 0;
+            i += RUDP_STREAM_HDR + n;
+            opens = 1;
+        } else if (t == RUDP_F_ACK) {
+            int nr = len - i >= 14 ? p[i + 13] : 0;
+            size_t n = 17 + (size_t)(nr ? nr - 1 : 0) * 8;
+            if (len - i - 1 < n)
+                return 0;
+            i += 1 + n;
+        } else if (t == RUDP_F_PING) {
+            i++;
+            opens = 1;
+        } else if (t == RUDP_F_CLOSE) {
+            i++;
+        } else {
+            return 0;
+        }
+    }
+    return opens;
+}
+
+static inline int rudp_write(struct rudp_conn *c, uint32_t sid, const void *data, size_t len)
+{
+    if (sid >= RUDP_MAX_STREAMS || c->streams[sid].fin_set)
+        return -1;
+    struct rudp_stream *s = &c->streams[sid];
+    size_t used = s->send_end - s->sbase;
+    if (used + len > s->scap) {
+        size_t cap = s->scap ? s->scap : 64 * 1024;
+        while (cap < used + len)
+            cap *= 2;
+        void *p = realloc(s->sbuf, cap);
+        if (!p)
+            return -1;
+        s->sbuf = (uint8_t *)p;
+        s->scap = cap;
+    }
+    memcpy(s->sbuf + used, data, len);
+    s->send_end += len;
+    c->unacked += len;
+    return 0;
+}
+
+static inline int rudp_finish(struct rudp_conn *c, uint32_t sid)
+{
+    if (sid >= RUDP_MAX_STREAMS || c->streams[sid].fin_set)
+        return -1;
+    c->streams[sid].fin_set = 1;
+    c->streams[sid].fin_off = c->streams[sid].send_end;
+    return 0;
+}
+
+// 끝낸 스트림은 모두 끝까지 ACK 되었고, 끝나지 않은 스트림에는 ACK 를 기다리는 데이터가 없다
+static inline int rudp_all_acked(const struct rudp_conn *c)
+{
+    for (int i = 0; i < RUDP_MAX_STREAMS; i++) {
+        const struct rudp_stream *s = &c->streams[i];
+        if (s->una != s->send_end || (s->fin_set && !s->fin_acked))
+            return 0;
+    }
+    return 1;
+}
+
+// 스트림 sid 로 받은 것을 on_data 로 넘겨주지 않고 링에 쌓아 둔다. on_data 안에서 불러도 된다 (다음 조각부터)
+static inline void rudp_pause(struct rudp_conn *c, uint32_t sid)
+{
+    if (sid < RUDP_MAX_STREAMS)
+        c->rpaused |= 1ull << sid;
+}
+
+static inline void rudp__deliver(struct rudp_conn *c, uint32_t sid, struct rudp_stream *s);
+
+// 멈춘 스트림을 모두 다시 넘겨준다. 쌓여 있던 것은 여기서 바로 on_data 로 나간다
+static inline void rudp_resume(struct rudp_conn *c)
+{
+    uint64_t m = c->rpaused;
+    c->rpaused = 0;
+    for (uint32_t sid = 0; sid < RUDP_MAX_STREAMS; sid++)
+        if (m >> sid & 1)
+            rudp__deliver(c, sid, &c->streams[sid]);
+}
+
+static inline void rudp_close(struct rudp_conn *c)
+{
+    c->send_close = 1;
+}
+
+static inline int rudp_idle(const struct rudp_conn *c, uint64_t now)
+{
+    return now - c->last_rx > RUDP_IDLE_US;
+}
+
+/* ---- 보내는 쪽: ACK 와 손실 ---- */
+
+// 스트림의 send buffer 에서 ACK 된 앞부분을 버린다. 남은 것보다 많이 쌓였을 때만 옮긴다
+static inline void rudp__stream_acked(struct rudp_stream *s, uint64_t off, uint32_t len, int fin)
+{
+    if (fin)
+        s->fin_acked = 1;
+    if (off + len <= s->una)
+        return;
+    if (off <= s->una) {
+        s->una = off + len;
+    } else {
+        rudp__ranges_add(&s->acked, off, off + len);
+    }
+    int k = 0;
+    while (k < s->acked.n && s->acked.r[k][0] <= s->una) {
+        if (s->acked.r[k][1] > s->una)
+            s->una = s->acked.r[k][1];
+        k++;
+    }
+    if (k)
+        rudp__ranges_drop_front(&s->acked, k);
+    if (s->una == s->send_end) {                        // 다 ACK 되었으면 버퍼를 놓는다 (쓸 때 다시 잡는다)
+        free(s->sbuf);
+        s->sbuf = NULL;
+        s->scap = 0;
+        s->sbase = s->una;
+        return;
+    }
+    uint64_t dead = s->una - s->sbase;
+    uint64_t live = s->send_end - s->una;
+    if (dead >= 64 * 1024 && dead >= live) {
+        memmove(s->sbuf, s->sbuf + dead, live);
+        s->sbase = s->una;
+    }
+}
+
+static inline void rudp__on_lost(struct rudp_conn *c, struct rudp_sent *p)
+{
+    p->state = RUDP_S_DONE;
+    c->bytes_in_flight -= p->bytes;
+    c->stats.pkts_lost++;
+    if (p->has_data) {
+        struct rudp_stream *s = &c->streams[p->sid];
+        if (p->len && p->off + p->len > s->una)
+            rudp__ranges_add(&s->retx, p->off, p->off + p->len);
+        if (p->fin && !s->fin_acked)
+            s->retx_fin = 1;
+    }
+}
+
+// 보낸 패킷 링을 두 배로. 날아가 있는 것만 새 자리로 옮긴다
+static inline int rudp__sent_grow(struct rudp_conn *c)
+{
+    if (c->sent_cap >= RUDP_SENT_CAP)
+        return -1;
+    uint32_t cap = c->sent_cap * 2;
+    struct rudp_sent *ns = (struct rudp_sent *)calloc(cap, sizeof(*ns));
+    if (!ns)
+        return -1;
+    for (uint64_t pn = c->una_pn; pn < c->next_pn; pn++) {
+        const struct rudp_sent *p = &c->sent[pn & (c->sent_cap - 1)];
+        if (p->pn == pn && p->state == RUDP_S_INFLIGHT)
+            ns[pn & (cap - 1)] = *p;
+    }
+    free(c->sent);
+    c->sent = ns;
+    c->sent_cap = cap;
+    return 0;
+}
+
+static inline void rudp__advance_una(struct rudp_conn *c)
+{
+    while (c->una_pn < c->next_pn) {
+        const struct rudp_sent *p = &c->sent[c->una_pn & (c->sent_cap - 1)];
+        if (p->pn == c->una_pn && p->state == RUDP_S_INFLIGHT)
+            break;
+        c->una_pn++;
+    }
+}
+
+// RFC 9002 6.1: largest_acked 보다 3 개 이상 앞선 패킷, 또는 보낸 지 loss_delay 가 지난 패킷은 잃은 것
+static inline void rudp__detect_loss(struct rudp_conn *c, uint64_t now)
+{
+    if (!c->has_acked)
+        return;
+    uint64_t rtt = c->latest_rtt > c->srtt ? c->latest_rtt : c->srtt;
+    uint64_t delay = rtt * 9 / 8;
+    if (delay < RUDP_GRANULARITY_US)
+        delay = RUDP_GRANULARITY_US;
+    uint64_t lost_newest = 0;
+    int lost = 0;
+    c->loss_time = 0;
+    for (uint64_t pn = c->una_pn; pn < c->largest_acked; pn++) {
+        struct rudp_sent *p = &c->sent[pn & (c->sent_cap - 1)];
+        if (p->state != RUDP_S_INFLIGHT || p->pn != pn)
+            continue;
+        if (pn + 3 <= c->largest_acked || p->time + delay <= now) {
+            if (p->time > lost_newest)
+                lost_newest = p->time;
+            rudp__on_lost(c, p);
+            lost = 1;
+        } else if (!c->loss_time || p->time + delay < c->loss_time) {
+            c->loss_time = p->time + delay;
+        }
+    }
+    if (lost && lost_newest > c->cc.recovery_start) {   // 한 RTT 안의 손실은 한 번만 줄인다
+        c->cc.recovery_start = now;
+        c->cc_ops->on_congestion(c, now);
+    }
+    rudp__advance_una(c);
+}
+
+static inline void rudp__on_acked(struct rudp_conn *c, struct rudp_sent *p, uint64_t now)
+{
+    p->state = RUDP_S_DONE;
+    if (!p->eliciting)
+        return;
+    c->bytes_in_flight -= p->bytes;
+    if (p->has_data) {
+        struct rudp_stream *s = &c->streams[p->sid];
+        uint64_t una = s->una;
+        rudp__stream_acked(s, p->off, p->len, p->fin);
+        if (s->una > una) {
+            c->stats.stream_bytes_acked += s->una - una;
+            c->unacked -= s->una - una;
+        }
+    }
+    if (p->time > c->cc.recovery_start)          // recovery 중에 보낸 것이 아니면 창을 키운다
+        c->cc_ops->on_ack(c, p->bytes, now);
+}
+
+static inline void rudp__update_rtt(struct rudp_conn *c, uint64_t latest, uint64_t ack_delay)
+{
+    c->latest_rtt = latest;
+    if (!c->has_rtt) {
+        c->has_rtt = 1;
+        c->min_rtt = c->srtt = latest;
+        c->rttvar = latest / 2;
+        return;
+    }
+    if (latest < c->min_rtt)
+        c->min_rtt = latest;
+    uint64_t adj = latest;
+    if (adj >= c->min_rtt + ack_delay)
+        adj -= ack_delay;
+    uint64_t diff = c->srtt > adj ? c->srtt - adj : adj - c->srtt;
+    c->rttvar = (3 * c->rttvar + diff) / 4;
+    c->srtt = (7 * c->srtt + adj) / 8;
+}
+
+static inline uint64_t rudp__get(const uint8_t *p, int n)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < n; i++)
+        v = v << 8 | p[i];
+    return v;
+}
+
+static inline void rudp__put(uint8_t *p, uint64_t v, int n)
+{
+    for (int i = n - 1; i >= 0; i--, v >>= 8)
+        p[i] = (uint8_t)v;
+}
+
+// ACK 프레임: largest u64, ack_delay_us u32, 구간 수 u8, 첫 구간 길이 u32, (gap u32, len u32) * (구간 수 - 1)
+// 구간마다 [largest - len, largest]. 다음 구간의 largest = 앞 구간의 smallest - gap - 2
+static inline int rudp__on_ack_frame(struct rudp_conn *c, const uint8_t *p, size_t len, uint64_t now)
+{
+    if (len < 17)
+        return -1;
+    uint64_t largest = rudp__get(p, 8);
+    uint64_t delay = rudp__get(p + 8, 4);
+    int nr = p[12];
+    size_t need = 17 + (size_t)(nr ? nr - 1 : 0) * 8;
+    if (nr == 0 || len < need || largest >= c->next_pn)
+        return -1;
+    uint64_t hi = largest, lo;
+    uint64_t first = rudp__get(p + 13, 4);
+    if (first > hi)
+        return -1;
+    lo = hi - first;
+    int newly = 0;
+    if (!c->has_acked || largest > c->largest_acked) {
+        struct rudp_sent *lp = &c->sent[largest & (c->sent_cap - 1)];
+        if (lp->pn == largest && lp->state == RUDP_S_INFLIGHT && lp->eliciting)
+            rudp__update_rtt(c, now - lp->time, delay);
+        c->largest_acked = largest;
+        c->has_acked = 1;
+    }
+    for (int i = 0;; i++) {
+        uint64_t from = lo > c->una_pn ? lo : c->una_pn;     // una_pn 아래는 이미 결론이 났다
+        for (uint64_t pn = from; pn <= hi && hi >= c->una_pn; pn++) {
+            struct rudp_sent *sp = &c->sent[pn & (c->sent_cap - 1)];
+            if (sp->pn != pn || sp->state != RUDP_S_INFLIGHT)
+                continue;
+            rudp__on_acked(c, sp, now);
+            newly = 1;
+        }
+        if (i + 1 >= nr)
+            break;
+        const uint8_t *q = p + 17 + (size_t)i * 8;
+        uint64_t gap = rudp__get(q, 4), rl = rudp__get(q + 4, 4);
+        if (lo < gap + 2)
+            return -1;
+        hi = lo - gap - 2;
+        if (rl > hi)
+            return -1;
+        lo = hi - rl;
+    }
+    if (newly) {
+        c->pto_backoff = 0;
+        c->probes = 0;
+    }
+    rudp__detect_loss(c, now);
+    return 0;
+}
+
+/* ---- 받는 쪽 ---- */
+
+// 링에 쌓인 것을 이어지는 데까지 넘겨준다. 멈춘 스트림이면 (on_data 안에서 멈춰도) 거기서 그친다
+static inline void rudp__deliver(struct rudp_conn *c, uint32_t sid, struct rudp_stream *s)
+{
+    while (s->rcvd.n && s->rcvd.r[0][0] <= s->rdeliv && !(c->rpaused >> sid & 1)) {
+        uint64_t end = s->rcvd.r[0][1];
+        size_t pos = s->rdeliv % RUDP_STREAM_WIN;       // 링이 한 바퀴 돌면 두 번에 나눠 넘긴다
+        size_t n = end - s->rdeliv;
+        if (n > RUDP_STREAM_WIN - pos)
+            n = RUDP_STREAM_WIN - pos;
+        s->rdeliv += n;
+        if (s->rdeliv == end)
+            rudp__ranges_drop_front(&s->rcvd, 1);
+        if (c->on_data)
+            c->on_data(c->arg, c, sid, s->rbuf + pos, n, 0);
+    }
+    if (!s->rcvd.n)
+        rudp__rbuf_put(c, s);
+    if (s->rfin && !s->rfin_delivered && s->rdeliv == s->rfin_off) {
+        s->rfin_delivered = 1;
+        if (c->on_data)
+            c->on_data(c->arg, c, sid, NULL, 0, 1);
+    }
+}
+
+static inline int rudp__rbuf_get(struct rudp_conn *c, struct rudp_stream *s)
+{
+    if (c->rbufs >= c->rbuf_max || (c->rbuf_pool && *c->rbuf_pool <= 0) ||
+        !(s->rbuf = (uint8_t *)malloc(RUDP_STREAM_WIN)))
+        return -1;
+    c->rbufs++;
+    if (c->rbuf_pool)
+        (*c->rbuf_pool)--;
+    return 0;
+}
+
+// 형식이 틀리면 -1, 담을 자리가 없으면 1 (rudp_input 이 그 패킷을 ACK 하지 않고 버린다)
+static inline int rudp__on_stream_frame(struct rudp_conn *c, uint32_t sid, uint64_t off, const uint8_t *data,
+                                        size_t len, int fin)
+{
+    if (sid >= RUDP_MAX_STREAMS)
+        return -1;
+    struct rudp_stream *s = &c->streams[sid];
+    uint64_t end = off + len;
+    if (end > s->rdeliv + RUDP_STREAM_WIN)             // 멈춘 사이 보내는 쪽 창(ACK 된 곳 기준)이 앞서 나갔다
+        return 1;
+    if (end > s->rdeliv && len && off <= s->rdeliv && !s->rcvd.n && !(c->rpaused >> sid & 1)) {
+        uint64_t from = s->rdeliv;                      // 순서대로 왔고 쌓인 것도 없다. 링을 거치지 않는다
+        s->rdeliv = end;
+        if (fin) {
+            s->rfin = 1;
+            s->rfin_off = end;
+        }
+        if (c->on_data)
+            c->on_data(c->arg, c, sid, data + (from - off), end - from, 0);
+        rudp__deliver(c, sid, s);
+        return 0;
+    }
+    if (end > s->rdeliv && len && !s->rbuf && rudp__rbuf_get(c, s) == -1)
+        return 1;
+    if (fin) {
+        s->rfin = 1;
+        s->rfin_off = end;
+    }
+    if (end > s->rdeliv && len) {
+        uint64_t from = off > s->rdeliv ? off : s->rdeliv;
+        for (uint64_t o = from; o < end;) {
+            size_t pos = o % RUDP_STREAM_WIN;
+            size_t n = end - o;
+            if (n > RUDP_STREAM_WIN - pos)
+                n = RUDP_STREAM_WIN - pos;
+            memcpy(s->rbuf + pos, data + (o - off), n);
+            o += n;
+        }
+        rudp__ranges_add(&s->rcvd, from, end);
+    }
+    rudp__deliver(c, sid, s);
+    return 0;
+}
+
+// 받은 패킷 번호를 기록한다. 이미 받은 것이면 1. 구간이 너무 많아지면 가장 오래된 것을 버린다
+static inline int rudp__record_pn(struct rudp_conn *c, uint64_t pn)
+{
+    if (rudp__ranges_has(&c->rx_pns, pn))
+        return 1;
+    rudp__ranges_add(&c->rx_pns, pn, pn + 1);
+    if (c->rx_pns.n > RUDP_ACK_RANGES)
+        rudp__ranges_drop_front(&c->rx_pns, c->rx_pns.n - RUDP_ACK_RANGES);
+    return 0;
+}
+
+// 받은 데이터그램 하나를 처리한다. 형식이 틀리면 -1 (연결 상태는 바뀌지 않았을 수도, 일부 바뀌었을 수도 있다)
+static inline int rudp_input(struct rudp_conn *c, const uint8_t *p, size_t len, uint64_t now)
+{
+    if (rudp_conn_id(p, len) != (int64_t)c->id)
+        return -1;
+    uint64_t pn = rudp__get(p + 5, 8);
+    int dup = rudp__ranges_has(&c->rx_pns, pn);
+    c->last_rx = now;
+    c->stats.pkts_recv++;
+    int eliciting = 0, drop = 0;
+    size_t i = RUDP_HDR;
+    while (i < len) {
+        uint8_t t = p[i];
+        if ((t & ~RUDP_F_FIN) == RUDP_F_STREAM) {
+            if (len - i < RUDP_STREAM_HDR)
+                return -1;
+            uint32_t sid = rudp__get(p + i + 1, 2);
+            uint64_t off = rudp__get(p + i + 3, 8);
+            size_t n = rudp__get(p + i + 11, 2);
+            if (len - i - RUDP_STREAM_HDR < n)
+                return -1;
+            int r = dup ? 0 : rudp__on_stream_frame(c, sid, off, p + i + RUDP_STREAM_HDR, n, t & RUDP_F_FIN);
+            if (r == -1)
+                return -1;
+            drop |= r;
+            i += RUDP_STREAM_HDR + n;
+            eliciting = 1;
+        } else if (t == RUDP_F_ACK) {
+            int nr = len - i >= 14 ? p[i + 13] : 0;
+            size_t n = 17 + (size_t)(nr ? nr - 1 : 0) * 8;
+            if (len - i - 1 < n || rudp__on_ack_frame(c, p + i + 1, n, now) == -1)
+                return -1;
+            i += 1 + n;
+        } else if (t == RUDP_F_PING) {
+            i++;
+            eliciting = 1;
+        } else if (t == RUDP_F_CLOSE) {
+            i++;
+            c->closed = 1;
+        } else {
+            return -1;
+        }
+    }
+    if (drop)                                           // 번호를 적지 않으므로 ACK 되지 않는다
+        return 0;
+    if (!dup) {
+        rudp__record_pn(c, pn);
+        if (c->rx_pns.n && pn + 1 == c->rx_pns.r[c->rx_pns.n - 1][1])
+            c->largest_rx_time = now;
+    }
+    if (eliciting) {
+        if (!c->ack_pending)
+            c->ack_deadline = now + RUDP_ACK_DELAY_US;
+        c->ack_pending++;
+        if (dup)                                        // 상대가 ACK 를 못 받은 것. 바로 다시 알린다
+            c->ack_pending = 2;
+    }
+    return 0;
+}
+
+/* ---- 보내기 ---- */
+
+// 이 스트림에서 다음에 보낼 조각. 다시 보낼 구간이 먼저고, 그다음 새 데이터, 마지막으로 FIN 만
+static inline int rudp__next_chunk(struct rudp_stream *s, size_t room, uint64_t *off, size_t *len, int *fin,
+                                   int *retx)
+{
+    while (s->retx.n) {
+        uint64_t lo = s->retx.r[0][0], hi = s->retx.r[0][1];
+        if (lo < s->una)
+            lo = s->una;
+        for (int k = 0; k < s->acked.n && lo < hi; k++) {   // 그사이 ACK 된 부분은 건너뛴다
+            if (s->acked.r[k][1] <= lo)
+                continue;
+            if (s->acked.r[k][0] <= lo)
+                lo = s->acked.r[k][1];
+            else if (s->acked.r[k][0] < hi)
+                hi = s->acked.r[k][0];
+            break;
+        }
+        if (lo >= hi) {
+            if (lo >= s->retx.r[0][1])
+                rudp__ranges_drop_front(&s->retx, 1);
+            else
+                s->retx.r[0][0] = lo;
+            continue;
+        }
+        size_t n = hi - lo < room ? hi - lo : room;
+        *off = lo;
+        *len = n;
+        *fin = s->fin_set && lo + n == s->fin_off;
+        if (lo + n >= s->retx.r[0][1])
+            rudp__ranges_drop_front(&s->retx, 1);
+        else
+            s->retx.r[0][0] = lo + n;
+        if (*fin)
+            s->retx_fin = 0;
+        *retx = 1;
+        return 1;
+    }
+    uint64_t limit = s->una + RUDP_STREAM_WIN;                  // 받는 쪽 링 크기를 넘기지 않는다
+    if (s->snext < s->send_end && s->snext < limit) {
+        uint64_t end = s->send_end < limit ? s->send_end : limit;
+        size_t n = end - s->snext < room ? end - s->snext : room;
+        *off = s->snext;
+        *len = n;
+        s->snext += n;
+        *fin = s->fin_set && s->snext == s->fin_off;
+        if (*fin)
+            s->fin_sent = 1;
+        *retx = 0;
+        return 1;
+    }
+    if ((s->fin_set && !s->fin_sent && s->snext == s->fin_off) || s->retx_fin) {
+        *off = s->fin_off;
+        *len = 0;
+        *fin = 1;
+        s->fin_sent = 1;
+        s->retx_fin = 0;
+        *retx = 0;
+        return 1;
+    }
+    return 0;
+}
+
+static inline int rudp__has_data(const struct rudp_conn *c)
+{
+    for (int i = 0; i < RUDP_MAX_STREAMS; i++) {
+        const struct rudp_stream *s = &c->streams[i];
+        if (s->retx.n || s->retx_fin || (s->snext < s->send_end && s->snext < s->una + RUDP_STREAM_WIN) ||
+            (s->fin_set && !s->fin_sent && s->snext == s->fin_off))
+            return 1;
+    }
+    return 0;
+}
+
+static inline double rudp__pace_rate(const struct rudp_conn *c)   // 바이트/us
+{
+    double gain = c->cc.cwnd < c->cc.ssthresh ? 2.0 : 1.25;
+    uint64_t rtt = c->srtt ? c->srtt : 1;
+    return gain * c->cc.cwnd / rtt;
+}
+
+static inline void rudp__pace_refill(struct rudp_conn *c, uint64_t now)
+{
+    double rate = rudp__pace_rate(c);
+    double burst = rate * RUDP_PACE_QUANTUM_US;
+    if (burst < 10.0 * RUDP_MAX_PKT)
+        burst = 10.0 * RUDP_MAX_PKT;
+    if (!c->has_rtt) {                                  // RTT 를 모르면 페이싱하지 않는다
+        c->pace_tokens = burst;
+    } else {
+        c->pace_tokens += rate * (now - c->pace_last);
+        if (c->pace_tokens > burst)
+            c->pace_tokens = burst;
+    }
+    c->pace_last = now;
+}
+
+static inline int rudp__cwnd_open(const struct rudp_conn *c)
+{
+    return c->next_pn - c->una_pn < RUDP_SENT_CAP &&
+           (c->probes > 0 || c->bytes_in_flight + RUDP_MAX_PKT <= c->cc.cwnd);
+}
+
+// 지금 보낼 데이터그램 하나를 buf 에 만든다. 보낼 것이 없으면 (또는 혼잡 창/페이싱에 막히면) 0
+static inline int rudp_output(struct rudp_conn *c, uint8_t *buf, size_t cap, uint64_t now)
+{
+    if (cap < RUDP_MAX_PKT)
+        return -1;
+    rudp__pace_refill(c, now);
+    int need_ack = c->ack_pending && (c->ack_pending >= 2 || now >= c->ack_deadline);
+    int can_data = rudp__cwnd_open(c) && (c->probes > 0 || c->pace_tokens >= RUDP_MAX_PKT);
+    if (can_data && c->next_pn - c->una_pn >= c->sent_cap && rudp__sent_grow(c) == -1)
+        can_data = 0;                                   // 링을 못 늘렸다. ACK 로 자리가 나면 보낸다
+    int want_data = can_data && (rudp__has_data(c) || c->probes > 0);
+    if (!need_ack && !want_data && !c->send_close)
+        return 0;
+
+    uint64_t pn = c->next_pn++;
+    size_t n = 0;
+    buf[n++] = RUDP_MAGIC;
+    rudp__put(buf + n, c->id, 4);
+    n += 4;
+    rudp__put(buf + n, pn, 8);
+    n += 8;
+
+    if (c->ack_pending && c->rx_pns.n) {               // 데이터를 보내는 김에도 밀린 ACK 를 싣는다
+        struct rudp_ranges *rs = &c->rx_pns;
+        int nr = rs->n < RUDP_ACK_RANGES ? rs->n : RUDP_ACK_RANGES;
+        uint64_t largest = rs->r[rs->n - 1][1] - 1;
+        buf[n++] = RUDP_F_ACK;
+        rudp__put(buf + n, largest, 8);
+        rudp__put(buf + n + 8, now - c->largest_rx_time, 4);
+        buf[n + 12] = (uint8_t)nr;
+        rudp__put(buf + n + 13, largest - rs->r[rs->n - 1][0], 4);
+        n += 17;
+        uint64_t prev_lo = rs->r[rs->n - 1][0];
+        for (int k = 1; k < nr; k++) {
+            uint64_t lo = rs->r[rs->n - 1 - k][0], hi = rs->r[rs->n - 1 - k][1] - 1;
+            rudp__put(buf + n, prev_lo - hi - 2, 4);
+            rudp__put(buf + n + 4, hi - lo, 4);
+            n += 8;
+            prev_lo = lo;
+        }
+        c->ack_pending = 0;
+    }
+
+    struct rudp_sent rec, *sp = &rec;                  // ACK 만 든 패킷은 기록하지 않는다 (다시 보낼 일이 없다)
+    memset(sp, 0, sizeof(*sp));
+    sp->pn = pn;
+    sp->time = now;
+    if (want_data) {
+        size_t room = RUDP_MAX_PKT - n - RUDP_STREAM_HDR;
+        for (int k = 0; k < RUDP_MAX_STREAMS; k++) {    // 스트림을 돌아가며 한 조각씩 (한 스트림이 독차지하지 않게)
+            int sid = (c->rr + k) % RUDP_MAX_STREAMS;
+            uint64_t off;
+            size_t len;
+            int fin, retx;
+            if (!rudp__next_chunk(&c->streams[sid], room, &off, &len, &fin, &retx))
+                continue;
+            buf[n] = RUDP_F_STREAM | (fin ? RUDP_F_FIN : 0);
+            rudp__put(buf + n + 1, sid, 2);
+            rudp__put(buf + n + 3, off, 8);
+            rudp__put(buf + n + 11, len, 2);
+            struct rudp_stream *s = &c->streams[sid];
+            if (len)
+                memcpy(buf + n + RUDP_STREAM_HDR, s->sbuf + (off - s->sbase), len);
+            n += RUDP_STREAM_HDR + len;
+            sp->has_data = 1;
+            sp->sid = sid;
+            sp->off = off;
+            sp->len = len;
+            sp->fin = fin;
+            sp->eliciting = 1;
+            if (retx)
+                c->stats.bytes_retx += len;
+            c->rr = (sid + 1) % RUDP_MAX_STREAMS;
+            break;
+        }
+        if (!sp->eliciting && c->probes > 0) {          // 보낼 데이터가 없으면 PING 으로 probe
+            buf[n++] = RUDP_F_PING;
+            sp->eliciting = 1;
+        }
+    }
+    if (c->send_close) {
+        buf[n++] = RUDP_F_CLOSE;
+        c->send_close = 0;
+    }
+
+    sp->bytes = n;
+    if (sp->eliciting) {
+        sp->state = RUDP_S_INFLIGHT;
+        c->sent[pn & (c->sent_cap - 1)] = rec;          // 위에서 링에 자리가 있음을 확인했다 (모자라면 늘렸다)
+        c->bytes_in_flight += n;
+        c->last_eliciting = now;
+        if (c->probes > 0)
+            c->probes--;
+        else
+            c->pace_tokens -= n;
+    }
+    rudp__advance_una(c);
+    c->stats.pkts_sent++;
+    c->stats.bytes_sent += n;
+    return (int)n;
+}
+
+static inline uint64_t rudp__pto_time(const struct rudp_conn *c)
+{
+    uint64_t var = 4 * c->rttvar > RUDP_GRANULARITY_US ? 4 * c->rttvar : RUDP_GRANULARITY_US;
+    uint64_t pto = (c->srtt + var + RUDP_ACK_DELAY_US) << (c->pto_backoff < 16 ? c->pto_backoff : 16);
+    return c->last_eliciting + pto;
+}
+
+// 다음에 rudp_on_timer/rudp_output 을 불러야 할 시각 (us). 할 일이 없으면 UINT64_MAX
+static inline uint64_t rudp_timeout(struct rudp_conn *c, uint64_t now)
+{
+    uint64_t t = UINT64_MAX;
+    if (c->send_close || c->probes > 0 || c->ack_pending >= 2)
+        return now;
+    if (c->ack_pending && c->ack_deadline < t)
+        t = c->ack_deadline;
+    if (c->loss_time && c->loss_time < t)
+        t = c->loss_time;
+    if (c->bytes_in_flight) {
+        uint64_t pto = rudp__pto_time(c);
+        if (pto < t)
+            t = pto;
+    }
+    if (rudp__cwnd_open(c) && rudp__has_data(c)) {
+        rudp__pace_refill(c, now);
+        if (c->pace_tokens >= RUDP_MAX_PKT)
+            return now;
+        uint64_t wait = (uint64_t)((RUDP_MAX_PKT - c->pace_tokens) / rudp__pace_rate(c)) + 1;
+        if (now + wait < t)
+            t = now + wait;
+    }
+    return t < now ? now : t;
+}
+
+// 시간 기준 손실 판정과 PTO. PTO 가 지나면 가장 오래된 패킷의 데이터를 다시 보낼 목록에 넣고 probe 두 개를 허락한다
+static inline void rudp_on_timer(struct rudp_conn *c, uint64_t now)
+{
+    if (c->loss_time && now >= c->loss_time) {
+        rudp__detect_loss(c, now);
+        return;
+    }
+    if (!c->bytes_in_flight || now < rudp__pto_time(c))
+        return;
+    c->stats.pto_count++;
+    c->pto_backoff++;
+    c->probes = 2;
+    c->last_eliciting = now;                            // 다음 PTO 는 지금부터 두 배
+    for (uint64_t pn = c->una_pn; pn < c->next_pn; pn++) {
+        struct rudp_sent *p = &c->sent[pn & (c->sent_cap - 1)];
+        if (p->state != RUDP_S_INFLIGHT || p->pn != pn)
+            continue;
+        if (p->has_data) {
+            struct rudp_stream *s = &c->streams[p->sid];
+            if (p->len)
+                rudp__ranges_add(&s->retx, p->off, p->off + p->len);
+            if (p->fin && !s->fin_acked)
+                s->retx_fin = 1;
+        }
+        break;
+    }
+}
+
+#endif
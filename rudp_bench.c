@@ -0,0 +1,310 @@
+/* rudp_bench.c — rudp.h 스트림 전송 goodput 측정 (udp_server --rudp 상대)
+ *
+ *   gcc -O2 -o rudp_bench rudp_bench.c -lm
+ *   ./udp_server --rudp 9190 &
+ *   ./rudp_bench --port 9190 --streams 4 --bytes 4M --loss 0,1,2,5,10 --cc cubic   # 손실률마다 한 줄
+ *
+ * 연결 하나에 스트림 --streams 개를 열고 스트림마다 --bytes 바이트를 보낸다. 서버는 받은 그대로 같은 스트림으로
+ * 돌려보낸다. 모든 스트림의 에코를 끝(FIN)까지 받으면 끝난다. 받은 바이트는 보낸 무늬와 맞는지 확인한다.
+ * --loss P 면 이쪽에서 보내는 데이터그램과 받는 데이터그램을 각각 P% 확률로 버린다 (양방향 모두 P% 손실인 경로).
+ * 결과: 걸린 시간, goodput (스트림 바이트 * 2 방향 / 시간), 다시 보낸 비율, 잃은 패킷, PTO 횟수, srtt, cwnd,
+ *       스트림마다 끝난 시각의 범위 (한 스트림의 손실이 다른 스트림을 세우지 않으면 좁다)
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <getopt.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "rudp.h"
+
+#define MAX_SWEEP 16
+#define IO_BATCH 64
+#define WRITE_CHUNK (64 * 1024)
+
+static const char *host = "127.0.0.1";
+static int port = 9190;
+static int nstreams = 4;
+static uint64_t stream_bytes = 4 << 20;
+static double loss_list[MAX_SWEEP] = { 0 };
+static int nloss = 1;
+static const struct rudp_cc_ops *cc = &rudp_cubic;
+static double max_secs = 60;       // 이 안에 끝나지 않으면 포기한다
+
+static double loss;                // 이번 실행의 손실 확률 (0~1)
+static uint64_t got[RUDP_MAX_STREAMS];     // 스트림마다 돌아온 바이트
+static uint64_t done_us[RUDP_MAX_STREAMS]; // 스트림마다 FIN 을 받은 시각
+static int streams_done;
+static uint64_t bad_bytes;         // 무늬가 틀린 바이트
+static uint64_t dropped_tx, dropped_rx;
+
+// 스트림 sid 의 offset o 에 있어야 할 바이트
+static inline uint8_t pattern(uint32_t sid, uint64_t o)
+{
+    return (uint8_t)(o * 7 + (o >> 8) + sid * 13);
+}
+
+static int drop(void)
+{
+    return loss > 0 && drand48() < loss;
+}
+
+static void on_data(void *arg, struct rudp_conn *c, uint32_t sid, const uint8_t *data, size_t len, int fin)
+{
+    (void)arg;
+    (void)c;
+    for (size_t i = 0; i < len; i++)
+        bad_bytes += data[i] != pattern(sid, got[sid] + i);
+    got[sid] += len;
+    if (fin) {
+        done_us[sid] = rudp_now_us();
+        streams_done++;
+    }
+}
+
+// 보낼 수 있는 만큼 꺼내서 sendmmsg 로 보낸다. --loss 면 일부는 보낸 척만 한다
+static void flush(int fd, struct rudp_conn *c, uint64_t now)
+{
+    static uint8_t bufs[IO_BATCH][RUDP_MAX_PKT];
+    struct mmsghdr msgs[IO_BATCH];
+    struct iovec iov[IO_BATCH];
+    for (;;) {
+        int m = 0, n;
+        while (m < IO_BATCH && (n = rudp_output(c, bufs[m], RUDP_MAX_PKT, now)) > 0) {
+            if (drop()) {
+                dropped_tx++;
+                continue;
+            }
+            iov[m].iov_base = bufs[m];
+            iov[m].iov_len = n;
+            memset(&msgs[m], 0, sizeof(msgs[m]));
+            msgs[m].msg_hdr.msg_iov = &iov[m];
+            msgs[m].msg_hdr.msg_iovlen = 1;
+            m++;
+        }
+        for (int off = 0; off < m;) {
+            int k = sendmmsg(fd, msgs + off, m - off, 0);
+            if (k <= 0)
+                break;             // 송신 버퍼가 찼다. 남은 것은 잃은 것으로 두고 rudp 가 다시 보낸다
+            off += k;
+        }
+        if (m < IO_BATCH)
+            return;
+    }
+}
+
+static void drain(int fd, struct rudp_conn *c)
+{
+    static uint8_t bufs[IO_BATCH][RUDP_MAX_PKT];
+    struct mmsghdr msgs[IO_BATCH];
+    struct iovec iov[IO_BATCH];
+    for (;;) {
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < IO_BATCH; i++) {
+            iov[i].iov_base = bufs[i];
+            iov[i].iov_len = RUDP_MAX_PKT;
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int m = recvmmsg(fd, msgs, IO_BATCH, MSG_DONTWAIT, NULL);
+        if (m <= 0)
+            return;
+        uint64_t now = rudp_now_us();
+        for (int i = 0; i < m; i++) {
+            if (drop()) {
+                dropped_rx++;
+                continue;
+            }
+            rudp_input(c, bufs[i], msgs[i].msg_len, now);
+        }
+        if (m < IO_BATCH)
+            return;
+    }
+}
+
+static void run(double loss_pct)
+{
+    loss = loss_pct / 100.0;
+    memset(got, 0, sizeof(got));
+    memset(done_us, 0, sizeof(done_us));
+    streams_done = 0;
+    bad_bytes = dropped_tx = dropped_rx = 0;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        fprintf(stderr, "bad host %s\n", host);
+        exit(1);
+    }
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    int buf = 4 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+    if (fd == -1 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        perror("socket");
+        exit(1);
+    }
+
+    uint64_t start = rudp_now_us();
+    struct rudp_conn *c = rudp_conn_new((uint32_t)lrand48(), cc, start);
+    if (!c) {
+        perror("rudp_conn_new");
+        exit(1);
+    }
+    c->on_data = on_data;
+    uint8_t chunk[WRITE_CHUNK];
+    for (int s = 0; s < nstreams; s++) {
+        for (uint64_t o = 0; o < stream_bytes; o += WRITE_CHUNK) {
+            size_t n = stream_bytes - o < WRITE_CHUNK ? stream_bytes - o : WRITE_CHUNK;
+            for (size_t i = 0; i < n; i++)
+                chunk[i] = pattern(s, o + i);
+            rudp_write(c, s, chunk, n);
+        }
+        rudp_finish(c, s);
+    }
+
+    uint64_t deadline = start + (uint64_t)(max_secs * 1e6);
+    uint64_t now = start;
+    while (now < deadline) {
+        drain(fd, c);
+        now = rudp_now_us();
+        if (streams_done == nstreams)   // 마지막 FIN 을 받은 바로 그 drain 에서 끝낸다 (ppoll 에서 기다린 시간을 세지 않게)
+            break;
+        rudp_on_timer(c, now);
+        flush(fd, c, now);
+        uint64_t t = rudp_timeout(c, now);
+        if (t > now) {
+            uint64_t us = t - now < 100000 ? t - now : 100000;
+            struct pollfd pfd = { .fd = fd, .events = POLLIN };
+            struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000 };
+            ppoll(&pfd, 1, &ts, NULL);
+        }
+        now = rudp_now_us();
+    }
+    uint64_t first = UINT64_MAX, last = 0;
+    for (int s = 0; s < nstreams; s++) {
+        if (!done_us[s])
+            continue;
+        if (done_us[s] < first)
+            first = done_us[s];
+        if (done_us[s] > last)
+            last = done_us[s];
+    }
+    double secs = ((streams_done == nstreams ? last : now) - start) / 1e6;   // 다 끝났으면 마지막 FIN 까지
+    uint64_t total = (uint64_t)nstreams * stream_bytes;
+    uint64_t echoed = 0;
+    for (int s = 0; s < nstreams; s++)
+        echoed += got[s];
+    printf("%6.1f%% %6s %8.2f %10.1f %7.2f%% %8llu %5llu %8llu %8llu %9.1f %9.1f %8llu%s\n",
+           loss_pct, cc->name, secs, 2.0 * echoed / secs / 1e6,
+           100.0 * c->stats.bytes_retx / (c->stats.bytes_sent ? c->stats.bytes_sent : 1),
+           (unsigned long long)c->stats.pkts_lost, (unsigned long long)c->stats.pto_count,
+           (unsigned long long)c->srtt, (unsigned long long)(c->cc.cwnd / 1024),
+           first == UINT64_MAX ? 0.0 : (first - start) / 1e3, last ? (last - start) / 1e3 : 0.0,
+           (unsigned long long)bad_bytes, echoed < total ? "  (timed out)" : "");
+    fflush(stdout);
+
+    rudp_close(c);                     // 끝났다고 알린다 (잃어도 서버는 idle timeout 으로 치운다)
+    flush(fd, c, rudp_now_us());
+    rudp_conn_free(c);
+    close(fd);
+}
+
+static uint64_t parse_size(const char *s)
+{
+    char *end;
+    double v = strtod(s, &end);
+    switch (*end) {
+    case 'k': case 'K': v *= 1024; break;
+    case 'm': case 'M': v *= 1024 * 1024; break;
+    case 'g': case 'G': v *= 1024.0 * 1024 * 1024; break;
+    }
+    return (uint64_t)v;
+}
+
+// "0,1,2,5,10" 같은 목록
+static int parse_list(const char *s, double *out)
+{
+    int n = 0;
+    while (*s && n < MAX_SWEEP) {
+        char *end;
+        out[n++] = strtod(s, &end);
+        if (end == s)
+            return 0;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage : %s [--host IP] [--port N] [--streams N] [--bytes SIZE] [--cc reno|cubic]\n"
+           "               [--loss PCT[,PCT...]] [--seed N] [--max-time SEC]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_opts[] = {
+        {"host", required_argument, NULL, 'h'},
+        {"port", required_argument, NULL, 'p'},
+        {"streams", required_argument, NULL, 's'},
+        {"bytes", required_argument, NULL, 'b'},
+        {"cc", required_argument, NULL, 'c'},
+        {"loss", required_argument, NULL, 'l'},
+        {"seed", required_argument, NULL, 'S'},
+        {"max-time", required_argument, NULL, 't'},
+        {NULL, 0, NULL, 0}
+    };
+    long seed = (long)time(NULL) ^ getpid();
+    int ch, bad = 0;
+    while ((ch = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+        switch (ch) {
+        case 'h': host = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 's': nstreams = atoi(optarg); break;
+        case 'b': stream_bytes = parse_size(optarg); break;
+        case 'c':
+            if (strcmp(optarg, "reno") == 0)
+                cc = &rudp_reno;
+            else if (strcmp(optarg, "cubic") == 0)
+                cc = &rudp_cubic;
+            else
+                bad = 1;
+            break;
+        case 'l': nloss = parse_list(optarg, loss_list); break;
+        case 'S': seed = atol(optarg); break;
+        case 't': max_secs = atof(optarg); break;
+        default: bad = 1;
+        }
+    }
+    if (bad || optind != argc || nstreams < 1 || nstreams > RUDP_MAX_STREAMS || stream_bytes == 0 ||
+        nloss == 0 || max_secs <= 0) {
+        usage(argv[0]);
+        exit(1);
+    }
+    for (int i = 0; i < nloss; i++) {
+        if (loss_list[i] < 0 || loss_list[i] >= 100) {
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+    srand48(seed);
+
+    printf("%s:%d, %d streams x %llu bytes, echo (goodput counts both directions, MB/s)\n",
+           host, port, nstreams, (unsigned long long)stream_bytes);
+    printf("%7s %6s %8s %10s %8s %8s %5s %8s %8s %9s %9s %8s\n",
+           "loss", "cc", "secs", "goodput", "retx", "lost", "pto", "srtt us", "cwnd KB",
+           "first ms", "last ms", "bad");
+    for (int i = 0; i < nloss; i++)
+        run(loss_list[i]);
+    return 0;
+}
@@ -0,0 +1,194 @@
+/* seglog.h — mmap 으로 붙여 쓰는 세그먼트 로그 (header-only, C/C++ 공용)
+ *
+ * 사용법:
+ *   struct seglog l;
+ *   seglog_open(&l, "hist/6c6f626279", 256 * 1024);  // hist/6c6f626279.0.seg, .1.seg 를 만들거나 연다
+ *   seglog_tail(&l, 50, fn, arg);                     // 마지막 50 개 레코드를 오래된 것부터 fn 으로
+ *   seglog_append(&l, data, len);                     // 레코드 하나 추가 (시스템 콜 없음)
+ *   seglog_close(&l);
+ *
+ * 구조:
+ *   - 세그먼트 파일 두 개(.0.seg / .1.seg)를 번갈아 쓴다. 둘 다 시작할 때 MAP_SHARED 로 매핑하고 fd 는 바로 닫는다.
+ *     추가는 매핑에 memcpy 하고 머리의 end 를 옮기는 것뿐이다. 페이지는 커널이 알아서 파일에 내린다.
+ *   - 세그먼트 안에서는 붙여 쓰기만 한다. 가득 차면 다른 세그먼트를 비우고(seq + 1) 그쪽으로 넘어간다.
+ *     그래서 항상 바로 전 세그먼트 하나까지는 남아 있다. (최근 레코드를 세그먼트 하나 분량 이상 보장)
+ *   - 레코드: [u32 길이][본문][u32 길이]. 뒤에도 길이가 있어서 끝에서부터 거꾸로 걸어갈 수 있다.
+ *     다시 열 때 파일 전체를 읽지 않고, 머리의 end 에서 필요한 개수만큼만 거꾸로 걷는다.
+ *   - end 는 본문을 다 쓴 뒤에 옮긴다. 프로세스가 죽어도 페이지 캐시는 남으므로 end 까지는 온전하다.
+ *     (전원이 나가면 아직 디스크에 안 내려간 마지막 페이지들은 잃을 수 있다)
+ *   - 머리가 깨졌거나 크기가 다른 세그먼트는 빈 세그먼트로 다시 만든다.
+ */
+#ifndef SEGLOG_H
+#define SEGLOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SEGLOG_MAGIC 0x53474c31u        // "SGL1"
+#define SEGLOG_HDR   64                 // 머리 크기 (첫 레코드 위치)
+
+struct seglog_hdr {
+    uint32_t magic;
+    uint32_t size;                      // 세그먼트 크기 (파일 크기)
+    uint64_t seq;                       // 클수록 새 세그먼트
+    uint64_t end;                       // 여기까지 레코드가 있음
+};
+
+struct seglog {
+    char  *map[2];
+    size_t size;
+    int    cur;                         // 지금 쓰는 세그먼트 (0/1)
+};
+
+typedef void (*seglog_fn)(void *arg, const char *data, uint32_t len);
+
+static inline struct seglog_hdr *seglog__hdr(const struct seglog *l, int i)
+{
+    return (struct seglog_hdr *)l->map[i];
+}
+
+static inline void seglog__reset(struct seglog *l, int i, uint64_t seq)
+{
+    struct seglog_hdr *h = seglog__hdr(l, i);
+    h->magic = SEGLOG_MAGIC;
+    h->size  = (uint32_t)l->size;
+    h->seq   = seq;
+    h->end   = SEGLOG_HDR;
+}
+
+static inline int seglog__valid(const struct seglog *l, int i)
+{
+    const struct seglog_hdr *h = seglog__hdr(l, i);
+    return h->magic == SEGLOG_MAGIC && h->size == l->size &&
+           h->end >= SEGLOG_HDR && h->end <= l->size;
+}
+
+static inline void seglog_close(struct seglog *l)
+{
+    for (int i = 0; i < 2; i++) {
+        if (l->map[i])
+            munmap(l->map[i], l->size);
+        l->map[i] = NULL;
+    }
+}
+
+// base.0.seg / base.1.seg 를 열거나 만든다. 실패하면 -1 (errno)
+static inline int seglog_open(struct seglog *l, const char *base, size_t seg_size)
+{
+    l->map[0] = l->map[1] = NULL;
+    l->size = seg_size;
+    l->cur = 0;
+    for (int i = 0; i < 2; i++) {
+        char path[4096 + 16];
+        if (strlen(base) >= 4096) {
+            errno = ENAMETOOLONG;
+            goto fail;
+        }
+        snprintf(path, sizeof(path), "%s.%d.seg", base, i);
+        int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd == -1)
+            goto fail;
+        struct stat st;
+        if (fstat(fd, &st) == -1 || ((size_t)st.st_size != seg_size && ftruncate(fd, seg_size) == -1)) {
+            close(fd);
+            goto fail;
+        }
+        void *p = mmap(NULL, seg_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);                      // 매핑은 fd 를 닫아도 남는다
+        if (p == MAP_FAILED)
+            goto fail;
+        l->map[i] = (char *)p;
+    }
+    {
+        int v0 = seglog__valid(l, 0), v1 = seglog__valid(l, 1);
+        if (!v0 && !v1) {
+            seglog__reset(l, 0, 1);
+            seglog__reset(l, 1, 0);
+        } else if (!v0) {
+            seglog__reset(l, 0, 0);
+        } else if (!v1) {
+            seglog__reset(l, 1, 0);
+        }
+        l->cur = seglog__hdr(l, 1)->seq > seglog__hdr(l, 0)->seq;
+    }
+    return 0;
+fail:
+    seglog_close(l);
+    return -1;
+}
+
+// 레코드 하나를 붙인다. 세그먼트보다 큰 레코드면 -1
+static inline int seglog_append(struct seglog *l, const void *data, uint32_t len)
+{
+    uint64_t need = (uint64_t)len + 8;
+    if (need > l->size - SEGLOG_HDR)
+        return -1;
+    struct seglog_hdr *h = seglog__hdr(l, l->cur);
+    if (h->end + need > l->size) {      // 가득 참: 다른 세그먼트를 비우고 넘어간다
+        int next = !l->cur;
+        seglog__reset(l, next, h->seq + 1);
+        l->cur = next;
+        h = seglog__hdr(l, next);
+    }
+    char *p = l->map[l->cur] + h->end;
+    memcpy(p, &len, 4);
+    memcpy(p + 4, data, len);
+    memcpy(p + 4 + len, &len, 4);
+    __atomic_store_n(&h->end, h->end + need, __ATOMIC_RELEASE);  // 본문이 먼저
+    return 0;
+}
+
+// 세그먼트 i 의 끝에서부터 최대 n 개 레코드를 거꾸로 모은다. 모은 개수를 돌려준다
+static inline unsigned seglog__walk(const struct seglog *l, int i, unsigned n,
+                                    const char **ptrs, uint32_t *lens)
+{
+    const char *base = l->map[i];
+    uint64_t off = seglog__hdr(l, i)->end;
+    unsigned got = 0;
+    while (got < n && off >= SEGLOG_HDR + 8) {
+        uint32_t len, head;
+        memcpy(&len, base + off - 4, 4);
+        if ((uint64_t)len + 8 > off - SEGLOG_HDR)
+            break;                      // 깨진 레코드: 여기서 멈춘다
+        memcpy(&head, base + off - 8 - len, 4);
+        if (head != len)
+            break;
+        ptrs[got] = base + off - 4 - len;
+        lens[got] = len;
+        got++;
+        off -= (uint64_t)len + 8;
+    }
+    return got;
+}
+
+// 마지막 n 개 레코드(있는 만큼)를 오래된 것부터 fn 으로 넘긴다. 실패하면 -1
+static inline int seglog_tail(const struct seglog *l, unsigned n, seglog_fn fn, void *arg)
+{
+    if (n == 0)
+        return 0;
+    const char **ptrs = (const char **)malloc(n * sizeof(*ptrs));
+    uint32_t *lens = (uint32_t *)malloc(n * sizeof(*lens));
+    if (!ptrs || !lens) {
+        free(ptrs);
+        free(lens);
+        return -1;
+    }
+    unsigned got = seglog__walk(l, l->cur, n, ptrs, lens);
+    int prev = !l->cur;
+    if (got < n && seglog__hdr(l, prev)->seq + 1 == seglog__hdr(l, l->cur)->seq)
+        got += seglog__walk(l, prev, n - got, ptrs + got, lens + got);
+    while (got--)
+        fn(arg, ptrs[got], lens[got]);
+    free(ptrs);
+    free(lens);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,73 @@
+/* spsc_ring.h — 단일 생산자/단일 소비자 포인터 링 (header-only, C/C++ 공용)
+ *
+ * 사용법:
+ *   struct spsc_ring r;
+ *   spsc_init(&r, 4096);                 // 칸 수는 2의 거듭제곱
+ *   if (spsc_push(&r, p) == -1) ...      // 생산자 스레드만. 가득 차면 -1 (기다리지 않는다)
+ *   while ((p = spsc_pop(&r)) != NULL)   // 소비자 스레드만
+ *
+ * 구조:
+ *   - head 는 생산자만, tail 은 소비자만 쓴다. 락도 CAS 도 없이 acquire/release 읽기·쓰기 한 번씩이다.
+ *   - head 와 tail 을 서로 다른 캐시 라인에 두고, 상대 인덱스는 각자 캐시해 둔다.
+ *     링이 가득 차 보이거나(생산자) 비어 보일 때만(소비자) 상대 캐시 라인을 다시 읽는다.
+ *   - 깨우기는 하지 않는다. 소비자가 잠들어 있으면 쓰는 쪽이 eventfd 등으로 따로 알린다.
+ */
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+struct spsc_ring {
+    void   **slots;                                 // 읽기 전용 (init 이후)
+    uint64_t mask;
+    uint64_t head __attribute__((aligned(64)));    // 생산자만 씀
+    uint64_t tail_cache;                            // 생산자가 마지막으로 본 tail
+    uint64_t tail __attribute__((aligned(64)));    // 소비자만 씀
+    uint64_t head_cache;                            // 소비자가 마지막으로 본 head
+};
+
+static inline int spsc_init(struct spsc_ring *r, uint32_t cap)
+{
+    r->slots = (void **)calloc(cap, sizeof(void *));
+    if (!r->slots)
+        return -1;
+    r->mask = cap - 1;
+    r->head = r->tail_cache = 0;
+    r->tail = r->head_cache = 0;
+    return 0;
+}
+
+static inline void spsc_destroy(struct spsc_ring *r)
+{
+    free(r->slots);
+    r->slots = NULL;
+}
+
+static inline int spsc_push(struct spsc_ring *r, void *p)
+{
+    uint64_t head = r->head;
+    if (head - r->tail_cache > r->mask) {
+        r->tail_cache = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        if (head - r->tail_cache > r->mask)
+            return -1;
+    }
+    r->slots[head & r->mask] = p;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);  // 칸 내용이 먼저 보이도록
+    return 0;
+}
+
+static inline void *spsc_pop(struct spsc_ring *r)
+{
+    uint64_t tail = r->tail;
+    if (tail == r->head_cache) {
+        r->head_cache = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        if (tail == r->head_cache)
+            return NULL;
+    }
+    void *p = r->slots[tail & r->mask];
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);  // 칸을 다 읽은 뒤에 돌려준다
+    return p;
+}
+
+#endif
@@ -0,0 +1,270 @@
+/* timer_wheel.h — 계층형 타이머 휠 (header-only, C/C++ 공용)
+ *
+ * 사용법:
+ *   struct timer_wheel tw;
+ *   tw_init(&tw, 10, tw_clock_ms());             // 틱 10ms
+ *   tw_add(&tw, &c->timer, 30000);               // 30초 뒤 만료 (이미 걸려 있으면 옮김)
+ *   tw_del(&tw, &c->timer);                      // 취소
+ *
+ *   int timeout = tw_timeout_ms(&tw, tw_clock_ms());    // epoll_wait 의 timeout 으로 사용
+ *   epoll_wait(epfd, events, MAX_EVENTS, timeout);
+ *   tw_advance(&tw, tw_clock_ms());
+ *   while ((n = tw_pop(&tw)) != NULL) { ... }    // 만료된 타이머
+ *
+ * 구조 (Varghese & Lauck 의 계층형 휠):
+ *   - 레벨 4 개 × 슬롯 64 개. 레벨 0 은 1틱, 레벨 1 은 64틱, 레벨 2 는 64²틱 단위로 타이머를 담는다.
+ *     만료까지 남은 틱 수로 레벨을 고르므로 추가/삭제는 리스트 연결 몇 개로 끝나는 O(1) 이다.
+ *   - 레벨 0 이 한 바퀴 돌 때마다 위 레벨의 슬롯 하나를 아래로 내린다(cascade). 타이머 하나는
+ *     만료 전까지 최대 레벨 수만큼만 옮겨진다.
+ *   - 슬롯마다 비었는지를 비트맵으로 들고 있어서, 다음 만료 시각 계산이나 빈 구간 건너뛰기에
+ *     타이머 전체를 훑지 않는다. 타이머가 100만 개여도 틱마다 하는 일은 같다.
+ *   - 노드(struct tw_node)는 사용하는 쪽 구조체에 들어 있는 intrusive 리스트라 메모리 할당이 없다.
+ *   - 최대 범위는 64⁴ = 2²⁴ 틱 (10ms 틱이면 약 46시간). 더 먼 만료는 범위 끝으로 당겨진다.
+ */
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+#include <time.h>
+
+#define TW_BITS      6
+#define TW_SLOTS     (1u << TW_BITS)                          // 레벨당 슬롯 수
+#define TW_LEVELS    4
+#define TW_MAX_TICKS ((1u << (TW_BITS * TW_LEVELS)) - 1)      // 한 번에 걸 수 있는 최대 틱 수
+
+struct tw_node {
+    struct tw_node *next, *prev;    // next == NULL 이면 걸려 있지 않음
+    uint32_t expires;               // 만료 틱 (tw->now 기준, 32비트 wrap 허용)
+};
+
+struct timer_wheel {
+    struct tw_node slots[TW_LEVELS][TW_SLOTS];  // 슬롯마다 원형 리스트의 머리 노드
+    uint64_t       bitmap[TW_LEVELS];           // 비어 있지 않은 슬롯 표시
+    struct tw_node expired;                     // tw_advance 가 꺼내 놓은, tw_pop 을 기다리는 타이머
+    uint64_t       base_ms;                     // 틱 0 의 시각
+    uint32_t       tick_ms;
+    uint32_t       now;                         // 여기까지의 틱은 처리함
+    size_t         count;                       // 걸려 있는 타이머 수 (expired 목록 포함)
+};
+
+static inline uint64_t tw_clock_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);        // vDSO, 시스템 콜 없음
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static inline void tw__empty(struct tw_node *h)
+{
+    h->next = h->prev = h;
+}
+
+static inline void tw_init(struct timer_wheel *tw, uint32_t tick_ms, uint64_t now_ms)
+{
+    for (int l = 0; l < TW_LEVELS; l++) {
+        for (unsigned s = 0; s < TW_SLOTS; s++)
+            tw__empty(&tw->slots[l][s]);
+        tw->bitmap[l] = 0;
+    }
+    tw__empty(&tw->expired);
+    tw->base_ms = now_ms;
+    tw->tick_ms = tick_ms ? tick_ms : 1;
+    tw->now     = 0;
+    tw->count   = 0;
+}
+
+static inline int tw_armed(const struct tw_node *n)
+{
+    return n->next != NULL;
+}
+
+// ms → 틱 (올림). 최소 1틱, 최대 TW_MAX_TICKS
+static inline uint32_t tw_ms_to_ticks(const struct timer_wheel *tw, uint64_t ms)
+{
+    uint64_t t = (ms + tw->tick_ms - 1) / tw->tick_ms;
+    if (t == 0) t = 1;
+    if (t > TW_MAX_TICKS) t = TW_MAX_TICKS;
+    return (uint32_t)t;
+}
+
+static inline void tw__link(struct tw_node *h, struct tw_node *n)
+{
+    n->prev = h->prev;
+    n->next = h;
+    h->prev->next = n;
+    h->prev = n;
+}
+
+// 노드를 리스트에서 뗀다. 그 때문에 슬롯이 비었으면 비트맵도 지운다.
+static inline void tw__unlink(struct timer_wheel *tw, struct tw_node *n)
+{
+    struct tw_node *h = n->prev;
+    n->prev->next = n->next;
+    n->next->prev = n->prev;
+    n->next = n->prev = NULL;
+    // 혼자 남은 노드는 머리 노드뿐이다. expired 가 아니면 슬롯 머리
+    if (h->next == h && h != &tw->expired) {
+        size_t i = (size_t)(h - &tw->slots[0][0]);
+        tw->bitmap[i / TW_SLOTS] &= ~(1ull << (i % TW_SLOTS));
+    }
+}
+
+// n->expires 에 맞는 레벨/슬롯에 넣는다. 남은 틱이 64^L 이상 64^(L+1) 미만이면 레벨 L
+static inline void tw__place(struct timer_wheel *tw, struct tw_node *n)
+{
+    uint32_t delta = n->expires - tw->now;
+    if ((int32_t)delta <= 0) {                  // 이미 지났으면 다음 틱에
+        n->expires = tw->now + 1;
+        delta = 1;
+    } else if (delta > TW_MAX_TICKS) {
+        n->expires = tw->now + TW_MAX_TICKS;
+        delta = TW_MAX_TICKS;
+    }
+    int lvl = (31 - __builtin_clz(delta)) / TW_BITS;
+    unsigned slot = (n->expires >> (TW_BITS * lvl)) & (TW_SLOTS - 1);
+    tw__link(&tw->slots[lvl][slot], n);
+    tw->bitmap[lvl] |= 1ull << slot;
+}
+
+// 절대 틱 expires 에 만료되도록 건다. 이미 걸려 있으면 옮긴다.
+static inline void tw_add_at(struct timer_wheel *tw, struct tw_node *n, uint32_t expires)
+{
+    if (tw_armed(n))
+        tw__unlink(tw, n);
+    else
+        tw->count++;
+    n->expires = expires;
+    tw__place(tw, n);
+}
+
+static inline void tw_add(struct timer_wheel *tw, struct tw_node *n, uint64_t timeout_ms)
+{
+    tw_add_at(tw, n, tw->now + tw_ms_to_ticks(tw, timeout_ms));
+}
+
+static inline void tw_del(struct timer_wheel *tw, struct tw_node *n)
+{
+    if (!tw_armed(n))
+        return;
+    tw__unlink(tw, n);
+    tw->count--;
+}
+
+// 레벨 lvl 의 slot 에 있는 타이머를 모두 현재 시각 기준으로 다시 배치한다 (아래 레벨로 내려감)
+static inline void tw__cascade(struct timer_wheel *tw, int lvl, unsigned slot)
+{
+    struct tw_node *h = &tw->slots[lvl][slot];
+    tw->bitmap[lvl] &= ~(1ull << slot);
+    while (h->next != h) {
+        struct tw_node *n = h->next;
+        h->next = n->next;
+        n->next->prev = h;
+        if (n->expires == tw->now)
+            tw__link(&tw->expired, n);          // 딱 지금 만료: 한 틱 늦추지 않는다
+        else
+            tw__place(tw, n);
+    }
+}
+
+// 지금 틱 다음으로 할 일이 있는 틱: 레벨 0 의 다음 비어 있지 않은 슬롯, 없으면 다음 cascade 지점
+static inline uint32_t tw__next_tick(const struct timer_wheel *tw)
+{
+    unsigned pos = tw->now & (TW_SLOTS - 1);
+    uint64_t ahead = pos == TW_SLOTS - 1 ? 0 : tw->bitmap[0] & (~0ull << (pos + 1));
+    if (ahead)
+        return (tw->now & ~(TW_SLOTS - 1)) + (uint32_t)__builtin_ctzll(ahead);
+    return (tw->now | (TW_SLOTS - 1)) + 1;
+}
+
+// now_ms 까지 시간을 진행한다. 만료된 타이머는 tw_pop 으로 꺼낸다.
+static inline void tw_advance(struct timer_wheel *tw, uint64_t now_ms)
+{
+    uint32_t target = (uint32_t)((now_ms - tw->base_ms) / tw->tick_ms);
+
+    if (tw->count == 0) {                       // 걸린 타이머가 없으면 시각만 맞춘다
+        if ((int32_t)(target - tw->now) > 0)
+            tw->now = target;
+        return;
+    }
+    while ((int32_t)(target - tw->now) > 0) {
+        uint32_t t = tw__next_tick(tw);         // 빈 틱은 건너뛴다
+        if ((int32_t)(t - target) > 0) {
+            tw->now = target;
+            break;
+        }
+        tw->now = t;
+
+        unsigned idx = t & (TW_SLOTS - 1);
+        // 레벨 0 이 한 바퀴 돌았으면 위 레벨 슬롯을 내린다 (레벨 1 인덱스도 0 이면 레벨 2 도)
+        for (int l = 1; idx == 0 && l < TW_LEVELS; l++) {
+            unsigned s = (t >> (TW_BITS * l)) & (TW_SLOTS - 1);
+            if (tw->bitmap[l] & (1ull << s))
+                tw__cascade(tw, l, s);
+            if (s != 0)
+                break;
+        }
+
+        struct tw_node *h = &tw->slots[0][idx];
+        if (h->next != h) {                     // 슬롯 전체를 expired 목록 뒤에 붙인다
+            struct tw_node *first = h->next, *last = h->prev;
+            first->prev = tw->expired.prev;
+            tw->expired.prev->next = first;
+            last->next = &tw->expired;
+            tw->expired.prev = last;
+            tw__empty(h);
+            tw->bitmap[0] &= ~(1ull << idx);
+        }
+    }
+}
+
+// 만료된 타이머를 하나 꺼낸다. 꺼낸 노드는 걸려 있지 않은 상태가 된다 (다시 걸어도 됨)
+static inline struct tw_node *tw_pop(struct timer_wheel *tw)
+{
+    struct tw_node *n = tw->expired.next;
+    if (n == &tw->expired)
+        return NULL;
+    tw__unlink(tw, n);
+    tw->count--;
+    return n;
+}
+
+// 다음으로 깨어나야 할 때까지 남은 ms. 걸린 타이머가 없으면 -1 (epoll_wait 의 무한 대기)
+static inline int tw_timeout_ms(const struct timer_wheel *tw, uint64_t now_ms)
+{
+    if (tw->expired.next != &tw->expired)
+        return 0;
+    if (tw->count == 0)
+        return -1;
+
+    uint32_t best = tw->now + TW_MAX_TICKS;
+    for (int l = 0; l < TW_LEVELS; l++) {
+        uint64_t bits = tw->bitmap[l];
+        if (!bits)
+            continue;
+        // 레벨 l 의 슬롯 s 는 인덱스가 s 가 되는 틱에 처리된다. 현재 인덱스 이후 첫 슬롯을 찾는다
+        unsigned shift = TW_BITS * l;
+        unsigned cur = (tw->now >> shift) & (TW_SLOTS - 1);
+        uint64_t ahead = cur == TW_SLOTS - 1 ? 0 : bits & (~0ull << (cur + 1));
+        unsigned d = ahead ? (unsigned)__builtin_ctzll(ahead) - cur
+                           : (unsigned)__builtin_ctzll(bits) + TW_SLOTS - cur;
+        uint32_t t = ((tw->now >> shift) + d) << shift;
+        if ((int32_t)(t - best) < 0)
+            best = t;
+    }
+
+    // now_ms 가 tw->now 보다 lag 틱 + frac ms 앞서 있을 수 있다 (아직 tw_advance 전)
+    uint64_t elapsed = now_ms - tw->base_ms;
+    uint32_t lag  = (uint32_t)(elapsed / tw->tick_ms) - tw->now;
+    uint32_t frac = (uint32_t)(elapsed % tw->tick_ms);
+    uint32_t left = best - tw->now;
+    if ((int32_t)lag < 0)
+        lag = 0;
+    if (left <= lag)
+        return 0;
+    uint64_t ms = (uint64_t)(left - lag) * tw->tick_ms - frac;
+    return ms > INT_MAX ? INT_MAX : (int)ms;
+}
+
+#endif /* TIMER_WHEEL_H */
@@ -0,0 +1,346 @@
+/* udp_blast.c — UDP 에코 서버 부하 발생기 (정해진 속도로 보내고 유실/순서/RTT 를 잰다)
+ *
+ *   gcc -O2 -o udp_blast udp_blast.c
+ *   ./udp_blast --port 9190 --rate 10000 --duration 10                 # 초당 1만 개
+ *   ./udp_blast --port 9190 --rate 50k,100k,200k,400k --flows 8       # 속도마다 한 줄
+ *   ./udp_blast --port 9190 --bitrate 100M,500M --size 1000            # 비트 속도로 (IP/UDP 머리 28바이트 포함)
+ *
+ * 데이터그램마다 실행 번호, 일련번호, 보낸 시각을 넣어 보낸다. 보낼 시각은 (시작 + seq / rate) 로 미리 정해 두고,
+ * 그 시각이 지난 것을 sendmmsg 로 몰아 보낸다 (open-loop). 남은 시간이 길면 ppoll 로 자고, 짧으면 돌면서 기다린다.
+ * 에코가 돌아오면 (받은 시각 - 보낸 시각) 을 RTT 로 기록한다. --timeout 안에 안 온 것은 유실이다.
+ * 결과: 실제 보낸 속도, 받은 속도, 유실률, 늦게 온 것(timeout 뒤), 순서 바뀜, 중복, RTT 분포 (p50/p99/p999/max)
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <getopt.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "hdr_histogram.h"
+
+#define MAX_SWEEP 16               // --rate / --bitrate 목록 최대 길이
+#define MAX_FLOWS 256
+#define MAX_SIZE 1024              // udp_server.c 의 BUF_SIZE. 넘으면 서버가 잘라서 돌려준다
+#define IP_UDP_HDR 28              // --bitrate 환산에 넣는 IPv4 + UDP 머리
+#define RECV_BATCH 64
+#define SPIN_NS 100000             // 다음 보낼 시각까지 이보다 가까우면 자지 않고 돈다 (ppoll 이 늦게 깨는 만큼)
+#define BLAST_MAGIC 0x55424c53u    // "UBLS"
+
+// 데이터그램 머리. 서버가 그대로 돌려주므로 같은 기계에서 쓰고 읽는다 (바이트 순서 변환 없음)
+struct blast_hdr {
+    uint32_t magic;
+    uint32_t run_id;
+    uint64_t seq;
+    uint64_t sent_ns;              // 실제로 sendmmsg 하기 직전 시각
+};
+
+static const char *host = "127.0.0.1";
+static int port = 9190;
+static double rate_list[MAX_SWEEP] = { 10000 };
+static int nrate_list = 1;
+static int bitrate;                // 목록이 --bitrate (초당 비트) 로 주어졌다
+static size_t size = 64;           // 데이터그램 크기 (머리 포함)
+static double duration = 10, warmup = 1, timeout = 1;
+static int nflows = 1;             // 소켓 수. 출발 포트가 달라서 SO_REUSEPORT 워커들에 나뉜다
+static int burst = 32;             // sendmmsg 한 번에 보낼 최대 개수 (밀렸을 때)
+
+static uint32_t run_id;
+static int fds[MAX_FLOWS];
+static uint8_t *seen;              // seq 마다 에코를 받았는지
+static uint64_t max_seq[MAX_FLOWS]; // 흐름마다 지금까지 받은 가장 큰 seq + 1 (순서 바뀜 판정)
+static uint64_t warm_seq;          // 이 seq 부터 센다
+static uint64_t received, late, reordered, dups, send_errors;
+static struct hdr_histogram hist;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int open_flow(const struct sockaddr_in *addr)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (fd == -1)
+        return -1;
+    int buf = 4 << 20;             // 순간적으로 몰아 보내고 몰아 받아도 소켓 버퍼에서 잃지 않게
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+    if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void on_echo(int flow, const char *p, size_t len, uint64_t now, uint64_t total)
+{
+    struct blast_hdr h;
+    if (len < sizeof(h))
+        return;
+    memcpy(&h, p, sizeof(h));
+    if (h.magic != BLAST_MAGIC || h.run_id != run_id || h.seq >= total)
+        return;                    // 예전 실행의 늦은 에코 등
+    if (seen[h.seq]) {
+        if (h.seq >= warm_seq)
+            dups++;
+        return;
+    }
+    seen[h.seq] = 1;
+    if (h.seq < max_seq[flow]) {
+        if (h.seq >= warm_seq)
+            reordered++;
+    } else {
+        max_seq[flow] = h.seq + 1;
+    }
+    if (h.seq < warm_seq)
+        return;
+    uint64_t rtt = now - h.sent_ns;
+    if (rtt > (uint64_t)(timeout * 1e9)) {
+        late++;                    // 왔지만 기다린 시간을 넘겼다. 유실로 센다
+        return;
+    }
+    received++;
+    hdr_record(&hist, rtt);
+}
+
+// 모든 흐름에서 쌓인 에코를 다 걷어 온다
+static void drain_echoes(uint64_t total)
+{
+    static char bufs[RECV_BATCH][MAX_SIZE];
+    struct mmsghdr msgs[RECV_BATCH];
+    struct iovec iov[RECV_BATCH];
+    for (int f = 0; f < nflows; f++) {
+        for (;;) {
+            memset(msgs, 0, sizeof(msgs));
+            for (int i = 0; i < RECV_BATCH; i++) {
+                iov[i].iov_base = bufs[i];
+                iov[i].iov_len = MAX_SIZE;
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            int m = recvmmsg(fds[f], msgs, RECV_BATCH, 0, NULL);
+            if (m <= 0)
+                break;             // EAGAIN, 또는 서버가 없어 돌아온 ECONNREFUSED
+            uint64_t now = now_ns();
+            for (int i = 0; i < m; i++)
+                on_echo(f, bufs[i], msgs[i].msg_len, now, total);
+            if (m < RECV_BATCH)
+                break;
+        }
+    }
+}
+
+// deadline 까지 에코를 기다린다. 너무 가까우면 자지 않는다
+static void wait_until(uint64_t deadline, uint64_t total)
+{
+    struct pollfd pfds[MAX_FLOWS];
+    uint64_t now = now_ns();
+    if (deadline > now + SPIN_NS) {
+        for (int f = 0; f < nflows; f++) {
+            pfds[f].fd = fds[f];
+            pfds[f].events = POLLIN;
+        }
+        uint64_t ns = deadline - now - SPIN_NS / 2;
+        struct timespec ts = { .tv_sec = ns / 1000000000ull, .tv_nsec = ns % 1000000000ull };
+        ppoll(pfds, nflows, &ts, NULL);
+    }
+    drain_echoes(total);
+}
+
+static void run(double rate_arg)
+{
+    double pps = bitrate ? rate_arg / ((size + IP_UDP_HDR) * 8.0) : rate_arg;
+    uint64_t total = (uint64_t)(pps * (warmup + duration));
+    if (total == 0) {
+        printf("%12.0f  (rate too low for %.0fs)\n", rate_arg, warmup + duration);
+        return;
+    }
+    warm_seq = (uint64_t)(pps * warmup);
+    seen = calloc(total, 1);
+    if (!seen) {
+        perror("calloc");
+        exit(1);
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        fprintf(stderr, "bad host %s\n", host);
+        exit(1);
+    }
+    for (int f = 0; f < nflows; f++) {
+        if ((fds[f] = open_flow(&addr)) == -1) {
+            perror("socket");
+            exit(1);
+        }
+        max_seq[f] = 0;
+    }
+    received = late = reordered = dups = send_errors = 0;
+    hdr_init(&hist);
+    run_id = (uint32_t)getpid() << 8 ^ (uint32_t)now_ns();
+
+    // 보내기: seq 의 예약 시각은 start + seq / pps. 지난 것을 burst 개씩 끊어 흐름에 돌아가며 보낸다
+    char (*bufs)[MAX_SIZE] = calloc(burst, MAX_SIZE);
+    struct mmsghdr *msgs = calloc(burst, sizeof(*msgs));
+    struct iovec *iov = calloc(burst, sizeof(*iov));
+    if (!bufs || !msgs || !iov) {
+        perror("calloc");
+        exit(1);
+    }
+    for (int i = 0; i < burst; i++) {
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len = size;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    uint64_t start = now_ns();
+    uint64_t next = 0, max_behind = 0, warm_start = 0, send_done = 0;
+    int flow = 0;
+    while (next < total) {
+        uint64_t now = now_ns();
+        uint64_t due = (uint64_t)((now - start) * pps / 1e9) + 1;   // 지금까지 보냈어야 할 개수
+        if (due > total)
+            due = total;
+        if (due <= next) {
+            wait_until(start + (uint64_t)(next * 1e9 / pps), total);
+            continue;
+        }
+        uint64_t behind = now - (start + (uint64_t)(next * 1e9 / pps));
+        if (behind > max_behind && next >= warm_seq)
+            max_behind = behind;
+        int n = due - next > (uint64_t)burst ? burst : (int)(due - next);
+        for (int i = 0; i < n; i++) {
+            struct blast_hdr h = { BLAST_MAGIC, run_id, next + i, now };
+            memcpy(bufs[i], &h, sizeof(h));
+        }
+        int k = sendmmsg(fds[flow], msgs, n, 0);
+        if (k > 0) {
+            if (next < warm_seq && next + k >= warm_seq)
+                warm_start = now;
+            next += k;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            wait_until(now, total);   // 송신 버퍼가 찼다. 에코부터 받고 다시 (그만큼 밀린다)
+            continue;
+        } else {
+            send_errors++;            // ECONNREFUSED: 서버가 없다는 ICMP. 그 데이터그램은 잃은 것으로 친다
+            next++;
+        }
+        flow = (flow + 1) % nflows;
+        drain_echoes(total);
+    }
+    send_done = now_ns();
+    if (!warm_start)
+        warm_start = start;
+
+    // 마지막으로 보낸 것까지 timeout 만큼 더 기다린다
+    uint64_t end = send_done + (uint64_t)(timeout * 1e9);
+    uint64_t counted = total - warm_seq;
+    while (now_ns() < end && received + late < counted)
+        wait_until(end, total);
+
+    double secs = (send_done - warm_start) / 1e9;
+    uint64_t lost = counted - received;
+    printf("%12.0f %10.0f %10.0f %10.0f %7.3f%% %7llu %8llu %6llu %8.1f %8.1f %8.1f %8.1f %8.1f\n",
+           rate_arg, pps, counted / secs, received / secs, 100.0 * lost / counted,
+           (unsigned long long)late, (unsigned long long)reordered, (unsigned long long)dups,
+           hdr_percentile(&hist, 50.0) / 1e3, hdr_percentile(&hist, 99.0) / 1e3,
+           hdr_percentile(&hist, 99.9) / 1e3, hist.max / 1e3, max_behind / 1e6);
+    if (send_errors)
+        printf("             %llu send errors (server not reachable?)\n", (unsigned long long)send_errors);
+    fflush(stdout);
+
+    for (int f = 0; f < nflows; f++)
+        close(fds[f]);
+    free(bufs);
+    free(msgs);
+    free(iov);
+    free(seen);
+}
+
+// "1000,2000,5000" 같은 목록. k/M/G 접미사를 받는다 (100k, 1.5M)
+static int parse_list(const char *s, double *out)
+{
+    int n = 0;
+    while (*s && n < MAX_SWEEP) {
+        char *end;
+        double v = strtod(s, &end);
+        if (end == s)
+            return 0;
+        switch (*end) {
+        case 'k': case 'K': v *= 1e3; end++; break;
+        case 'm': case 'M': v *= 1e6; end++; break;
+        case 'g': case 'G': v *= 1e9; end++; break;
+        }
+        out[n++] = v;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage : %s [--host IP] [--port N] [--rate PPS[,...] | --bitrate BPS[,...]] [--size BYTES]\n"
+           "               [--duration SEC] [--warmup SEC] [--timeout SEC] [--flows N] [--burst N]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_opts[] = {
+        {"host", required_argument, NULL, 'h'},
+        {"port", required_argument, NULL, 'p'},
+        {"rate", required_argument, NULL, 'r'},
+        {"bitrate", required_argument, NULL, 'b'},
+        {"size", required_argument, NULL, 's'},
+        {"duration", required_argument, NULL, 'd'},
+        {"warmup", required_argument, NULL, 'w'},
+        {"timeout", required_argument, NULL, 't'},
+        {"flows", required_argument, NULL, 'f'},
+        {"burst", required_argument, NULL, 'B'},
+        {NULL, 0, NULL, 0}
+    };
+    int ch;
+    while ((ch = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+        switch (ch) {
+        case 'h': host = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 'r': nrate_list = parse_list(optarg, rate_list); bitrate = 0; break;
+        case 'b': nrate_list = parse_list(optarg, rate_list); bitrate = 1; break;
+        case 's': size = strtoul(optarg, NULL, 10); break;
+        case 'd': duration = atof(optarg); break;
+        case 'w': warmup = atof(optarg); break;
+        case 't': timeout = atof(optarg); break;
+        case 'f': nflows = atoi(optarg); break;
+        case 'B': burst = atoi(optarg); break;
+        default: usage(argv[0]); exit(1);
+        }
+    }
+    int bad = optind != argc || nrate_list == 0 || size < sizeof(struct blast_hdr) || size > MAX_SIZE ||
+              duration <= 0 || warmup < 0 || timeout <= 0 || nflows < 1 || nflows > MAX_FLOWS ||
+              burst < 1 || burst > 1024;
+    for (int i = 0; i < nrate_list; i++)
+        bad |= rate_list[i] <= 0;
+    if (bad) {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    printf("%s:%d, size %zu, flows %d, warmup %.0fs, duration %.0fs, timeout %.1fs (rtt in us, behind in ms)\n",
+           host, port, size, nflows, warmup, duration, timeout);
+    printf("%12s %10s %10s %10s %8s %7s %8s %6s %8s %8s %8s %8s %8s\n",
+           bitrate ? "bit/s" : "rate/s", "pps", "tx pps", "rx pps", "loss", "late", "reorder", "dup",
+           "p50", "p99", "p999", "max", "behind");
+    for (int i = 0; i < nrate_list; i++)
+        run(rate_list[i]);
+    return 0;
+}
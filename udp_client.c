@@ -1,15 +1,124 @@
 /* udp_client.c */
+#define _GNU_SOURCE // sendmmsg / recvmmsg
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/time.h> // struct timeval (SO_RCVTIMEO)
+#include <getopt.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <netinet/udp.h> // UDP_SEGMENT, UDP_GRO
 
 #define BUF_SIZE 1024
+#define SUPER_SEGS 63          // GSO 한 번에 보낼 세그먼트 수 (63 * 1024 가 UDP 최대 페이로드 65507 안에 든다)
+#define GRO_BUF_SIZE 65535
+#define RECV_BATCH 64
+#define BULK_WINDOW (256 * 1024) // 답장을 기다리는 바이트 상한 (서버 수신 큐를 넘치지 않게)
+#define RECV_TIMEOUT_SEC 2        // 대화형: 답장을 기다리는 시간
+#define BULK_LOSS_MS 50          // 이만큼 답장이 없으면 기다리던 것을 잃은 것으로 친다
 
 void error_handling(char *message);
 
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// --bulk: BULK_WINDOW 만큼 답장을 기다리며 BUF_SIZE 데이터그램을 계속 보내고, 돌아온 바이트로 처리량을 잰다.
+// --gso 면 UDP_SEGMENT 를 걸어 두고 63 개 분량을 send 한 번으로, 아니면 sendmmsg 한 번에 63 개를 보낸다.
+// --gro 면 UDP_GRO 로 뭉친 답장을 64KB 버퍼로 받는다. 둘 다 커널이 지원하지 않으면 알리고 보통 경로로 돈다
+static void run_bulk(int sock, double secs, int gso, int gro)
+{
+    static char sbuf[SUPER_SEGS * BUF_SIZE];
+    int opt = BUF_SIZE;
+    if (gso && setsockopt(sock, SOL_UDP, UDP_SEGMENT, &opt, sizeof(opt)) == -1) {
+        fprintf(stderr, "UDP_SEGMENT not supported (%s), sending datagrams one by one\n", strerror(errno));
+        gso = 0;
+    }
+    opt = 1;
+    if (gro && setsockopt(sock, SOL_UDP, UDP_GRO, &opt, sizeof(opt)) == -1) {
+        fprintf(stderr, "UDP_GRO not supported (%s), receiving datagrams one by one\n", strerror(errno));
+        gro = 0;
+    }
+
+    int rsize = gro ? GRO_BUF_SIZE : BUF_SIZE;
+    char *rbuf = malloc((size_t)RECV_BATCH * rsize);
+    struct mmsghdr smsg[SUPER_SEGS], rmsg[RECV_BATCH];
+    struct iovec siov[SUPER_SEGS], riov[RECV_BATCH];
+    if (!rbuf)
+        error_handling("malloc() error");
+    memset(smsg, 0, sizeof(smsg));
+    memset(rmsg, 0, sizeof(rmsg));
+    for (int i = 0; i < SUPER_SEGS; i++) {
+        siov[i].iov_base = sbuf + i * BUF_SIZE;
+        siov[i].iov_len = BUF_SIZE;
+        smsg[i].msg_hdr.msg_iov = &siov[i];
+        smsg[i].msg_hdr.msg_iovlen = 1;
+    }
+    for (int i = 0; i < RECV_BATCH; i++) {
+        riov[i].iov_base = rbuf + (size_t)i * rsize;
+        riov[i].iov_len = rsize;
+        rmsg[i].msg_hdr.msg_iov = &riov[i];
+        rmsg[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    unsigned long long sent = 0, echoed = 0, lost = 0, send_calls = 0, recv_calls = 0;
+    double start = now_sec(), last_rx = start, end = start + secs;
+    while (now_sec() < end) {
+        while (sent - echoed - lost + sizeof(sbuf) <= BULK_WINDOW) {
+            ssize_t k;
+            if (gso) {
+                k = send(sock, sbuf, sizeof(sbuf), 0);
+                // 체크섬 오프로드가 없는 장치(EIO), GSO 를 모르는 옛 커널(EINVAL/ENOPROTOOPT)
+                if (k == -1 && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT)) {
+                    fprintf(stderr, "UDP_SEGMENT send failed (%s), sending datagrams one by one\n",
+                            strerror(errno));
+                    opt = 0;
+                    setsockopt(sock, SOL_UDP, UDP_SEGMENT, &opt, sizeof(opt));
+                    gso = 0;
+                    continue;
+                }
+            } else {
+                k = sendmmsg(sock, smsg, SUPER_SEGS, 0);
+                if (k > 0)
+                    k *= BUF_SIZE;
+            }
+            if (k <= 0)
+                break;               // 송신 버퍼가 찼다 (EAGAIN). 답장부터 받는다
+            send_calls++;
+            sent += k;
+        }
+        struct pollfd pfd = { .fd = sock, .events = POLLIN };
+        if (poll(&pfd, 1, BULK_LOSS_MS) <= 0) {
+            if (now_sec() - last_rx >= BULK_LOSS_MS / 1000.0) {
+                lost = sent - echoed;  // 기다리던 것은 잃었다. 창을 비우고 다시 보낸다
+                last_rx = now_sec();
+            }
+            continue;
+        }
+        int m = recvmmsg(sock, rmsg, RECV_BATCH, MSG_DONTWAIT, NULL);
+        if (m <= 0)
+            continue;
+        recv_calls++;
+        for (int i = 0; i < m; i++)
+            echoed += rmsg[i].msg_len;
+        if (echoed + lost > sent)    // 잃은 줄 알았던 답장이 늦게 왔다
+            lost = sent - echoed;
+        last_rx = now_sec();
+    }
+    double el = now_sec() - start;
+    printf("bulk%s%s: %.1f s, sent %.1f MB, echoed %.1f MB (%.1f MB/s, %.0f pkt/s), lost %.1f%%, %llu send calls, %llu recv calls\n",
+           gso ? " gso" : "", gro ? " gro" : "", el, sent / 1e6, echoed / 1e6, echoed / el / 1e6,
+           echoed / el / BUF_SIZE, sent ? 100.0 * lost / sent : 0.0, send_calls, recv_calls);
+    free(rbuf);
+}
+
 int main(int argc, char *argv[])
 {
     int sock;
@@ -21,8 +130,32 @@ int main(int argc, char *argv[])
     // from_adr: 메시지를 "받은" 서버의 주소 (확인용)
     struct sockaddr_in serv_adr, from_adr;
 
-    if (argc != 3) {
-        printf("Usage : %s <IP> <port>\n", argv[0]);
+    double bulk = 0;
+    int gso = 0, gro = 0;
+    static const struct option long_opts[] = {
+        {"bulk", required_argument, NULL, 'b'}, // 대화형 대신 SEC 초 동안 처리량 측정
+        {"gso", no_argument, NULL, 's'},        // --bulk: UDP_SEGMENT 로 뭉쳐 보내기
+        {"gro", no_argument, NULL, 'r'},        // --bulk: UDP_GRO 로 뭉쳐 받기
+        {NULL, 0, NULL, 0}
+    };
+    int c, bad = 0;
+    while ((c = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'b':
+            bulk = atof(optarg);
+            break;
+        case 's':
+            gso = 1;
+            break;
+        case 'r':
+            gro = 1;
+            break;
+        default:
+            bad = 1;
+        }
+    }
+    if (bad || optind != argc - 2 || bulk < 0) {
+        printf("Usage : %s [--bulk SEC [--gso] [--gro]] <IP> <port>\n", argv[0]);
         exit(1);
     }
 
@@ -34,11 +167,24 @@ int main(int argc, char *argv[])
     // "받는 사람" (서버)의 주소 구조체 설정
     memset(&serv_adr, 0, sizeof(serv_adr));
     serv_adr.sin_family = AF_INET;
-    serv_adr.sin_addr.s_addr = inet_addr(argv[1]); // 서버 IP
-    serv_adr.sin_port = htons(atoi(argv[2]));      // 서버 Port
+    serv_adr.sin_addr.s_addr = inet_addr(argv[optind]);    // 서버 IP
+    serv_adr.sin_port = htons(atoi(argv[optind + 1]));      // 서버 Port
+
+    if (bulk > 0) {
+        // 상대가 하나뿐이라 connect 해 두고 send/recv 로 주고받는다 (GSO 는 주소 없이 send 한 번)
+        if (connect(sock, (struct sockaddr*)&serv_adr, sizeof(serv_adr)) == -1)
+            error_handling("connect() error");
+        run_bulk(sock, bulk, gso, gro);
+        close(sock);
+        return 0;
+    }
     
     // 2. connect() 과정이 없습니다!
 
+    // 답장이 유실되면 recvfrom 이 영원히 막힌다. RECV_TIMEOUT_SEC 만 기다리고 다음 입력으로 넘어간다
+    struct timeval tv = { .tv_sec = RECV_TIMEOUT_SEC };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
     while (1) 
     {
         fputs("Input message (Q to quit): ", stdout);
@@ -56,8 +202,12 @@ int main(int argc, char *argv[])
         
         // 4. 데이터 수신 (recvfrom)
         // 서버로부터 온 에코 메시지를 받음
-        str_len = recvfrom(sock, message, BUF_SIZE, 0, 
+        str_len = recvfrom(sock, message, BUF_SIZE - 1, 0, 
                            (struct sockaddr*)&from_adr, &adr_sz);
+        if (str_len == -1) {
+            puts(errno == EAGAIN || errno == EWOULDBLOCK ? "(no reply: timed out)" : strerror(errno));
+            continue;
+        }
         
         message[str_len] = 0; // 문자열 종료 처리
         printf("Message from server: %s", message);
@@ -1,28 +1,694 @@
 /* udp_server.c */
+#define _GNU_SOURCE // recvmmsg / sendmmsg, pthread_setaffinity_np
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/udp.h> // UDP_SEGMENT, UDP_GRO
+#include "fastlog.h" // 비동기 로거: 데이터그램마다 printf 하지 않고 링 버퍼에 넣는다
+#include "rudp.h"    // --rudp: UDP 위의 다중 스트림 신뢰 전송
 
 #define BUF_SIZE 1024
+#define MAX_BATCH 1024    // --batch 상한 (recvmmsg 한 번에 받을 데이터그램 수)
+#define DEFAULT_BATCH 32  // --workers 만 주고 --batch 를 안 주면
+#define MAX_WORKERS 256
+#define GRO_BUF_SIZE 65535 // --gro: 뭉쳐 받는 버퍼 하나 (UDP 페이로드 최대)
+#define GRO_MAX_SEGS 64    // 커널이 한 번에 뭉치는 세그먼트 수 상한 (UDP_GRO_CNT_MAX)
+#define RCONN_BUCKETS 1024 // --rudp: 워커마다 (주소, conn_id) 해시 버킷 수
+#define RUDP_MAX_CONNS 1024 // --rudp: 워커마다 동시 연결 수 기본 상한 (--max-conns)
+#define RUDP_TX_BATCH 64   // --rudp: sendmmsg 한 번에 보낼 데이터그램 수
+#define RCONN_ECHO_MAX RUDP_STREAM_WIN // --rudp: 연결마다 ACK 를 기다리는 에코 바이트 상한. 넘으면 넘겨받기를 멈춘다
+#define RCONN_RBUF_POOL 64 // --rudp: 워커마다 잡을 수 있는 수신 링(RUDP_STREAM_WIN) 수
+
+enum { EV_DGRAM, EV_DROP }; // FASTLOG_SAMPLE=dgram=1000 이면 1000 개 중 하나만 기록
+static const char *const log_events[] = { "dgram", "drop" };
 
 void error_handling(char *message);
 
+// 워커 하나 = 스레드 하나 = 소켓 하나. 카운터는 워커만 쓰고 --stats 스레드가 읽는다.
+// 워커끼리 캐시 라인을 나눠 쓰지 않도록 64바이트로 맞춘다
+struct worker {
+    int id;
+    int sock;
+    int batch;
+    int pin;
+    int gro;            // UDP_GRO 가 켜졌다: 한 번에 최대 64KB 를 받고 cmsg 로 세그먼트 크기를 받는다
+    int tx_gso;         // 뭉쳐 받은 것을 UDP_SEGMENT 로 한 번에 돌려보낸다 (안 되면 0 으로 내리고 쪼개서 보낸다)
+    const struct rudp_cc_ops *rudp; // --rudp: 그대로 돌려보내지 않고 rudp 연결로 받아 스트림을 에코한다
+    int max_conns;      // --rudp: 이 워커의 연결 상한. 차면 새 conn_id 는 버린다
+    pthread_t tid;
+    uint64_t pkts __attribute__((aligned(64))); // 받은 데이터그램 수 (GRO 로 뭉친 것은 세그먼트 수)
+    uint64_t bytes;                             // 받은 바이트
+    uint64_t rx_drops;  // 소켓 수신 큐가 넘쳐 커널이 버린 수 (SO_RXQ_OVFL, 소켓 누적값)
+    uint64_t tx_drops;  // 송신 버퍼가 차서 못 보낸 답장 수
+};
+
+static struct worker workers[MAX_WORKERS];
+
+// --batch 모드에서 쓰는 배열. 시작할 때 한 번 잡고 바퀴마다 그대로 다시 쓴다
+struct batch {
+    struct mmsghdr *msgs;        // recvmmsg 헤더
+    struct iovec *iov;           // 데이터그램마다 버퍼 하나
+    struct sockaddr_in *addrs;   // 보낸 쪽 주소 (받은 그대로 답장 주소가 된다)
+    char *bufs;                  // size * n
+    char *ctrl;                  // CTRL_SIZE * n: 받을 때 SO_RXQ_OVFL/UDP_GRO, 보낼 때 UDP_SEGMENT cmsg 자리
+    uint16_t *gso;               // 받은 데이터그램의 GRO 세그먼트 크기 (0 이면 뭉치지 않은 것)
+    struct mmsghdr *out;         // sendmmsg 헤더. GSO 를 못 쓰면 세그먼트마다 하나라서 n * max_segs 칸
+    struct iovec *out_iov;
+    int *owner;                  // out[j] 가 몇 번째로 받은 데이터그램의 답장인지
+    int n;
+    int size;                    // 버퍼 하나 크기: BUF_SIZE, GRO 면 GRO_BUF_SIZE, rudp 면 RUDP_MAX_PKT
+    int max_segs;
+};
+
+#define CTRL_SIZE (CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(int)))
+
+static void batch_init(struct batch *b, int n, int size, int max_segs)
+{
+    b->n = n;
+    b->size = size;
+    b->max_segs = max_segs;
+    b->msgs = calloc(n, sizeof(*b->msgs));
+    b->iov = calloc(n, sizeof(*b->iov));
+    b->addrs = calloc(n, sizeof(*b->addrs));
+    b->bufs = malloc((size_t)n * b->size);
+    b->ctrl = calloc(n, CTRL_SIZE);
+    b->gso = calloc(n, sizeof(*b->gso));
+    b->out = calloc((size_t)n * b->max_segs, sizeof(*b->out));
+    b->out_iov = calloc((size_t)n * b->max_segs, sizeof(*b->out_iov));
+    b->owner = calloc((size_t)n * b->max_segs, sizeof(*b->owner));
+    if (!b->msgs || !b->iov || !b->addrs || !b->bufs || !b->ctrl || !b->gso || !b->out || !b->out_iov || !b->owner)
+        error_handling("malloc() error");
+    for (int i = 0; i < n; i++) {
+        b->iov[i].iov_base = b->bufs + (size_t)i * b->size;
+        b->msgs[i].msg_hdr.msg_iov = &b->iov[i];
+        b->msgs[i].msg_hdr.msg_iovlen = 1;
+        b->msgs[i].msg_hdr.msg_name = &b->addrs[i];
+    }
+}
+
+// 받은 데이터그램에 붙어 온 cmsg 를 읽는다.
+//  - SO_RXQ_OVFL: 커널은 드롭이 한 번이라도 있었던 소켓에만 붙인다 (없으면 *drops 그대로)
+//  - UDP_GRO: 여러 데이터그램을 뭉쳐 받았을 때 세그먼트 크기 (마지막 세그먼트만 더 짧을 수 있다)
+static void parse_cmsgs(struct msghdr *mh, uint32_t *drops, uint16_t *gso)
+{
+    *gso = 0;
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(mh); cm; cm = CMSG_NXTHDR(mh, cm)) {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_RXQ_OVFL) {
+            memcpy(drops, CMSG_DATA(cm), sizeof(*drops));
+        } else if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+            int size;
+            memcpy(&size, CMSG_DATA(cm), sizeof(size));
+            *gso = size;
+        }
+    }
+}
+
+// i 번째로 받은 데이터그램의 답장을 out 에 붙인다. 뭉쳐 받은 것은 tx_gso 면 UDP_SEGMENT cmsg 를 달아
+// 한 칸으로 (커널이 같은 크기로 다시 쪼갠다), 아니면 세그먼트마다 한 칸씩 쪼개서 넣는다
+static int add_reply(struct worker *w, struct batch *b, int i, int nout)
+{
+    char *base = b->iov[i].iov_base;
+    int len = b->msgs[i].msg_len;
+    int seg = (b->gso[i] && len > b->gso[i]) ? b->gso[i] : len;
+    int whole = seg == len || w->tx_gso;
+
+    int off = 0;
+    do {
+        struct mmsghdr *o = &b->out[nout];
+        struct iovec *v = &b->out_iov[nout];
+        v->iov_base = base + off;
+        v->iov_len = whole ? len : (len - off < seg ? len - off : seg);
+        memset(o, 0, sizeof(*o));
+        o->msg_hdr.msg_iov = v;
+        o->msg_hdr.msg_iovlen = 1;
+        o->msg_hdr.msg_name = &b->addrs[i];
+        o->msg_hdr.msg_namelen = sizeof(b->addrs[i]);
+        if (whole && seg != len) {
+            char *ctrl = b->ctrl + (size_t)i * CTRL_SIZE;  // 받을 때 쓴 cmsg 자리는 다 읽었으니 다시 쓴다
+            o->msg_hdr.msg_control = ctrl;
+            o->msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+            struct cmsghdr *cm = CMSG_FIRSTHDR(&o->msg_hdr);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t gso = seg;
+            memcpy(CMSG_DATA(cm), &gso, sizeof(gso));
+        }
+        b->owner[nout++] = i;
+    } while (!whole && (off += seg) < len);
+    return nout;
+}
+
+// 받은 m 개를 그대로 돌려보낸다. 답장 헤더를 out 에 모아 sendmmsg 로 보낸다.
+// 중간에 실패한 데이터그램 하나는 건너뛰고, 송신 버퍼가 차면(EAGAIN) 나머지는 버린다.
+// (UDP 에코라서 기다려 봐야 늦은 답장일 뿐)
+// UDP_SEGMENT 로 보낸 것이 EIO/EINVAL/ENOPROTOOPT 로 실패하면 (체크섬 오프로드가 없는 장치, 옛 커널)
+// tx_gso 를 끄고 그 데이터그램부터 다시 쪼개서 보낸다
+static void echo_batch(struct worker *w, struct batch *b, int m)
+{
+    int nout = 0;
+    for (int i = 0; i < m; i++)
+        nout = add_reply(w, b, i, nout);
+
+    int off = 0;
+    while (off < nout) {
+        int k = sendmmsg(w->sock, b->out + off, nout - off, 0);
+        if (k > 0) {
+            off += k;
+            continue;
+        }
+        if (k == -1 && errno == EINTR)
+            continue;
+        if (k == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            __atomic_store_n(&w->tx_drops, w->tx_drops + (nout - off), __ATOMIC_RELAXED);
+            FLOG_EV(EV_DROP, FLOG_WARN, "worker %d: send buffer full, dropped %d replies", w->id, nout - off);
+            return;
+        }
+        if (b->out[off].msg_hdr.msg_controllen &&
+            (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT)) {
+            FLOG(FLOG_WARN, "worker %d: UDP_SEGMENT send failed (%s), falling back to per-datagram replies",
+                 w->id, strerror(errno));
+            w->tx_gso = 0;
+            int from = b->owner[off];
+            nout = off;
+            for (int i = from; i < m; i++)
+                nout = add_reply(w, b, i, nout);
+            continue;
+        }
+        FLOG_EV(EV_DROP, FLOG_WARN, "worker %d: sendmmsg to " FLOG_ADDR_FMT ": %s",
+                w->id, FLOG_ADDR_ARGS(&b->addrs[b->owner[off]]), strerror(errno));
+        off++; // 첫 데이터그램에서 실패했다. 그것만 빼고 계속
+    }
+}
+
+// 지금 스레드를 허용된 CPU 목록 중 (id % 개수) 번째 CPU 에 고정
+static void pin_to_cpu(int id)
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+        perror("sched_getaffinity");
+        return;
+    }
+    int ncpu = CPU_COUNT(&allowed);
+    if (ncpu <= 0)
+        return;
+    int target = id % ncpu;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed) || target-- > 0)
+            continue;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            FLOG(FLOG_WARN, "worker %d: pthread_setaffinity_np failed", id);
+        else
+            FLOG(FLOG_INFO, "worker %d pinned to cpu %d", id, cpu);
+        return;
+    }
+}
+
+// 워커 스레드. 논블로킹 소켓 하나를 epoll 로 기다리다가, 깨면 큐가 빌 때까지
+// recvmmsg 로 최대 batch 개씩 받아 sendmmsg 한 번으로 답한다
+static void *run_batch(void *arg)
+{
+    struct worker *w = arg;
+    int n = w->batch;
+    struct batch b;
+    batch_init(&b, n, w->gro ? GRO_BUF_SIZE : BUF_SIZE, w->gro ? GRO_MAX_SEGS : 1);
+    if (w->pin)
+        pin_to_cpu(w->id);
+
+    int epfd = epoll_create1(0);
+    if (epfd == -1)
+        error_handling("epoll_create1() error");
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = w };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, w->sock, &ev) == -1)
+        error_handling("epoll_ctl() error");
+
+    while (1) {
+        if (epoll_wait(epfd, &ev, 1, -1) == -1) {
+            if (errno == EINTR)
+                continue;
+            error_handling("epoll_wait() error");
+        }
+        while (1) {
+            for (int i = 0; i < n; i++) {
+                b.iov[i].iov_len = b.size;
+                b.msgs[i].msg_hdr.msg_namelen = sizeof(b.addrs[i]);
+                b.msgs[i].msg_hdr.msg_control = b.ctrl + (size_t)i * CTRL_SIZE;
+                b.msgs[i].msg_hdr.msg_controllen = CTRL_SIZE;
+            }
+            int m = recvmmsg(w->sock, b.msgs, n, 0, NULL);
+            if (m == -1) {
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    FLOG(FLOG_WARN, "worker %d: recvmmsg: %s", w->id, strerror(errno));
+                break;                                         // 비었다. epoll 로 돌아간다
+            }
+            uint64_t bytes = 0, pkts = 0;
+            uint32_t drops = w->rx_drops;                      // 누적값이라 마지막에 붙어 온 것이 최신이다
+            for (int i = 0; i < m; i++) {
+                unsigned len = b.msgs[i].msg_len;
+                parse_cmsgs(&b.msgs[i].msg_hdr, &drops, &b.gso[i]);
+                bytes += len;
+                pkts += b.gso[i] && len > b.gso[i] ? (len + b.gso[i] - 1) / b.gso[i] : 1;
+                FLOG_EV(EV_DGRAM, FLOG_INFO, "Message from client " FLOG_ADDR_FMT, FLOG_ADDR_ARGS(&b.addrs[i]));
+            }
+            __atomic_store_n(&w->rx_drops, drops, __ATOMIC_RELAXED);
+            __atomic_store_n(&w->pkts, w->pkts + pkts, __ATOMIC_RELAXED);
+            __atomic_store_n(&w->bytes, w->bytes + bytes, __ATOMIC_RELAXED);
+            echo_batch(w, &b, m);
+            if (m < n)
+                break;                                         // 덜 찼으면 큐가 빈 것. 헛도는 recvmmsg 하나를 아낀다
+        }
+    }
+    return NULL;
+}
+
+// --rudp 연결 하나. 워커 스레드만 만진다
+struct rconn {
+    struct rconn *hnext;         // 같은 해시 버킷
+    struct rconn *next, *prev;   // 워커의 모든 연결 (타이머를 돌 때)
+    struct sockaddr_in addr;
+    struct rudp_conn *rc;
+};
+
+struct rtable {
+    struct rconn *buckets[RCONN_BUCKETS];
+    struct rconn *head;
+    int n;
+    int rbuf_pool;               // 아직 잡을 수 있는 수신 링 수 (연결들의 rudp_conn.rbuf_pool 이 가리킨다)
+};
+
+// 보낼 데이터그램을 모았다가 sendmmsg 로 한 번에
+struct rtx {
+    struct mmsghdr msgs[RUDP_TX_BATCH];
+    struct iovec iov[RUDP_TX_BATCH];
+    uint8_t bufs[RUDP_TX_BATCH][RUDP_MAX_PKT];
+    int n;
+};
+
+static unsigned rconn_hash(const struct sockaddr_in *a, uint32_t id)
+{
+    uint32_t h = a->sin_addr.s_addr * 2654435761u ^ a->sin_port * 40503u ^ id * 2246822519u;
+    return (h ^ h >> 16) % RCONN_BUCKETS;
+}
+
+static struct rconn *rconn_find(struct rtable *t, const struct sockaddr_in *a, uint32_t id)
+{
+    for (struct rconn *r = t->buckets[rconn_hash(a, id)]; r; r = r->hnext)
+        if (r->rc->id == id && r->addr.sin_addr.s_addr == a->sin_addr.s_addr && r->addr.sin_port == a->sin_port)
+            return r;
+    return NULL;
+}
+
+// 스트림으로 받은 것을 같은 스트림으로 돌려보낸다 (rudp_input 안에서 불린다). 상대가 에코를 ACK 하지 않아
+// 밀린 것이 RCONN_ECHO_MAX 를 넘으면 그 스트림은 넘겨받기를 멈춘다. 받는 링이 차면 상대도 더 보내지 못한다
+static void rconn_on_data(void *arg, struct rudp_conn *c, uint32_t sid, const uint8_t *data, size_t len, int fin)
+{
+    (void)arg;
+    if (len && rudp_write(c, sid, data, len) == -1)
+        FLOG(FLOG_WARN, "rudp conn %08x: stream %u: rudp_write failed", c->id, sid);
+    if (fin)
+        rudp_finish(c, sid);
+    if (c->unacked >= RCONN_ECHO_MAX)
+        rudp_pause(c, sid);
+}
+
+static struct rconn *rconn_new(struct worker *w, struct rtable *t, const struct sockaddr_in *a, uint32_t id,
+                               uint64_t now)
+{
+    struct rconn *r = calloc(1, sizeof(*r));
+    if (!r || !(r->rc = rudp_conn_new(id, w->rudp, now))) {
+        free(r);
+        FLOG(FLOG_WARN, "worker %d: out of memory for rudp conn", w->id);
+        return NULL;
+    }
+    r->addr = *a;
+    r->rc->on_data = rconn_on_data;
+    r->rc->arg = r;
+    r->rc->rbuf_pool = &t->rbuf_pool;
+    unsigned h = rconn_hash(a, id);
+    r->hnext = t->buckets[h];
+    t->buckets[h] = r;
+    r->next = t->head;
+    if (t->head)
+        t->head->prev = r;
+    t->head = r;
+    t->n++;
+    FLOG(FLOG_INFO, "worker %d: rudp conn %08x from " FLOG_ADDR_FMT " (%s)", w->id, id, FLOG_ADDR_ARGS(a),
+         w->rudp->name);
+    return r;
+}
+
+static void rconn_free(struct worker *w, struct rtable *t, struct rconn *r, const char *why)
+{
+    struct rudp_stats *st = &r->rc->stats;
+    FLOG(FLOG_INFO, "worker %d: rudp conn %08x %s: sent %llu pkts (%llu lost, %llu retx bytes, %llu pto), "
+         "recv %llu pkts, srtt %llu us", w->id, r->rc->id, why,
+         (unsigned long long)st->pkts_sent, (unsigned long long)st->pkts_lost,
+         (unsigned long long)st->bytes_retx, (unsigned long long)st->pto_count,
+         (unsigned long long)st->pkts_recv, (unsigned long long)r->rc->srtt);
+    struct rconn **pp = &t->buckets[rconn_hash(&r->addr, r->rc->id)];
+    while (*pp != r)
+        pp = &(*pp)->hnext;
+    *pp = r->hnext;
+    if (r->prev)
+        r->prev->next = r->next;
+    else
+        t->head = r->next;
+    if (r->next)
+        r->next->prev = r->prev;
+    t->n--;
+    rudp_conn_free(r->rc);
+    free(r);
+}
+
+// 모아 둔 데이터그램을 보낸다. 송신 버퍼가 차면 나머지는 버린다 (rudp 가 잃은 것으로 보고 다시 보낸다)
+static void rtx_flush(struct worker *w, struct rtx *tx)
+{
+    int off = 0;
+    while (off < tx->n) {
+        int k = sendmmsg(w->sock, tx->msgs + off, tx->n - off, 0);
+        if (k > 0) {
+            off += k;
+            continue;
+        }
+        if (k == -1 && errno == EINTR)
+            continue;
+        if (k == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            __atomic_store_n(&w->tx_drops, w->tx_drops + (tx->n - off), __ATOMIC_RELAXED);
+            FLOG_EV(EV_DROP, FLOG_WARN, "worker %d: send buffer full, dropped %d rudp packets", w->id, tx->n - off);
+            break;
+        }
+        FLOG_EV(EV_DROP, FLOG_WARN, "worker %d: sendmmsg: %s", w->id, strerror(errno));
+        off++;
+    }
+    tx->n = 0;
+}
+
+// 연결 하나에서 지금 보낼 수 있는 것을 모두 꺼낸다
+static void rconn_output(struct worker *w, struct rtx *tx, struct rconn *r, uint64_t now)
+{
+    int len;
+    while ((len = rudp_output(r->rc, tx->bufs[tx->n], RUDP_MAX_PKT, now)) > 0) {
+        struct mmsghdr *m = &tx->msgs[tx->n];
+        tx->iov[tx->n].iov_base = tx->bufs[tx->n];
+        tx->iov[tx->n].iov_len = len;
+        memset(m, 0, sizeof(*m));
+        m->msg_hdr.msg_iov = &tx->iov[tx->n];
+        m->msg_hdr.msg_iovlen = 1;
+        m->msg_hdr.msg_name = &r->addr;
+        m->msg_hdr.msg_namelen = sizeof(r->addr);
+        if (++tx->n == RUDP_TX_BATCH)
+            rtx_flush(w, tx);
+    }
+}
+
+// --rudp 워커. run_batch 와 같이 recvmmsg 로 받되, 데이터그램을 (주소, conn_id) 로 찾은 연결에 넣고
+// 바퀴마다 모든 연결의 타이머와 보낼 것을 돌린다. epoll 은 가장 이른 rudp_timeout 까지만 기다린다
+// (연결이 없어도 1초마다 깨서 idle 연결을 치운다)
+static void *run_rudp(void *arg)
+{
+    struct worker *w = arg;
+    int n = w->batch;
+    struct batch b;
+    batch_init(&b, n, RUDP_MAX_PKT, 1);
+    struct rtable *t = calloc(1, sizeof(*t));
+    struct rtx *tx = calloc(1, sizeof(*tx));
+    if (!t || !tx)
+        error_handling("malloc() error");
+    t->rbuf_pool = RCONN_RBUF_POOL;
+    if (w->pin)
+        pin_to_cpu(w->id);
+
+    int epfd = epoll_create1(0);
+    if (epfd == -1)
+        error_handling("epoll_create1() error");
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = w };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, w->sock, &ev) == -1)
+        error_handling("epoll_ctl() error");
+
+    int wait_ms = 1000;
+    while (1) {
+        if (epoll_wait(epfd, &ev, 1, wait_ms) == -1 && errno != EINTR)
+            error_handling("epoll_wait() error");
+        for (int round = 0; round < 16; round++) {       // 큐가 계속 차 있어도 타이머가 밀리지 않게 몇 바퀴만
+            for (int i = 0; i < n; i++) {
+                b.iov[i].iov_len = b.size;
+                b.msgs[i].msg_hdr.msg_namelen = sizeof(b.addrs[i]);
+                b.msgs[i].msg_hdr.msg_control = b.ctrl + (size_t)i * CTRL_SIZE;
+                b.msgs[i].msg_hdr.msg_controllen = CTRL_SIZE;
+            }
+            int m = recvmmsg(w->sock, b.msgs, n, 0, NULL);
+            if (m == -1) {
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    FLOG(FLOG_WARN, "worker %d: recvmmsg: %s", w->id, strerror(errno));
+                break;
+            }
+            uint64_t now = rudp_now_us(), bytes = 0;
+            uint32_t drops = w->rx_drops;
+            for (int i = 0; i < m; i++) {
+                const uint8_t *p = (const uint8_t *)b.iov[i].iov_base;
+                unsigned len = b.msgs[i].msg_len;
+                parse_cmsgs(&b.msgs[i].msg_hdr, &drops, &b.gso[i]);
+                bytes += len;
+                int64_t id = rudp_conn_id(p, len);
+                if (id == -1) {
+                    FLOG_EV(EV_DROP, FLOG_WARN, "worker %d: non-rudp datagram from " FLOG_ADDR_FMT, w->id,
+                            FLOG_ADDR_ARGS(&b.addrs[i]));
+                    continue;
+                }
+                struct rconn *r = rconn_find(t, &b.addrs[i], (uint32_t)id);
+                if (!r) {
+                    // 핸드셰이크가 없으므로 처음 보는 conn_id 는 아무나 보낼 수 있다. 연결 하나가 버퍼를 잡고
+                    // RUDP_IDLE_US 동안 남으므로, 데이터(STREAM/PING)를 실은 것만 받고 개수도 상한까지만
+                    if (!rudp_opens_conn(p, len))
+                        continue;                              // 끝난 연결에 늦게 온 ACK/CLOSE 등
+                    if (t->n >= w->max_conns) {
+                        FLOG_EV(EV_DROP, FLOG_WARN, "worker %d: rudp conn limit %d reached, dropping conn %08x from "
+                                FLOG_ADDR_FMT, w->id, w->max_conns, (uint32_t)id, FLOG_ADDR_ARGS(&b.addrs[i]));
+                        continue;
+                    }
+                    if (!(r = rconn_new(w, t, &b.addrs[i], (uint32_t)id, now)))
+                        continue;
+                }
+                if (rudp_input(r->rc, p, len, now) == -1)
+                    FLOG_EV(EV_DROP, FLOG_WARN, "worker %d: rudp conn %08x: malformed datagram", w->id, r->rc->id);
+            }
+            __atomic_store_n(&w->rx_drops, drops, __ATOMIC_RELAXED);
+            __atomic_store_n(&w->pkts, w->pkts + m, __ATOMIC_RELAXED);
+            __atomic_store_n(&w->bytes, w->bytes + bytes, __ATOMIC_RELAXED);
+            if (m < n)
+                break;
+        }
+
+        // 연결마다 타이머 → 보내기. 다음에 깰 시각은 가장 이른 rudp_timeout
+        uint64_t now = rudp_now_us(), next = now + 1000000;
+        for (struct rconn *r = t->head, *nx; r; r = nx) {
+            nx = r->next;
+            if (r->rc->closed || rudp_idle(r->rc, now)) {
+                rconn_free(w, t, r, r->rc->closed ? "closed" : "idle");
+                continue;
+            }
+            if (r->rc->rpaused && r->rc->unacked < RCONN_ECHO_MAX / 2)   // 에코가 절반 넘게 ACK 되었다
+                rudp_resume(r->rc);
+            rudp_on_timer(r->rc, now);
+            rconn_output(w, tx, r, now);
+            uint64_t to = rudp_timeout(r->rc, now);
+            if (to < next)
+                next = to;
+        }
+        rtx_flush(w, tx);
+        now = rudp_now_us();
+        wait_ms = next <= now ? 0 : (int)((next - now + 999) / 1000);
+    }
+    return NULL;
+}
+
+// 워커마다 여는 소켓. 여러 개면 SO_REUSEPORT 로 같은 포트에 bind 해서
+// 커널이 4-tuple 해시로 흐름을 워커들에 나눠 준다
+static int create_worker_socket(int port, int reuseport, int *gro)
+{
+    struct sockaddr_in serv_adr;
+    int opt = 1;
+    int sock = socket(PF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (sock == -1)
+        return -1;
+    if (reuseport && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1)
+        goto fail;
+    if (setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof(opt)) == -1)
+        FLOG(FLOG_WARN, "SO_RXQ_OVFL not supported, rx drops will read 0");
+    if (*gro && setsockopt(sock, SOL_UDP, UDP_GRO, &opt, sizeof(opt)) == -1) {
+        FLOG(FLOG_WARN, "UDP_GRO not supported (%s), receiving datagrams one by one", strerror(errno));
+        *gro = 0;
+    }
+
+    memset(&serv_adr, 0, sizeof(serv_adr));
+    serv_adr.sin_family = AF_INET;
+    serv_adr.sin_addr.s_addr = htonl(INADDR_ANY);
+    serv_adr.sin_port = htons(port);
+    if (bind(sock, (struct sockaddr*)&serv_adr, sizeof(serv_adr)) == -1)
+        goto fail;
+    return sock;
+fail:
+    close(sock);
+    return -1;
+}
+
+// --stats SEC 마다 워커별 초당 수치와 누적 드롭을 한 줄씩 찍는다. 분산이 고른지, 어디서 잃는지 본다
+static void run_stats(int nworkers, int sec)
+{
+    uint64_t last_pkts[MAX_WORKERS] = {0}, last_bytes[MAX_WORKERS] = {0};
+    while (1) {
+        sleep(sec);
+        uint64_t tp = 0, tb = 0, trx = 0, ttx = 0;
+        for (int i = 0; i < nworkers; i++) {
+            struct worker *w = &workers[i];
+            uint64_t p = __atomic_load_n(&w->pkts, __ATOMIC_RELAXED);
+            uint64_t b = __atomic_load_n(&w->bytes, __ATOMIC_RELAXED);
+            uint64_t rx = __atomic_load_n(&w->rx_drops, __ATOMIC_RELAXED);
+            uint64_t tx = __atomic_load_n(&w->tx_drops, __ATOMIC_RELAXED);
+            FLOG(FLOG_INFO, "worker %d: %llu pkt/s %.1f MB/s rx_drops %llu tx_drops %llu", i,
+                 (unsigned long long)(p - last_pkts[i]) / sec, (double)(b - last_bytes[i]) / sec / 1e6,
+                 (unsigned long long)rx, (unsigned long long)tx);
+            tp += p - last_pkts[i];
+            tb += b - last_bytes[i];
+            trx += rx;
+            ttx += tx;
+            last_pkts[i] = p;
+            last_bytes[i] = b;
+        }
+        if (nworkers > 1)
+            FLOG(FLOG_INFO, "total: %llu pkt/s %.1f MB/s rx_drops %llu tx_drops %llu",
+                 (unsigned long long)tp / sec, (double)tb / sec / 1e6,
+                 (unsigned long long)trx, (unsigned long long)ttx);
+    }
+}
+
 int main(int argc, char *argv[])
 {
     int serv_sock;
     char message[BUF_SIZE];
     int str_len;
     socklen_t clnt_adr_sz; // 클라이언트 주소 크기 변수
+    int batch = 0;         // 0 이면 예전 recvfrom/sendto 루프
+    int nworkers = 0;      // 0 이면 워커 1 개 (--batch 만 줬을 때) 또는 예전 루프
+    int pin = 0, stats = 0, gro = 0;
+    int max_conns = RUDP_MAX_CONNS;
+    const struct rudp_cc_ops *rudp = NULL;
+    const struct rudp_cc_ops *cc = &rudp_cubic;
     
     struct sockaddr_in serv_adr, clnt_adr; // 서버 주소, 클라이언트 주소 구조체
 
-    if (argc != 2) {
-        printf("Usage : %s <port>\n", argv[0]);
+    static const struct option long_opts[] = {
+        {"batch", required_argument, NULL, 'b'},   // recvmmsg/sendmmsg 한 번에 처리할 데이터그램 수
+        {"workers", required_argument, NULL, 'w'}, // SO_REUSEPORT 소켓 + 워커 스레드 수
+        {"pin", no_argument, NULL, 'p'},           // 워커 i 를 i 번째 CPU 에 고정
+        {"stats", required_argument, NULL, 's'},   // 워커별 카운터 출력 주기 (초)
+        {"gro", no_argument, NULL, 'g'},           // UDP_GRO 로 뭉쳐 받고 UDP_SEGMENT 로 뭉쳐 보낸다
+        {"rudp", no_argument, NULL, 'r'},          // rudp 연결을 받아 스트림마다 에코한다 (rudp_bench.c)
+        {"cc", required_argument, NULL, 'c'},      // --rudp 혼잡 제어: reno, cubic
+        {"max-conns", required_argument, NULL, 'm'}, // --rudp: 워커마다 동시 연결 상한
+        {NULL, 0, NULL, 0}
+    };
+    int c, bad = 0;
+    while ((c = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'b':
+            batch = atoi(optarg);
+            break;
+        case 'w':
+            nworkers = atoi(optarg);
+            break;
+        case 'p':
+            pin = 1;
+            break;
+        case 's':
+            stats = atoi(optarg);
+            break;
+        case 'g':
+            gro = 1;
+            break;
+        case 'r':
+            rudp = cc;
+            break;
+        case 'c':
+            if (strcmp(optarg, "reno") == 0)
+                cc = &rudp_reno;
+            else if (strcmp(optarg, "cubic") == 0)
+                cc = &rudp_cubic;
+            else
+                bad = 1;
+            if (rudp)
+                rudp = cc;
+            break;
+        case 'm':
+            max_conns = atoi(optarg);
+            break;
+        default:
+            bad = 1;
+        }
+    }
+    if (bad || optind != argc - 1 || batch < 0 || batch > MAX_BATCH ||
+        nworkers < 0 || nworkers > MAX_WORKERS || stats < 0 || (rudp && gro) || max_conns < 1) {
+        printf("Usage : %s [--batch N] [--workers N] [--pin] [--stats SEC] [--gro | --rudp [--cc reno|cubic] [--max-conns N]] <port>"
+               "   (batch: 1~%d, workers: 1~%d)\n",
+               argv[0], MAX_BATCH, MAX_WORKERS);
         exit(1);
     }
+    if (nworkers || pin || stats || gro || rudp) { // 워커 옵션은 배치 경로에서만 돈다
+        if (!batch)
+            batch = DEFAULT_BATCH;
+        if (!nworkers)
+            nworkers = 1;
+    } else if (batch) {
+        nworkers = 1;
+    }
+
+    fastlog_init(log_events, sizeof(log_events) / sizeof(log_events[0]));
+
+    if (nworkers) {
+        int port = atoi(argv[optind]);
+        for (int i = 0; i < nworkers; i++) {
+            struct worker *w = &workers[i];
+            w->id = i;
+            w->batch = batch;
+            w->pin = pin;
+            w->gro = gro;
+            w->rudp = rudp;
+            w->max_conns = max_conns;
+            w->sock = create_worker_socket(port, nworkers > 1, &w->gro);
+            w->tx_gso = w->gro;
+            if (w->sock == -1)
+                error_handling("bind() error");
+        }
+        FLOG(FLOG_INFO, "UDP Server waiting on port %s... (%d workers, batch %d%s%s%s)", argv[optind], nworkers, batch,
+             workers[0].gro ? ", gro" : "", rudp ? ", rudp " : "", rudp ? rudp->name : "");
+        for (int i = 0; i < nworkers; i++) {
+            if (pthread_create(&workers[i].tid, NULL, rudp ? run_rudp : run_batch, &workers[i]) != 0)
+                error_handling("pthread_create() error");
+        }
+        if (stats)
+            run_stats(nworkers, stats);
+        for (int i = 0; i < nworkers; i++)
+            pthread_join(workers[i].tid, NULL);
+        return 0;
+    }
 
     // 1. 소켓 생성 (socket)
     // SOCK_DGRAM = UDP
@@ -34,14 +700,14 @@ int main(int argc, char *argv[])
     memset(&serv_adr, 0, sizeof(serv_adr));
     serv_adr.sin_family = AF_INET;
     serv_adr.sin_addr.s_addr = htonl(INADDR_ANY);
-    serv_adr.sin_port = htons(atoi(argv[1]));
+    serv_adr.sin_port = htons(atoi(argv[optind]));
 
     // 2. 주소 할당 (bind)
     // TCP와 동일하게 bind는 필요
     if (bind(serv_sock, (struct sockaddr*)&serv_adr, sizeof(serv_adr)) == -1)
         error_handling("bind() error");
 
-    printf("UDP Server waiting on port %s...\n", argv[1]);
+    FLOG(FLOG_INFO, "UDP Server waiting on port %s...", argv[optind]);
 
     // 3. listen()과 accept()가 없습니다!
     
@@ -56,8 +722,8 @@ int main(int argc, char *argv[])
         str_len = recvfrom(serv_sock, message, BUF_SIZE, 0, 
                            (struct sockaddr*)&clnt_adr, &clnt_adr_sz);
         
-        printf("Message from client %s:%d\n", 
-               inet_ntoa(clnt_adr.sin_addr), ntohs(clnt_adr.sin_port));
+        // inet_ntoa + printf 는 데이터그램마다 돌던 비용. 레벨이 꺼져 있으면 비교 한 번으로 끝난다
+        FLOG_EV(EV_DGRAM, FLOG_INFO, "Message from client " FLOG_ADDR_FMT, FLOG_ADDR_ARGS(&clnt_adr));
 
         // 5. 데이터 송신 (sendto) - 에코
         // write() 대신 sendto() 사용
@@ -76,4 +742,4 @@ void error_handling(char *message)
 {
     perror(message);
     exit(1);
-}
\ No newline at end of file
+}